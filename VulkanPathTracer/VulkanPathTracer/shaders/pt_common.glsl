@@ -0,0 +1,333 @@
+// Scene bindings, parameters and path sampling shared by the megakernel
+// (pt.comp) and the wavefront kernels (wavefront.comp), so both trace the
+// same paths. Including shaders enable GL_KHR_shader_subgroup_arithmetic.
+
+layout(binding = 0, set = 0, scalar) buffer storageBuffer
+{
+  vec3 imageData[];
+};
+layout(binding = 1, set = 0) uniform accelerationStructureEXT tlas;
+layout(binding = 2, set = 0, scalar) buffer Vertices
+{
+  vec3 vertices[];
+};
+layout(binding = 3, set = 0, scalar) buffer Indices
+{
+  uint indices[];
+};
+// Running sum of every sample traced so far (rgb) and the sample count (w),
+// persistent across dispatches
+layout(binding = 4, set = 0) buffer Accumulation
+{
+  vec4 accumulation[];
+};
+// Index range and material of every shape, must match MeshShape. Each shape
+// has its own BLAS and TLAS instance, whose custom index selects its entry
+// here.
+struct Shape
+{
+  uint firstIndex;
+  uint indexCount;
+  uint material;
+};
+layout(binding = 5, set = 0, scalar) buffer Shapes
+{
+  Shape shapes[];
+};
+// Rays traced since the host last reset them, for the path statistics: the
+// path segments, then the shadow rays of light sampling. Each is a 64 bit
+// count in two words, low then high, as one dispatch over a large image can
+// trace more than 2^32 rays.
+const uint STATISTIC_SEGMENTS    = 0;
+const uint STATISTIC_SHADOW_RAYS = 1;
+layout(binding = 10, set = 0) buffer PathStatistics
+{
+  uint statisticWords[4];
+};
+// The scene's materials, must match MeshMaterial
+struct Material
+{
+  vec3 emission;
+};
+layout(binding = 12, set = 0, scalar) buffer Materials
+{
+  Material materials[];
+};
+// Emissive triangles with the alias table that picks them by area, must
+// match LightTriangle and LightTable
+struct LightTriangle
+{
+  uint  firstIndex;  // Of the triangle's vertex indices
+  uint  material;
+  float aliasProbability;
+  uint  alias;
+};
+layout(binding = 13, set = 0, scalar) buffer Lights
+{
+  uint          lightCount;
+  float         lightArea;  // Total area of the emissive triangles
+  LightTriangle lights[];
+};
+
+// Set per dispatch, must match RenderParameters and WavefrontParameters in
+// src/Core/Rendering/RenderParameters.hpp. Samples
+// [sampleOffset, sampleOffset + samplesPerDispatch) are traced and added to
+// the accumulation buffer; an offset of firstSample restarts it.
+layout(push_constant) uniform PushConstants
+{
+  mat4  cameraToWorld;     // The camera looks down its -z axis
+  uvec2 resolution;
+  float fovVerticalSlope;  // Vertical slope of the topmost rays
+  uint  maxSegments;       // Path segments per sample, i.e. bounces + 1
+  uint  sampleOffset;
+  uint  samplesPerDispatch;
+  uint  rouletteMinBounces;  // Bounces before Russian roulette, ~0 disables it
+  uint  samplerType;          // One of the SAMPLER_ constants of sampler.glsl
+  uint  log2SamplesPerPixel;  // Bits of the largest sample index of the render
+  uint  firstSample;          // First sample of the range being accumulated
+  uint  lightSampling;        // 1 samples the lights at every bounce
+  // Only pushed for the wavefront kernels
+  uint  wavefrontSegment;  // Path segment the extend and shade kernels trace
+  uint  wavefrontQueue;    // Ray queue they read, the shade kernel fills the other
+  uint  wavefrontSample;   // Sample of the dispatch the generate kernel starts
+} pc;
+
+#include "sampler.glsl"
+
+// Every surface is a gray diffuse reflector for now
+const vec3 SURFACE_COLOR = vec3(0.7f);
+
+const float INV_PI = 0.31830988618;
+
+// Returns the color of the sky in a given direction (in linear color space)
+vec3 skyColor(vec3 direction)
+{
+  // +y in world space is up, so:
+  if(direction.y > 0.0f)
+  {
+    return mix(vec3(1.0f), vec3(0.25f, 0.5f, 1.0f), direction.y);
+  }
+  else
+  {
+    return vec3(0.03f);
+  }
+}
+
+// Starts a camera ray through a sampled point of the pixel
+void generateCameraRay(uvec2 pixel, inout PathSampler pathSampler, out vec3 rayOrigin, out vec3 rayDirection)
+{
+  const uvec2 resolution = pc.resolution;
+
+  // This scene uses a right-handed coordinate system like the OBJ file format, where the
+  // +x axis points right, the +y axis points up, and the -z axis points into the screen.
+  // The camera is placed in the scene by cameraToWorld.
+  rayOrigin                 = pc.cameraToWorld[3].xyz;
+  const mat3 cameraRotation = mat3(pc.cameraToWorld);
+  // Define the field of view by the vertical slope of the topmost rays:
+  const float fovVerticalSlope = pc.fovVerticalSlope;
+
+  // Compute the direction of the ray for this pixel. To do this, we first
+  // transform the screen coordinates to look like this, where a is the
+  // aspect ratio (width/height) of the screen:
+  //           1
+  //    .------+------.
+  //    |      |      |
+  // -a + ---- 0 ---- + a
+  //    |      |      |
+  //    '------+------'
+  //          -1
+  const vec2 randomPixelCenter = vec2(pixel) + nextSample2D(pathSampler);
+  const vec2 screenUV          = vec2((2.0 * randomPixelCenter.x - resolution.x) / resolution.y,    //
+                             -(2.0 * randomPixelCenter.y - resolution.y) / resolution.y);  // Flip the y axis
+  // Create a ray direction in camera space and rotate it into world space:
+  rayDirection = vec3(fovVerticalSlope * screenUV.x, fovVerticalSlope * screenUV.y, -1.0);
+  rayDirection = normalize(cameraRotation * rayDirection);
+}
+
+// Fetches the vertices of a triangle of a shape
+void getTriangle(uint shape, uint primitiveID, out vec3 v0, out vec3 v1, out vec3 v2)
+{
+  // Get where the shape's indices start
+  const uint firstIndex = shapes[shape].firstIndex;
+
+  // Get the indices of the vertices of the triangle
+  const uint i0 = indices[firstIndex + 3 * primitiveID + 0];
+  const uint i1 = indices[firstIndex + 3 * primitiveID + 1];
+  const uint i2 = indices[firstIndex + 3 * primitiveID + 2];
+
+  // Get the vertices of the triangle
+  v0 = vertices[i0];
+  v1 = vertices[i1];
+  v2 = vertices[i2];
+}
+
+vec3 getShapeEmission(uint shape)
+{
+  return materials[shapes[shape].material].emission;
+}
+
+// Returns the world space normal of a triangle, given the world to object
+// matrix of its instance
+vec3 getWorldNormal(vec3 v0, vec3 v1, vec3 v2, mat4x3 worldToObject)
+{
+  // Compute the normal of the triangle in object space, using the right-hand rule:
+  //    v2      .
+  //    |\      .
+  //    | \     .
+  //    |/ \    .
+  //    /   \   .
+  //   /|    \  .
+  //  L v0---v1 .
+  // n
+  const vec3 objectNormal = cross(v1 - v0, v2 - v0);
+  // Normals transform with the inverse transpose of the object to world
+  // matrix, i.e. the transposed world to object matrix:
+  return normalize((objectNormal * worldToObject).xyz);
+}
+
+// Russian roulette after a bounce, bounce counting the path's bounces so far.
+// Past rouletteMinBounces the path survives with the probability of its
+// brightest throughput channel, capped so every path ends, and is reweighted
+// by its inverse. This keeps the estimate unbiased while paths that can
+// only add little light stop tracing. Returns false if the path ends.
+bool survivesRoulette(inout vec3 throughput, uint bounce, inout PathSampler pathSampler)
+{
+  if(bounce <= pc.rouletteMinBounces)
+  {
+    return true;
+  }
+  const float survival = min(max(throughput.r, max(throughput.g, throughput.b)), 0.95f);
+  if(nextSample1D(pathSampler) >= survival)
+  {
+    return false;
+  }
+  throughput /= survival;
+  return true;
+}
+
+// Adds the rays traced by the active invocations to one of the path
+// statistics, with one atomic per subgroup. The add that wraps the low word
+// carries into the high one.
+void addPathStatistic(uint statistic, uint count)
+{
+  const uint subgroupCount = subgroupAdd(count);
+  if(subgroupCount > 0 && subgroupElect())
+  {
+    const uint previous = atomicAdd(statisticWords[2 * statistic], subgroupCount);
+    if(previous + subgroupCount < previous)
+    {
+      atomicAdd(statisticWords[2 * statistic + 1], 1u);
+    }
+  }
+}
+
+// Returns a diffuse bounce direction around a normal facing the ray
+vec3 sampleDiffuseBounce(vec3 worldNormal, inout PathSampler pathSampler)
+{
+  // For a random diffuse bounce direction, we follow the approach of
+  // Ray Tracing in One Weekend, and generate a random point on a sphere
+  // of radius 1 centered at the normal. This uses the random_unit_vector
+  // function from chapter 8.5:
+  const vec2  xi    = nextSample2D(pathSampler);
+  const float theta = 6.2831853 * xi.x;  // Random in [0, 2pi]
+  const float u     = 2.0 * xi.y - 1.0;  // Random in [-1, 1]
+  const float r     = sqrt(1.0 - u * u);
+  // Then normalize the ray direction:
+  return normalize(worldNormal + vec3(r * cos(theta), r * sin(theta), u));
+}
+
+// Density over solid angle of sampleDiffuseBounce returning direction
+float getDiffuseBouncePdf(vec3 worldNormal, vec3 direction)
+{
+  return max(dot(worldNormal, direction), 0.0) * INV_PI;
+}
+
+// Density over solid angle of sampleDirectLight picking a point of a light
+// at the given distance, seen at cosLight to its normal. Picks are uniform
+// over the total emissive area.
+float getLightPdf(float lightDistance, float cosLight)
+{
+  return lightDistance * lightDistance / (lightArea * max(cosLight, 1e-8));
+}
+
+// Veach's power heuristic: the weight of a sample taken with density pdf
+// against another strategy that takes it with density otherPdf
+float powerHeuristic(float pdf, float otherPdf)
+{
+  const float pdf2 = pdf * pdf;
+  return (pdf2 > 0.0) ? pdf2 / (pdf2 + otherPdf * otherPdf) : 0.0;
+}
+
+// Weight of emission that a path segment hit after bouncing off a surface,
+// where bsdfPdf is the density the bounce sampled the segment with. The same
+// light is also sampled directly at the bounce, so both are weighted by
+// multiple importance sampling. Camera rays only find light one way.
+float getHitEmissionWeight(uint segment, float bsdfPdf, float lightDistance, vec3 worldNormal, vec3 rayDirection)
+{
+  if(segment == 0 || pc.lightSampling == 0)
+  {
+    return 1.0;
+  }
+  return powerHeuristic(bsdfPdf, getLightPdf(lightDistance, abs(dot(worldNormal, rayDirection))));
+}
+
+// Next event estimation at a diffuse surface point: picks an emissive
+// triangle by area with the alias table and a uniform point on it, and
+// returns the light arriving from there, times the diffuse BRDF without its
+// surface color and the cosine, weighted against the diffuse bounce finding
+// the same light. The shadow ray only asks whether anything is in the way,
+// so its traversal stops at the first hit rather than searching for the
+// closest. Lights emit from both sides, as OBJ windings are not reliable.
+// shadowRays counts the shadow rays traced.
+vec3 sampleDirectLight(vec3 origin, vec3 worldNormal, inout PathSampler pathSampler, inout uint shadowRays)
+{
+  if(pc.lightSampling == 0 || lightCount == 0)
+  {
+    return vec3(0.0);
+  }
+  const vec2  xi     = nextSample2D(pathSampler);
+  const float scaled = nextSample1D(pathSampler) * float(lightCount);
+
+  // The integer part selects an entry, the fraction keeps it or its alias
+  uint entry = min(uint(scaled), lightCount - 1u);
+  if(scaled - float(entry) >= lights[entry].aliasProbability)
+  {
+    entry = lights[entry].alias;
+  }
+  const LightTriangle light = lights[entry];
+  const vec3          v0    = vertices[indices[light.firstIndex + 0]];
+  const vec3          v1    = vertices[indices[light.firstIndex + 1]];
+  const vec3          v2    = vertices[indices[light.firstIndex + 2]];
+
+  // Uniform point on the triangle by the square root warp
+  const float su          = sqrt(xi.x);
+  const vec3  lightPoint  = v0 * (1.0 - su) + v1 * (su * (1.0 - xi.y)) + v2 * (su * xi.y);
+  const vec3  lightNormal = normalize(cross(v1 - v0, v2 - v0));
+
+  vec3        toLight       = lightPoint - origin;
+  const float lightDistance = length(toLight);
+  toLight /= lightDistance;
+  const float cosSurface = dot(worldNormal, toLight);
+  const float cosLight   = abs(dot(lightNormal, toLight));
+  if(cosSurface <= 0.0 || cosLight <= 0.0)
+  {
+    return vec3(0.0);
+  }
+
+  // Stop just short of the light, so it doesn't shadow itself
+  rayQueryEXT rayQuery;
+  rayQueryInitializeEXT(rayQuery, tlas, gl_RayFlagsOpaqueEXT | gl_RayFlagsTerminateOnFirstHitEXT, 0xFF, origin, 0.0, toLight,
+                        0.999 * lightDistance);
+  while(rayQueryProceedEXT(rayQuery))
+  {
+  }
+  shadowRays++;
+  if(rayQueryGetIntersectionTypeEXT(rayQuery, true) != gl_RayQueryCommittedIntersectionNoneEXT)
+  {
+    return vec3(0.0);
+  }
+
+  const float lightPdf = getLightPdf(lightDistance, cosLight);
+  const float weight   = powerHeuristic(lightPdf, cosSurface * INV_PI);
+  return materials[light.material].emission * (cosSurface * INV_PI * weight / lightPdf);
+}
@@ -1,2 +1,3 @@
-C:\VulkanSDK\1.3.261.1\Bin\glslc.exe pt.comp -o pt.comp.spv
+C:\VulkanSDK\1.3.261.1\Bin\glslc.exe --target-env=vulkan1.2 pt.comp -o pt.comp.spv
+C:\VulkanSDK\1.3.261.1\Bin\glslc.exe --target-env=vulkan1.2 wavefront.comp -o wavefront.comp.spv
 pause
\ No newline at end of file
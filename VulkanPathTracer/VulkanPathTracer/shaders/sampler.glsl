@@ -0,0 +1,231 @@
+// Sample generators of the path tracer, selected per dispatch by
+// pc.samplerType. Every number a path draws is a pure function of its pixel,
+// the index of the sample over the whole render and a dimension (which
+// includes the bounce), with no state carried between samples. Any range of
+// samples can be traced on its own and gives the same numbers as a full
+// render. Included by pt_common.glsl after the push constants;
+// the host reference is src/CpuResources/CpuSampler.cpp.
+
+// Values of pc.samplerType, must match SamplerType
+const uint SAMPLER_RANDOM = 0;
+const uint SAMPLER_SOBOL  = 1;
+const uint SAMPLER_ZSOBOL = 2;
+
+// Dimensions of the Sobol generator matrices, must match SobolDimensions.
+// Every bounce draws from its own block of this many dimensions.
+const uint SOBOL_DIMENSIONS = 16;
+
+// Generator matrices of the first SOBOL_DIMENSIONS Sobol dimensions, 32
+// columns each. Column j holds direction number j, most significant bit
+// first, see makeSobolMatrices.
+layout(binding = 11, set = 0) readonly buffer SobolMatrices
+{
+  uint sobolMatrices[];
+};
+
+// The 24 permutations of a base 4 digit, two bits per digit
+const uint BASE4_PERMUTATIONS[24] = uint[](0xE4u, 0xB4u, 0xD8u, 0x78u, 0x9Cu, 0x6Cu, 0xE1u, 0xB1u, 0xC9u, 0x39u, 0x8Du, 0x2Du,
+                                           0xD2u, 0x72u, 0xC6u, 0x36u, 0x4Eu, 0x1Eu, 0x93u, 0x63u, 0x87u, 0x27u, 0x4Bu, 0x1Bu);
+
+struct PathSampler
+{
+  uvec2 pixel;
+  uint  sampleIndex;  // Sample of the pixel, counted over the whole render
+  uint  dimension;    // Next dimension drawn
+};
+
+// PCG hash of Jarzynski and Olano, "Hash Functions for GPU Rendering"
+uint hashUint(uint x)
+{
+  const uint state = x * 747796405u + 2891336453u;
+  const uint word  = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+  return (word >> 22u) ^ word;
+}
+
+// 4D to 4D hash of the same paper, every output bit depends on every input
+uvec4 pcg4d(uvec4 v)
+{
+  v = v * 1664525u + 1013904223u;
+  v.x += v.y * v.w;
+  v.y += v.z * v.x;
+  v.z += v.x * v.y;
+  v.w += v.y * v.z;
+  v ^= v >> 16u;
+  v.x += v.y * v.w;
+  v.y += v.z * v.x;
+  v.z += v.x * v.y;
+  v.w += v.y * v.z;
+  return v;
+}
+
+uint hashCombine(uint seed, uint value)
+{
+  return seed ^ (hashUint(value) + 0x9e3779b9u + (seed << 6u) + (seed >> 2u));
+}
+
+// Owen scrambling: flips every bit of x depending on the bits above it,
+// with the Laine-Karras style permutation of Burley, "Practical Hash-based
+// Owen Scrambling" (2020)
+uint nestedUniformScramble(uint x, uint seed)
+{
+  x = bitfieldReverse(x);
+  x += seed;
+  x ^= x * 0x6c50b47cu;
+  x ^= x * 0xb82f1e52u;
+  x ^= x * 0xc7afe638u;
+  x ^= x * 0x8d22f6e6u;
+  return bitfieldReverse(x);
+}
+
+uint sobolSample(uint index, uint dimension)
+{
+  uint result = 0;
+  for(uint column = dimension * 32; index != 0; column++, index >>= 1)
+  {
+    if((index & 1u) != 0)
+    {
+      result ^= sobolMatrices[column];
+    }
+  }
+  return result;
+}
+
+// [0, 1) from the 24 high bits, exactly representable as a float
+float toUnitFloat(uint x)
+{
+  return float(x >> 8) * (1.0 / 16777216.0);
+}
+
+// Counter-based uniform random numbers: the hash of the whole key, so
+// unlike a stream no number depends on the ones drawn before it
+float getRandomSample(PathSampler s, uint dimension)
+{
+  return toUnitFloat(pcg4d(uvec4(s.pixel, s.sampleIndex, dimension)).x);
+}
+
+// Owen-scrambled Sobol with the samples of every pixel and dimension block
+// shuffled by their own seed (Burley's padding), so neither pixels nor
+// bounces correlate
+float getSobolSample(PathSampler s, uint dimension)
+{
+  const uint blockSeed = hashCombine(hashCombine(hashUint(s.pixel.x), s.pixel.y), dimension / SOBOL_DIMENSIONS);
+  const uint index     = nestedUniformScramble(s.sampleIndex, blockSeed);
+  const uint component = dimension % SOBOL_DIMENSIONS;
+  return toUnitFloat(nestedUniformScramble(sobolSample(index, component), hashCombine(blockSeed, component + 1)));
+}
+
+uint lowBitMask(uint bits)
+{
+  return (bits >= 32u) ? 0xFFFFFFFFu : (1u << bits) - 1u;
+}
+
+// Spreads the low 16 bits of v to its even bits
+uint spreadEvenBits(uint v)
+{
+  v &= 0x0000FFFFu;
+  v = (v | (v << 8)) & 0x00FF00FFu;
+  v = (v | (v << 4)) & 0x0F0F0F0Fu;
+  v = (v | (v << 2)) & 0x33333333u;
+  v = (v | (v << 1)) & 0x55555555u;
+  return v;
+}
+
+// Index of a pixel's sample in one Sobol sequence shared by the whole image,
+// after Ahmed and Wonka, "Screen-Space Blue-Noise Diffusion of Monte Carlo
+// Sampling Error via Hierarchical Ordering of Pixels" (2020) as in pbrt-v4's
+// ZSobolSampler. Pixels take consecutive runs of the sequence in Morton order
+// and the base 4 digits of the index are permuted per dimension, so any
+// aligned block of 4^k pixels shares well stratified points and the error of
+// neighboring pixels is blue noise. tileSeed tells apart the tiles of images
+// too large for the 32 bit index.
+uint getZSobolIndex(PathSampler s, uint dimension, out uint tileSeed)
+{
+  const uint sampleBits = min(pc.log2SamplesPerPixel, 30u);
+  const uint side       = max(pc.resolution.x, pc.resolution.y);
+  const uint imageBits  = (side > 1u) ? 2u * uint(findMSB(side - 1u) + 1) : 0u;
+  const uint mortonBits = min(imageBits, (32 - sampleBits) & ~1u);
+  const uint indexBits  = mortonBits + sampleBits;
+
+  const uint morton      = spreadEvenBits(s.pixel.x) | (spreadEvenBits(s.pixel.y) << 1);
+  tileSeed               = (mortonBits < 32u) ? morton >> mortonBits : 0u;
+  const uint mortonIndex = ((morton & lowBitMask(mortonBits)) << sampleBits) | (s.sampleIndex & lowBitMask(sampleBits));
+
+  // Each digit is permuted depending on the digits above it, which keeps
+  // every aligned block of the sequence together. An odd sample bit count
+  // leaves one bit at the bottom, which is flipped instead.
+  const uint dimensionSalt = 0x55555555u * dimension;
+  uint       index         = 0;
+  for(int shift = int(indexBits) - 2; shift >= int(indexBits & 1u); shift -= 2)
+  {
+    const uint digit        = (mortonIndex >> shift) & 3u;
+    const uint higherDigits = (shift + 2 < 32) ? mortonIndex >> (shift + 2) : 0u;
+    const uint permutation  = (hashUint(higherDigits ^ dimensionSalt) >> 24) % 24;
+    index |= ((BASE4_PERMUTATIONS[permutation] >> (2 * digit)) & 3u) << shift;
+  }
+  if((indexBits & 1u) != 0)
+  {
+    index |= (mortonIndex & 1u) ^ (hashUint((mortonIndex >> 1) ^ dimensionSalt) & 1u);
+  }
+  return index;
+}
+
+PathSampler startPathSampler(uvec2 pixel, uint sampleIndex)
+{
+  PathSampler s;
+  s.pixel       = pixel;
+  s.sampleIndex = sampleIndex;
+  s.dimension   = 0;
+  return s;
+}
+
+// Moves on to the block of dimensions of a bounce, so the bounce draws the
+// same dimensions however many numbers earlier bounces took
+void startBounce(inout PathSampler s, uint bounce)
+{
+  s.dimension = bounce * SOBOL_DIMENSIONS;
+}
+
+float nextSample1D(inout PathSampler s)
+{
+  float result;
+  if(pc.samplerType == SAMPLER_SOBOL)
+  {
+    result = getSobolSample(s, s.dimension);
+  }
+  else if(pc.samplerType == SAMPLER_ZSOBOL)
+  {
+    uint       tileSeed;
+    const uint index = getZSobolIndex(s, s.dimension, tileSeed);
+    result = toUnitFloat(nestedUniformScramble(sobolSample(index, 0u), hashCombine(hashCombine(tileSeed, s.dimension), 0u)));
+  }
+  else
+  {
+    result = getRandomSample(s, s.dimension);
+  }
+  s.dimension++;
+  return result;
+}
+
+vec2 nextSample2D(inout PathSampler s)
+{
+  vec2 result;
+  if(pc.samplerType == SAMPLER_SOBOL)
+  {
+    result = vec2(getSobolSample(s, s.dimension), getSobolSample(s, s.dimension + 1));
+  }
+  else if(pc.samplerType == SAMPLER_ZSOBOL)
+  {
+    // One index for both dimensions, so the pair is a 2D Sobol point
+    uint       tileSeed;
+    const uint index = getZSobolIndex(s, s.dimension, tileSeed);
+    const uint seed  = hashCombine(tileSeed, s.dimension);
+    result           = vec2(toUnitFloat(nestedUniformScramble(sobolSample(index, 0u), hashCombine(seed, 0u))),
+                            toUnitFloat(nestedUniformScramble(sobolSample(index, 1u), hashCombine(seed, 1u))));
+  }
+  else
+  {
+    result = vec2(getRandomSample(s, s.dimension), getRandomSample(s, s.dimension + 1));
+  }
+  s.dimension += 2;
+  return result;
+}
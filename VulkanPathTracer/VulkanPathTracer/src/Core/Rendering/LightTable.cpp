@@ -0,0 +1,83 @@
+#include "LightTable.hpp"
+
+#include <cmath>
+
+namespace core_internal::rendering {
+namespace {
+double getTriangleArea(const Mesh& mesh, uint32_t firstIndex) {
+  double v[3][3];
+  for (int corner = 0; corner < 3; corner++) {
+    const uint32_t index = mesh.indices[firstIndex + corner];
+    for (int c = 0; c < 3; c++) {
+      v[corner][c] = mesh.vertices[3 * size_t(index) + c];
+    }
+  }
+  const double e1[3] = {v[1][0] - v[0][0], v[1][1] - v[0][1],
+                        v[1][2] - v[0][2]};
+  const double e2[3] = {v[2][0] - v[0][0], v[2][1] - v[0][1],
+                        v[2][2] - v[0][2]};
+  const double n[3] = {e1[1] * e2[2] - e1[2] * e2[1],
+                       e1[2] * e2[0] - e1[0] * e2[2],
+                       e1[0] * e2[1] - e1[1] * e2[0]};
+  return 0.5 * std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+}
+}  // namespace
+
+LightTable buildLightTable(const Mesh& mesh) {
+  LightTable table;
+  std::vector<double> areas;
+  double totalArea = 0.0;
+  for (const MeshShape& shape : mesh.shapes) {
+    if (shape.material >= mesh.materials.size() ||
+        !mesh.materials[shape.material].isEmissive()) {
+      continue;
+    }
+    for (uint32_t i = 0; i + 3 <= shape.indexCount; i += 3) {
+      const double area = getTriangleArea(mesh, shape.firstIndex + i);
+      if (area > 0.0) {
+        table.triangles.push_back(
+            {shape.firstIndex + i, shape.material, 1.0f, 0});
+        areas.push_back(area);
+        totalArea += area;
+      }
+    }
+  }
+  if (table.triangles.empty()) {
+    return table;
+  }
+  table.totalArea = static_cast<float>(totalArea);
+
+  // Vose's construction: entries scaled to an average of 1 are split into
+  // those below and above it, and every small entry is topped up by a large
+  // one, which becomes its alias
+  const size_t count = table.triangles.size();
+  std::vector<double> scaled(count);
+  std::vector<uint32_t> small, large;
+  for (size_t i = 0; i < count; i++) {
+    scaled[i] = areas[i] * double(count) / totalArea;
+    (scaled[i] < 1.0 ? small : large).push_back(static_cast<uint32_t>(i));
+  }
+  while (!small.empty() && !large.empty()) {
+    const uint32_t less = small.back();
+    small.pop_back();
+    const uint32_t more = large.back();
+    table.triangles[less].aliasProbability = static_cast<float>(scaled[less]);
+    table.triangles[less].alias = more;
+    scaled[more] -= 1.0 - scaled[less];
+    if (scaled[more] < 1.0) {
+      large.pop_back();
+      small.push_back(more);
+    }
+  }
+  // What is left is 1 up to rounding
+  for (uint32_t i : small) {
+    table.triangles[i].aliasProbability = 1.0f;
+    table.triangles[i].alias = i;
+  }
+  for (uint32_t i : large) {
+    table.triangles[i].aliasProbability = 1.0f;
+    table.triangles[i].alias = i;
+  }
+  return table;
+}
+}  // namespace core_internal::rendering
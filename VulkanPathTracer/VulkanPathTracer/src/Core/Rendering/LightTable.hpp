@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Mesh.hpp"
+
+namespace core_internal::rendering {
+// An emissive triangle in the alias table of a LightTable. Must match
+// LightTriangle in shaders/pt_common.glsl.
+struct LightTriangle {
+  // Index of the triangle's first vertex index in the mesh's index array
+  uint32_t firstIndex;
+  // Index into Mesh::materials
+  uint32_t material;
+  // A sample landing on this entry keeps it with this probability and takes
+  // alias otherwise
+  float aliasProbability;
+  uint32_t alias;
+};
+static_assert(sizeof(LightTriangle) == 16,
+              "LightTriangle must match the pt_common.glsl Lights buffer");
+
+// The emissive triangles of a mesh, picked with probability proportional to
+// their area by Walker's alias method: one uniform number selects an entry
+// and decides between it and its alias, in constant time however many
+// lights there are. A uniform point on the picked triangle is then uniform
+// over all emissive surface, so light samples have the area density
+// 1 / totalArea.
+struct LightTable {
+  std::vector<LightTriangle> triangles;
+  float totalArea = 0.0f;
+};
+
+// Builds the table from the shapes with emissive materials. Degenerate
+// triangles are left out. Light positions are those of the mesh, shapes moved
+// by instance transforms are not followed.
+LightTable buildLightTable(const Mesh& mesh);
+}  // namespace core_internal::rendering
@@ -0,0 +1,88 @@
+#include "Mesh.hpp"
+
+#include <tiny_obj_loader.h>
+
+#include "../Tools/HelperMacros.hpp"
+#include "../Tools/Hash.hpp"
+#include "MeshCache.hpp"
+#include "ObjParser.hpp"
+
+namespace core_internal::rendering {
+uint64_t hashMesh(std::span<const float> vertices,
+                  std::span<const uint32_t> indices,
+                  std::span<const MeshShape> shapes,
+                  std::span<const MeshMaterial> materials) {
+  uint64_t hash =
+      tools::hashBytes(vertices.data(), vertices.size() * sizeof(float));
+  hash = tools::hashBytes(indices.data(), indices.size() * sizeof(uint32_t),
+                          hash);
+  hash = tools::hashBytes(shapes.data(), shapes.size_bytes(), hash);
+  return tools::hashBytes(materials.data(), materials.size_bytes(), hash);
+}
+
+bool loadObjMesh(const std::string& path, Mesh& mesh) {
+  return parseObjParallel(path, mesh);
+}
+
+bool loadObjMeshTinyObj(const std::string& path, Mesh& mesh) {
+  tinyobj::ObjReader reader;  // Used to read an OBJ file
+  if (!reader.ParseFromFile(path)) {
+    DEBUG_WARNING("Could not load OBJ file \"" + path +
+                  "\": " + reader.Error());
+    return false;
+  }
+
+  mesh.mapping.reset();
+  mesh.vertexStorage = reader.GetAttrib().GetVertices();
+  // tinyobj's material ids are shifted by one, past the default material
+  mesh.materials.assign(1, MeshMaterial{});
+  for (const tinyobj::material_t& objMaterial : reader.GetMaterials()) {
+    mesh.materials.push_back({{objMaterial.emission[0],
+                               objMaterial.emission[1],
+                               objMaterial.emission[2]}});
+  }
+  // Concatenate the vertex indices of every shape, tinyobj's indices already
+  // refer to the shared `attrib.vertices`. A shape's faces are split where
+  // the material changes, like the parallel parser does at "usemtl".
+  mesh.indexStorage.clear();
+  mesh.shapeStorage.clear();
+  for (const tinyobj::shape_t& objShape : reader.GetShapes()) {
+    const tinyobj::mesh_t& objMesh = objShape.mesh;
+    for (size_t face = 0; face < objMesh.material_ids.size(); face++) {
+      const int materialId = objMesh.material_ids[face];
+      const uint32_t material =
+          materialId >= 0 && size_t(materialId) + 1 < mesh.materials.size()
+              ? static_cast<uint32_t>(materialId + 1)
+              : 0;
+      if (face == 0 || material != mesh.shapeStorage.back().material) {
+        mesh.shapeStorage.push_back(
+            {static_cast<uint32_t>(mesh.indexStorage.size()), 0, material});
+      }
+      for (size_t i = 3 * face; i < 3 * face + 3; i++) {
+        mesh.indexStorage.push_back(objMesh.indices[i].vertex_index);
+      }
+      mesh.shapeStorage.back().indexCount += 3;
+    }
+  }
+  mesh.vertices = mesh.vertexStorage;
+  mesh.indices = mesh.indexStorage;
+  mesh.shapes = mesh.shapeStorage;
+  mesh.contentHash =
+      hashMesh(mesh.vertices, mesh.indices, mesh.shapes, mesh.materials);
+  return true;
+}
+
+bool loadMesh(const std::string& path, Mesh& mesh) {
+  if (mapMeshCache(path, mesh)) {
+    return true;
+  }
+  if (!loadObjMesh(path, mesh)) {
+    return false;
+  }
+  if (!writeMeshCache(path, mesh)) {
+    DEBUG_WARNING("Could not write mesh cache \"" + getMeshCachePath(path) +
+                  "\"");
+  }
+  return true;
+}
+}  // namespace core_internal::rendering
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "../Tools/MappedFile.hpp"
+
+namespace core_internal::rendering {
+// One object of a scene ("o"/"g" in OBJ files): a range of the mesh's index
+// array with a single material. Every shape gets its own BLAS and TLAS
+// instance on the GPU.
+struct MeshShape {
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  // Index into Mesh::materials
+  uint32_t material;
+};
+static_assert(sizeof(MeshShape) == 12,
+              "MeshShape must match Shape in shaders/pt_common.glsl");
+
+// What the renderers use of an MTL material. Surfaces all reflect as the same
+// gray diffuse for now; emissive ones ("Ke") are also lights.
+struct MeshMaterial {
+  float emission[3];
+
+  bool isEmissive() const {
+    return emission[0] > 0.0f || emission[1] > 0.0f || emission[2] > 0.0f;
+  }
+};
+static_assert(sizeof(MeshMaterial) == 12,
+              "MeshMaterial must match Material in shaders/pt_common.glsl");
+
+// Triangle mesh in the layout the renderers upload: xyz positions and three
+// vertex indices per triangle, split into shapes. Indices refer to the whole
+// vertex array, so shapes can share vertices. The arrays are views into
+// either the owned storage (parsed meshes) or a mapped mesh cache file, so a
+// mesh can be moved but not copied.
+struct Mesh {
+  std::span<const float> vertices;
+  std::span<const uint32_t> indices;
+  // Covers every index, in order
+  std::span<const MeshShape> shapes;
+  // Materials of the shapes. Entry 0 is the black default for faces without
+  // a known material, so the array is never empty. Always owned, as it is
+  // small.
+  std::vector<MeshMaterial> materials;
+  // Hash of the vertex, index, shape and material arrays, identical meshes
+  // share GPU resources
+  uint64_t contentHash = 0;
+
+  std::vector<float> vertexStorage;
+  std::vector<uint32_t> indexStorage;
+  std::vector<MeshShape> shapeStorage;
+  std::unique_ptr<tools::MappedFile> mapping;
+
+  Mesh() {}
+  Mesh(Mesh&&) = default;
+  Mesh& operator=(Mesh&&) = default;
+  Mesh(const Mesh&) = delete;
+  Mesh& operator=(const Mesh&) = delete;
+
+  uint32_t getTriangleCount() const {
+    return static_cast<uint32_t>(indices.size() / 3);
+  }
+};
+
+uint64_t hashMesh(std::span<const float> vertices,
+                  std::span<const uint32_t> indices,
+                  std::span<const MeshShape> shapes,
+                  std::span<const MeshMaterial> materials);
+
+// Parses the faces of an OBJ file with the parallel parser (see
+// ObjParser.hpp). Returns false if the file can't be parsed.
+bool loadObjMesh(const std::string& path, Mesh& mesh);
+
+// Parses the shapes of an OBJ file with tinyobj, the reference the
+// parallel parser is checked and benchmarked against.
+bool loadObjMeshTinyObj(const std::string& path, Mesh& mesh);
+
+// Loads a scene mesh through the binary cache next to it (see MeshCache.hpp):
+// maps the cache when it matches the OBJ, otherwise parses the OBJ and writes
+// a fresh cache for the next run
+bool loadMesh(const std::string& path, Mesh& mesh);
+}  // namespace core_internal::rendering
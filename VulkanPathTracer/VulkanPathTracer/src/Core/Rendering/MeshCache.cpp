@@ -0,0 +1,193 @@
+#include "MeshCache.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "../Tools/HelperMacros.hpp"
+
+namespace core_internal::rendering {
+namespace {
+constexpr char MeshCacheMagic[8] = "VPTMESH";
+
+// Identifies the version of the source file a cache was built from
+bool getSourceStamp(const std::string& sourcePath, uint64_t& size,
+                    int64_t& writeTime) {
+  std::error_code error;
+  size = std::filesystem::file_size(sourcePath, error);
+  if (error) {
+    return false;
+  }
+  auto time = std::filesystem::last_write_time(sourcePath, error);
+  if (error) {
+    return false;
+  }
+  writeTime = static_cast<int64_t>(time.time_since_epoch().count());
+  return true;
+}
+}  // namespace
+
+std::string getMeshCachePath(const std::string& sourcePath) {
+  return sourcePath + ".vptmesh";
+}
+
+bool mapMeshCache(const std::string& sourcePath, Mesh& mesh) {
+  uint64_t sourceSize;
+  int64_t sourceWriteTime;
+  if (!getSourceStamp(sourcePath, sourceSize, sourceWriteTime)) {
+    return false;
+  }
+
+  auto mapping = std::make_unique<tools::MappedFile>();
+  if (!mapping->open(getMeshCachePath(sourcePath)) ||
+      mapping->getSize() < sizeof(MeshCacheHeader)) {
+    return false;
+  }
+
+  MeshCacheHeader header;
+  std::memcpy(&header, mapping->getData(), sizeof(header));
+  if (std::memcmp(header.magic, MeshCacheMagic, sizeof(header.magic)) != 0 ||
+      header.version != MeshCacheVersion ||
+      header.headerSize != sizeof(MeshCacheHeader) ||
+      header.sourceSize != sourceSize ||
+      header.sourceWriteTime != sourceWriteTime) {
+    return false;
+  }
+
+  // Offsets and counts come from disk, check them before forming the views.
+  // Counts are checked against the file size first, so the byte sizes can't
+  // overflow.
+  const uint64_t fileSize = mapping->getSize();
+  bool valid =
+      isAligned(header.vertexOffset, MeshCacheAlignment) &&
+      isAligned(header.indexOffset, MeshCacheAlignment) &&
+      isAligned(header.shapeOffset, MeshCacheAlignment) &&
+      isAligned(header.materialOffset, MeshCacheAlignment) &&
+      header.vertexFloatCount % 3 == 0 && header.indexCount % 3 == 0 &&
+      header.materialCount > 0 &&
+      header.vertexFloatCount <= fileSize / sizeof(float) &&
+      header.indexCount <= fileSize / sizeof(uint32_t) &&
+      header.shapeCount <= fileSize / sizeof(MeshShape) &&
+      header.materialCount <= fileSize / sizeof(MeshMaterial) &&
+      header.vertexOffset <= fileSize &&
+      header.vertexFloatCount * sizeof(float) <=
+          fileSize - header.vertexOffset &&
+      header.indexOffset <= fileSize &&
+      header.indexCount * sizeof(uint32_t) <= fileSize - header.indexOffset &&
+      header.shapeOffset <= fileSize &&
+      header.shapeCount * sizeof(MeshShape) <= fileSize - header.shapeOffset &&
+      header.materialOffset <= fileSize &&
+      header.materialCount * sizeof(MeshMaterial) <=
+          fileSize - header.materialOffset;
+  auto rejectCache = [&]() {
+    DEBUG_WARNING("Ignoring malformed mesh cache \"" +
+                  getMeshCachePath(sourcePath) + "\"");
+    return false;
+  };
+  if (!valid) {
+    return rejectCache();
+  }
+
+  // The renderers index the vertex, index and material arrays with these
+  // without further checks
+  const uint8_t* data = mapping->getData();
+  const uint32_t* indices =
+      reinterpret_cast<const uint32_t*>(data + header.indexOffset);
+  const MeshShape* shapes =
+      reinterpret_cast<const MeshShape*>(data + header.shapeOffset);
+  const uint64_t vertexCount = header.vertexFloatCount / 3;
+  for (uint64_t i = 0; valid && i < header.indexCount; i++) {
+    valid = indices[i] < vertexCount;
+  }
+  for (uint64_t i = 0; valid && i < header.shapeCount; i++) {
+    const MeshShape& shape = shapes[i];
+    valid = shape.firstIndex % 3 == 0 && shape.indexCount % 3 == 0 &&
+            shape.firstIndex <= header.indexCount &&
+            shape.indexCount <= header.indexCount - shape.firstIndex &&
+            shape.material < header.materialCount;
+  }
+  if (!valid) {
+    return rejectCache();
+  }
+
+  mesh.vertexStorage.clear();
+  mesh.indexStorage.clear();
+  mesh.shapeStorage.clear();
+  mesh.vertices = std::span<const float>(
+      reinterpret_cast<const float*>(data + header.vertexOffset),
+      header.vertexFloatCount);
+  mesh.indices = std::span<const uint32_t>(indices, header.indexCount);
+  mesh.shapes = std::span<const MeshShape>(shapes, header.shapeCount);
+  const MeshMaterial* materials =
+      reinterpret_cast<const MeshMaterial*>(data + header.materialOffset);
+  mesh.materials.assign(materials, materials + header.materialCount);
+  mesh.contentHash = header.contentHash;
+  mesh.mapping = std::move(mapping);
+  return true;
+}
+
+bool writeMeshCache(const std::string& sourcePath, const Mesh& mesh) {
+  MeshCacheHeader header{};
+  std::memcpy(header.magic, MeshCacheMagic, sizeof(header.magic));
+  header.version = MeshCacheVersion;
+  header.headerSize = sizeof(MeshCacheHeader);
+  if (!getSourceStamp(sourcePath, header.sourceSize, header.sourceWriteTime)) {
+    return false;
+  }
+  header.contentHash = mesh.contentHash;
+  header.vertexFloatCount = mesh.vertices.size();
+  header.indexCount = mesh.indices.size();
+  header.shapeCount = mesh.shapes.size();
+  header.materialCount = mesh.materials.size();
+  header.vertexOffset = alignUp(uint64_t(sizeof(header)), MeshCacheAlignment);
+  header.indexOffset =
+      alignUp(header.vertexOffset + mesh.vertices.size_bytes(),
+              MeshCacheAlignment);
+  header.shapeOffset = alignUp(header.indexOffset + mesh.indices.size_bytes(),
+                               MeshCacheAlignment);
+  header.materialOffset = alignUp(
+      header.shapeOffset + mesh.shapes.size_bytes(), MeshCacheAlignment);
+
+  const std::string cachePath = getMeshCachePath(sourcePath);
+  const std::string tempPath = cachePath + ".tmp";
+  {
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      return false;
+    }
+    const char padding[MeshCacheAlignment] = {};
+    auto padTo = [&](uint64_t offset) {
+      const uint64_t position = static_cast<uint64_t>(file.tellp());
+      file.write(padding, static_cast<std::streamsize>(offset - position));
+    };
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    padTo(header.vertexOffset);
+    file.write(reinterpret_cast<const char*>(mesh.vertices.data()),
+               static_cast<std::streamsize>(mesh.vertices.size_bytes()));
+    padTo(header.indexOffset);
+    file.write(reinterpret_cast<const char*>(mesh.indices.data()),
+               static_cast<std::streamsize>(mesh.indices.size_bytes()));
+    padTo(header.shapeOffset);
+    file.write(reinterpret_cast<const char*>(mesh.shapes.data()),
+               static_cast<std::streamsize>(mesh.shapes.size_bytes()));
+    padTo(header.materialOffset);
+    file.write(reinterpret_cast<const char*>(mesh.materials.data()),
+               static_cast<std::streamsize>(mesh.materials.size() *
+                                            sizeof(MeshMaterial)));
+    if (!file.good()) {
+      file.close();
+      std::filesystem::remove(tempPath);
+      return false;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(tempPath, cachePath, error);
+  if (error) {
+    std::filesystem::remove(tempPath, error);
+    return false;
+  }
+  return true;
+}
+}  // namespace core_internal::rendering
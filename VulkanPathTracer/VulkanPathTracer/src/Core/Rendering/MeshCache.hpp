@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "Mesh.hpp"
+
+namespace core_internal::rendering {
+// Binary mesh cache written next to a scene as "<scene>.vptmesh". The header
+// is followed by the vertex, index, shape and material arrays at
+// MeshCacheAlignment aligned offsets, so a mapped file can be copied into
+// upload buffers as is. Little-endian, like every platform the renderer
+// targets. Only the OBJ file is checked for changes, not its MTL files.
+constexpr uint32_t MeshCacheVersion = 3;
+constexpr uint64_t MeshCacheAlignment = 256;
+
+struct MeshCacheHeader {
+  char magic[8];  // "VPTMESH\0"
+  uint32_t version;
+  uint32_t headerSize;
+  // Size and modification time of the source file the cache was built from;
+  // a mismatch means the cache is stale
+  uint64_t sourceSize;
+  int64_t sourceWriteTime;
+  uint64_t contentHash;
+  uint64_t vertexFloatCount;
+  uint64_t indexCount;
+  uint64_t shapeCount;
+  uint64_t materialCount;
+  uint64_t vertexOffset;
+  uint64_t indexOffset;
+  uint64_t shapeOffset;
+  uint64_t materialOffset;
+};
+static_assert(sizeof(MeshCacheHeader) == 104);
+
+std::string getMeshCachePath(const std::string& sourcePath);
+
+// Maps the cache of sourcePath into mesh. Returns false if there is no cache,
+// it is malformed, or it was built from a different version of the source.
+bool mapMeshCache(const std::string& sourcePath, Mesh& mesh);
+
+// Writes the cache for mesh, loaded from sourcePath. The file is written
+// under a temporary name and renamed, so concurrent readers never see a
+// partial cache.
+bool writeMeshCache(const std::string& sourcePath, const Mesh& mesh);
+}  // namespace core_internal::rendering
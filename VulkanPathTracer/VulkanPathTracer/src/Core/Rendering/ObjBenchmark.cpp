@@ -0,0 +1,109 @@
+#include "ObjBenchmark.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+
+#include "../../CpuResources/ParallelFor.hpp"
+#include "Mesh.hpp"
+#include "ObjParser.hpp"
+
+namespace core_internal::rendering {
+namespace {
+double timeLoader(uint32_t repetitions, const std::function<bool()>& load) {
+  double best = 1e30;
+  for (uint32_t i = 0; i < std::max(1u, repetitions); i++) {
+    auto start = std::chrono::high_resolution_clock::now();
+    if (!load()) {
+      return 0.0;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    best = std::min(best, std::chrono::duration<double>(end - start).count());
+  }
+  return best;
+}
+}  // namespace
+
+bool writeGridObj(const std::string& path, uint64_t triangleCount) {
+  FILE* file = std::fopen(path.c_str(), "wb");
+  if (!file) {
+    return false;
+  }
+  // Two triangles per cell of a square grid in the xz plane
+  const uint64_t cells = (triangleCount + 1) / 2;
+  const uint64_t side = std::max<uint64_t>(
+      1, static_cast<uint64_t>(std::ceil(std::sqrt(double(cells)))));
+  const float scale = 2.0f / float(side);
+
+  for (uint64_t z = 0; z <= side; z++) {
+    for (uint64_t x = 0; x <= side; x++) {
+      std::fprintf(file, "v %f %f %f\n", float(x) * scale - 1.0f,
+                   0.01f * float((x ^ z) & 7), float(z) * scale - 1.0f);
+    }
+  }
+  for (uint64_t z = 0; z < side; z++) {
+    for (uint64_t x = 0; x < side; x++) {
+      const uint64_t v00 = z * (side + 1) + x + 1;
+      const uint64_t v10 = v00 + 1;
+      const uint64_t v01 = v00 + side + 1;
+      const uint64_t v11 = v01 + 1;
+      std::fprintf(file, "f %llu %llu %llu\nf %llu %llu %llu\n",
+                   (unsigned long long)v00, (unsigned long long)v01,
+                   (unsigned long long)v10, (unsigned long long)v10,
+                   (unsigned long long)v01, (unsigned long long)v11);
+    }
+  }
+  return std::fclose(file) == 0;
+}
+
+std::string runObjBenchmark(const std::string& path,
+                            const ObjBenchmarkSettings& settings) {
+  const uint32_t threadCount = cpu::resolveThreadCount(settings.threadCount);
+  std::stringstream report;
+  std::error_code error;
+  const double megabytes =
+      double(std::filesystem::file_size(path, error)) / (1024.0 * 1024.0);
+  report << "OBJ benchmark: \"" << path << "\", " << std::fixed
+         << std::setprecision(1) << megabytes << " MB, " << threadCount
+         << " threads\n";
+  report.unsetf(std::ios::fixed);
+
+  Mesh reference;
+  Mesh mesh;
+  auto measure = [&](const char* name, Mesh& target,
+                     const std::function<bool(Mesh&)>& load) {
+    double seconds = timeLoader(settings.repetitions,
+                                [&]() { return load(target); });
+    report << "  " << std::left << std::setw(24) << name << std::right;
+    if (seconds == 0.0) {
+      report << "    failed\n";
+      return;
+    }
+    report << std::setw(10) << std::fixed << std::setprecision(3) << seconds
+           << " s  " << std::setw(8) << std::setprecision(1)
+           << megabytes / seconds << " MB/s  (" << target.getTriangleCount()
+           << " triangles)\n";
+    report.unsetf(std::ios::fixed);
+  };
+
+  measure("tinyobj", reference, [&](Mesh& target) {
+    return loadObjMeshTinyObj(path, target);
+  });
+  measure("parallel 1 thread", mesh, [&](Mesh& target) {
+    return parseObjParallel(path, target, {.threadCount = 1});
+  });
+  measure("parallel all threads", mesh, [&](Mesh& target) {
+    return parseObjParallel(path, target, {.threadCount = threadCount});
+  });
+
+  report << "  Meshes "
+         << (reference.contentHash == mesh.contentHash ? "match" : "DIFFER")
+         << "\n";
+  return report.str();
+}
+}  // namespace core_internal::rendering
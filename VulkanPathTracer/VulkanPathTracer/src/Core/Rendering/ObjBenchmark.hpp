@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace core_internal::rendering {
+struct ObjBenchmarkSettings {
+  // Best of this many runs is reported for every loader
+  uint32_t repetitions = 3;
+  // 0 uses every hardware thread
+  uint32_t threadCount = 0;
+};
+
+// Writes a flat grid of at least triangleCount triangles as an OBJ file, so
+// loaders can be measured at sizes like 1M and 50M triangles without assets
+bool writeGridObj(const std::string& path, uint64_t triangleCount);
+
+// Measures the tinyobj path and the parallel parser on one thread and on
+// every thread, and checks that they produce the same mesh. Returns a
+// printable report.
+std::string runObjBenchmark(const std::string& path,
+                            const ObjBenchmarkSettings& settings = {});
+}  // namespace core_internal::rendering
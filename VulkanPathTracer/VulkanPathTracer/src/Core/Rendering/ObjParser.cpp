@@ -0,0 +1,345 @@
+#include "ObjParser.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+#include "../../CpuResources/ParallelFor.hpp"
+#include "../Tools/HelperMacros.hpp"
+#include "../Tools/MappedFile.hpp"
+
+namespace core_internal::rendering {
+namespace {
+// Output of one chunk, merged once every chunk is parsed
+struct ObjChunk {
+  std::vector<float> vertices;
+  std::vector<uint32_t> indices;
+  // Positions in indices that hold chunk relative vertex numbers (from
+  // negative face indices) and still need the chunk's first vertex added
+  std::vector<size_t> relativeIndices;
+  // Sizes of indices at every "o", "g" or "usemtl" record, where a new shape
+  // starts
+  std::vector<size_t> shapeStarts;
+  // Sizes of indices and material names of the "usemtl" records
+  std::vector<std::pair<size_t, std::string>> materialUses;
+  // File names of the "mtllib" records
+  std::vector<std::string> materialLibraries;
+  // 1-based line of the chunk holding an invalid record, 0 if none
+  size_t errorLine = 0;
+};
+
+bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+const char* skipBlanks(const char* p, const char* end) {
+  while (p < end && isBlank(*p)) {
+    p++;
+  }
+  return p;
+}
+
+const char* skipLine(const char* p, const char* end) {
+  const void* newline = std::memchr(p, '\n', end - p);
+  return newline ? static_cast<const char*>(newline) + 1 : end;
+}
+
+// The blank separated words of [p, end) up to a newline or comment
+std::vector<std::string> splitWords(const char* p, const char* end) {
+  std::vector<std::string> words;
+  p = skipBlanks(p, end);
+  while (p < end && *p != '\n' && *p != '#') {
+    const char* wordEnd = p;
+    while (wordEnd < end && !isBlank(*wordEnd) && *wordEnd != '\n') {
+      wordEnd++;
+    }
+    words.emplace_back(p, wordEnd);
+    p = skipBlanks(wordEnd, end);
+  }
+  return words;
+}
+
+bool startsWithKeyword(const char* p, const char* end, const char* keyword) {
+  const size_t length = std::strlen(keyword);
+  return size_t(end - p) > length && std::memcmp(p, keyword, length) == 0 &&
+         isBlank(p[length]);
+}
+
+// from_chars rejects the leading '+' OBJ exporters sometimes write
+template <class T>
+const char* parseNumber(const char* p, const char* end, T& value) {
+  if (p < end && *p == '+') {
+    p++;
+  }
+  std::from_chars_result result = std::from_chars(p, end, value);
+  return result.ec == std::errc() ? result.ptr : nullptr;
+}
+
+void parseChunk(const char* p, const char* end, ObjChunk& chunk) {
+  std::vector<int64_t> polygon;
+  size_t line = 0;
+  while (p < end) {
+    line++;
+    p = skipBlanks(p, end);
+    const char* lineEnd = skipLine(p, end);
+
+    if (lineEnd - p > 2 && p[0] == 'v' && isBlank(p[1])) {
+      // "v x y z [w]", w and vertex colors are ignored
+      const char* q = p + 2;
+      for (int c = 0; c < 3 && q; c++) {
+        float value;
+        q = parseNumber(skipBlanks(q, lineEnd), lineEnd, value);
+        chunk.vertices.push_back(value);
+      }
+      if (!q) {
+        chunk.errorLine = line;
+        return;
+      }
+    } else if (lineEnd - p > 2 && p[0] == 'f' && isBlank(p[1])) {
+      // "f v1[/vt1[/vn1]] v2... ", only the position index is kept
+      polygon.clear();
+      const char* q = skipBlanks(p + 2, lineEnd);
+      while (q < lineEnd && *q != '\n' && *q != '#') {
+        int64_t index;
+        q = parseNumber(q, lineEnd, index);
+        if (!q || index == 0) {
+          chunk.errorLine = line;
+          return;
+        }
+        polygon.push_back(index);
+        while (q < lineEnd && !isBlank(*q) && *q != '\n') {
+          q++;
+        }
+        q = skipBlanks(q, lineEnd);
+      }
+
+      const int64_t chunkVertexCount = int64_t(chunk.vertices.size() / 3);
+      auto pushIndex = [&](int64_t index) {
+        if (index > 0) {
+          chunk.indices.push_back(static_cast<uint32_t>(index - 1));
+        } else {
+          chunk.relativeIndices.push_back(chunk.indices.size());
+          chunk.indices.push_back(
+              static_cast<uint32_t>(chunkVertexCount + index));
+        }
+      };
+      for (size_t i = 1; i + 1 < polygon.size(); i++) {
+        pushIndex(polygon[0]);
+        pushIndex(polygon[i]);
+        pushIndex(polygon[i + 1]);
+      }
+    } else if (lineEnd - p > 1 && (p[0] == 'o' || p[0] == 'g') &&
+               (isBlank(p[1]) || p[1] == '\n')) {
+      chunk.shapeStarts.push_back(chunk.indices.size());
+    } else if (startsWithKeyword(p, lineEnd, "usemtl")) {
+      const std::vector<std::string> words = splitWords(p + 6, lineEnd);
+      chunk.shapeStarts.push_back(chunk.indices.size());
+      chunk.materialUses.emplace_back(chunk.indices.size(),
+                                      words.empty() ? "" : words[0]);
+    } else if (startsWithKeyword(p, lineEnd, "mtllib")) {
+      for (std::string& name : splitWords(p + 6, lineEnd)) {
+        chunk.materialLibraries.push_back(std::move(name));
+      }
+    }
+    p = lineEnd;
+  }
+}
+
+// Adds the materials ("newmtl") of an MTL file that aren't defined yet.
+// Only the emission ("Ke") is read.
+bool parseMtlFile(const std::string& path,
+                  std::unordered_map<std::string, uint32_t>& materialIndices,
+                  std::vector<MeshMaterial>& materials) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    return false;
+  }
+  MeshMaterial* material = nullptr;
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream words(line);
+    std::string keyword;
+    words >> keyword;
+    if (keyword == "newmtl") {
+      std::string name;
+      words >> name;
+      material = nullptr;
+      if (materialIndices.emplace(name, uint32_t(materials.size())).second) {
+        material = &materials.emplace_back();
+      }
+    } else if (keyword == "Ke" && material) {
+      for (float& value : material->emission) {
+        words >> value;
+      }
+      if (words.fail()) {
+        *material = MeshMaterial{};
+      }
+    }
+  }
+  return true;
+}
+}  // namespace
+
+bool parseObjParallel(const std::string& path, Mesh& mesh,
+                      const ObjParseSettings& settings) {
+  tools::MappedFile file;
+  if (!file.open(path)) {
+    DEBUG_WARNING("Could not open OBJ file \"" + path + "\"");
+    return false;
+  }
+  const char* data = reinterpret_cast<const char*>(file.getData());
+  const size_t size = file.getSize();
+
+  // A few chunks per thread so uneven chunks still balance
+  const uint32_t threadCount = cpu::resolveThreadCount(settings.threadCount);
+  const size_t chunkCount = std::clamp<size_t>(
+      size / std::max<size_t>(1, settings.minChunkSize), 1,
+      size_t(threadCount) * 4);
+
+  // Chunks start right after a newline so no line is split
+  std::vector<const char*> chunkBegins(chunkCount + 1);
+  chunkBegins[0] = data;
+  chunkBegins[chunkCount] = data + size;
+  for (size_t i = 1; i < chunkCount; i++) {
+    const char* p = data + size * i / chunkCount;
+    p = skipLine(std::max(p, chunkBegins[i - 1]), data + size);
+    chunkBegins[i] = p;
+  }
+
+  std::vector<ObjChunk> chunks(chunkCount);
+  cpu::parallelFor(static_cast<uint32_t>(chunkCount), threadCount,
+                   [&](uint32_t i) {
+                     parseChunk(chunkBegins[i], chunkBegins[i + 1], chunks[i]);
+                   });
+
+  std::vector<size_t> vertexOffsets(chunkCount + 1, 0);
+  std::vector<size_t> indexOffsets(chunkCount + 1, 0);
+  for (size_t i = 0; i < chunkCount; i++) {
+    if (chunks[i].errorLine != 0) {
+      size_t line = chunks[i].errorLine;
+      for (size_t j = 0; j < i; j++) {
+        line += std::count(chunkBegins[j], chunkBegins[j + 1], '\n');
+      }
+      DEBUG_WARNING("Could not parse OBJ file \"" + path + "\": invalid " +
+                    "record at line " + std::to_string(line));
+      return false;
+    }
+    vertexOffsets[i + 1] = vertexOffsets[i] + chunks[i].vertices.size();
+    indexOffsets[i + 1] = indexOffsets[i] + chunks[i].indices.size();
+  }
+  const size_t vertexCount = vertexOffsets[chunkCount] / 3;
+
+  // Consecutive "o"/"g" records without faces in between don't make empty
+  // shapes
+  std::vector<size_t> shapeStarts = {0};
+  for (size_t i = 0; i < chunkCount; i++) {
+    for (size_t start : chunks[i].shapeStarts) {
+      if (indexOffsets[i] + start != shapeStarts.back()) {
+        shapeStarts.push_back(indexOffsets[i] + start);
+      }
+    }
+  }
+  if (shapeStarts.back() != indexOffsets[chunkCount]) {
+    shapeStarts.push_back(indexOffsets[chunkCount]);
+  }
+
+  // Material 0 is the default, the libraries add theirs in order. They are
+  // looked up next to the OBJ file.
+  std::vector<MeshMaterial> materials(1);
+  std::unordered_map<std::string, uint32_t> materialIndices;
+  const std::filesystem::path directory =
+      std::filesystem::path(path).parent_path();
+  for (const ObjChunk& chunk : chunks) {
+    for (const std::string& library : chunk.materialLibraries) {
+      const std::string libraryPath = (directory / library).string();
+      if (!parseMtlFile(libraryPath, materialIndices, materials)) {
+        DEBUG_WARNING("Could not open MTL file \"" + libraryPath + "\"");
+      }
+    }
+  }
+
+  // Every shape takes the material of the last "usemtl" at or before its
+  // start, which is also where a shape starts
+  std::vector<uint32_t> shapeMaterials(shapeStarts.size(), 0);
+  size_t shape = 0;
+  uint32_t material = 0;
+  for (size_t i = 0; i < chunkCount; i++) {
+    for (const auto& [start, name] : chunks[i].materialUses) {
+      const size_t position = indexOffsets[i] + start;
+      while (shape < shapeStarts.size() && shapeStarts[shape] < position) {
+        shapeMaterials[shape++] = material;
+      }
+      auto it = materialIndices.find(name);
+      if (it != materialIndices.end()) {
+        material = it->second;
+      } else {
+        DEBUG_WARNING("OBJ file \"" + path + "\" uses unknown material \"" +
+                      name + "\"");
+        material = 0;
+      }
+    }
+  }
+  while (shape < shapeStarts.size()) {
+    shapeMaterials[shape++] = material;
+  }
+
+  mesh.vertices = {};
+  mesh.indices = {};
+  mesh.shapes = {};
+  mesh.mapping.reset();
+  mesh.vertexStorage.clear();
+  mesh.indexStorage.clear();
+  mesh.shapeStorage.clear();
+  mesh.materials = std::move(materials);
+  for (size_t i = 0; i + 1 < shapeStarts.size(); i++) {
+    mesh.shapeStorage.push_back(
+        {static_cast<uint32_t>(shapeStarts[i]),
+         static_cast<uint32_t>(shapeStarts[i + 1] - shapeStarts[i]),
+         shapeMaterials[i]});
+  }
+  mesh.vertexStorage.resize(vertexOffsets[chunkCount]);
+  mesh.indexStorage.resize(indexOffsets[chunkCount]);
+
+  std::atomic<bool> indicesValid{true};
+  cpu::parallelFor(
+      static_cast<uint32_t>(chunkCount), threadCount, [&](uint32_t i) {
+        ObjChunk& chunk = chunks[i];
+        std::copy(chunk.vertices.begin(), chunk.vertices.end(),
+                  mesh.vertexStorage.begin() + vertexOffsets[i]);
+        const uint32_t firstVertex =
+            static_cast<uint32_t>(vertexOffsets[i] / 3);
+        for (size_t relative : chunk.relativeIndices) {
+          chunk.indices[relative] += firstVertex;
+        }
+        uint32_t maxIndex = 0;
+        for (uint32_t index : chunk.indices) {
+          maxIndex = std::max(maxIndex, index);
+        }
+        if (!chunk.indices.empty() && maxIndex >= vertexCount) {
+          indicesValid = false;
+        }
+        std::copy(chunk.indices.begin(), chunk.indices.end(),
+                  mesh.indexStorage.begin() + indexOffsets[i]);
+        // Release the chunk arrays as soon as they are merged
+        chunk = ObjChunk();
+      });
+  if (!indicesValid) {
+    DEBUG_WARNING("Could not parse OBJ file \"" + path +
+                  "\": a face references a missing vertex");
+    mesh.vertexStorage.clear();
+    mesh.indexStorage.clear();
+    mesh.shapeStorage.clear();
+    return false;
+  }
+
+  mesh.vertices = mesh.vertexStorage;
+  mesh.indices = mesh.indexStorage;
+  mesh.shapes = mesh.shapeStorage;
+  mesh.contentHash =
+      hashMesh(mesh.vertices, mesh.indices, mesh.shapes, mesh.materials);
+  return true;
+}
+}  // namespace core_internal::rendering
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "Mesh.hpp"
+
+namespace core_internal::rendering {
+struct ObjParseSettings {
+  // 0 uses every hardware thread
+  uint32_t threadCount = 0;
+  // Files are split into line aligned chunks of at least this many bytes
+  size_t minChunkSize = size_t(4) << 20;
+};
+
+// Parses the positions ("v") and faces ("f") of an OBJ file into mesh, using
+// every thread. The file is mapped and split into line aligned chunks that are
+// parsed into per-chunk arrays, which are then merged into the final arrays
+// with a single allocation each. Polygons are triangulated as fans and every
+// "o", "g" or "usemtl" record starts a new shape, so each shape has one
+// material. The materials come from the "mtllib" files next to the OBJ, read
+// after the chunks; all other records are skipped. Returns false if the file
+// can't be read or a face references a missing vertex.
+bool parseObjParallel(const std::string& path, Mesh& mesh,
+                      const ObjParseSettings& settings = {});
+}  // namespace core_internal::rendering
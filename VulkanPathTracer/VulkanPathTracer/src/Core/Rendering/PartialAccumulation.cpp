@@ -0,0 +1,151 @@
+#include "PartialAccumulation.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "../Tools/HelperMacros.hpp"
+
+namespace core_internal::rendering {
+namespace {
+constexpr char PartialMagic[8] = "VPTPART";
+constexpr uint32_t PartialVersion = 1;
+
+// Followed by rangeCount (first, last) pairs of uint32_t and the sums
+struct PartialHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t rangeCount;
+};
+}  // namespace
+
+void PartialAccumulation::assign(uint32_t width, uint32_t height,
+                                 uint32_t firstSample, uint32_t lastSample,
+                                 const float* accumulation) {
+  this->width = width;
+  this->height = height;
+  sampleRanges.assign(1, {firstSample, lastSample});
+  sums.assign(accumulation, accumulation + size_t(width) * height * 4);
+}
+
+bool mergePartialAccumulation(PartialAccumulation& partial,
+                              const PartialAccumulation& shard) {
+  if (partial.sums.empty()) {
+    partial = shard;
+    return true;
+  }
+  if (shard.width != partial.width || shard.height != partial.height) {
+    DEBUG_WARNING("Can't merge partial accumulations of different sizes");
+    return false;
+  }
+
+  std::vector<std::pair<uint32_t, uint32_t>> ranges = partial.sampleRanges;
+  ranges.insert(ranges.end(), shard.sampleRanges.begin(),
+                shard.sampleRanges.end());
+  std::sort(ranges.begin(), ranges.end());
+  for (size_t i = 1; i < ranges.size(); i++) {
+    if (ranges[i].first < ranges[i - 1].second) {
+      DEBUG_WARNING("Can't merge partial accumulations sharing samples [" +
+                    std::to_string(ranges[i].first) + ", " +
+                    std::to_string(ranges[i - 1].second) + ")");
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < partial.sums.size(); i++) {
+    partial.sums[i] += shard.sums[i];
+  }
+  partial.sampleRanges = std::move(ranges);
+  return true;
+}
+
+void resolvePartialAccumulation(const PartialAccumulation& partial,
+                                std::vector<float>& rgb) {
+  const size_t pixelCount = size_t(partial.width) * partial.height;
+  rgb.resize(pixelCount * 3);
+  for (size_t i = 0; i < pixelCount; i++) {
+    const double* sum = partial.sums.data() + 4 * i;
+    const double count = sum[3] > 0.0 ? sum[3] : 1.0;
+    for (int c = 0; c < 3; c++) {
+      rgb[3 * i + c] = static_cast<float>(sum[c] / count);
+    }
+  }
+}
+
+bool savePartialAccumulation(const std::string& path,
+                             const PartialAccumulation& partial) {
+  PartialHeader header{};
+  std::memcpy(header.magic, PartialMagic, sizeof(header.magic));
+  header.version = PartialVersion;
+  header.width = partial.width;
+  header.height = partial.height;
+  header.rangeCount = static_cast<uint32_t>(partial.sampleRanges.size());
+
+  const std::string tempPath = path + ".tmp";
+  {
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto& [first, last] : partial.sampleRanges) {
+      const uint32_t range[2] = {first, last};
+      file.write(reinterpret_cast<const char*>(range), sizeof(range));
+    }
+    file.write(reinterpret_cast<const char*>(partial.sums.data()),
+               static_cast<std::streamsize>(partial.sums.size() *
+                                            sizeof(double)));
+    if (!file.good()) {
+      file.close();
+      std::filesystem::remove(tempPath);
+      return false;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(tempPath, path, error);
+  if (error) {
+    std::filesystem::remove(tempPath, error);
+    return false;
+  }
+  return true;
+}
+
+bool loadPartialAccumulation(const std::string& path,
+                             PartialAccumulation& partial) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+
+  PartialHeader header;
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      std::memcmp(header.magic, PartialMagic, sizeof(header.magic)) != 0 ||
+      header.version != PartialVersion) {
+    return false;
+  }
+
+  PartialAccumulation loaded;
+  loaded.width = header.width;
+  loaded.height = header.height;
+  loaded.sampleRanges.resize(header.rangeCount);
+  for (auto& [first, last] : loaded.sampleRanges) {
+    uint32_t range[2];
+    if (!file.read(reinterpret_cast<char*>(range), sizeof(range))) {
+      return false;
+    }
+    first = range[0];
+    last = range[1];
+  }
+  loaded.sums.resize(size_t(header.width) * header.height * 4);
+  if (!file.read(reinterpret_cast<char*>(loaded.sums.data()),
+                 static_cast<std::streamsize>(loaded.sums.size() *
+                                              sizeof(double)))) {
+    return false;
+  }
+  partial = std::move(loaded);
+  return true;
+}
+}  // namespace core_internal::rendering
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace core_internal::rendering {
+// Sums of a share of an image's samples, so one image can be rendered in
+// shards on several queues, processes or machines and merged. The samplers
+// are stateless, so the shards trace exactly the samples a single render
+// would.
+struct PartialAccumulation {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  // Sample ranges [first, last) the sums hold, sorted and disjoint
+  std::vector<std::pair<uint32_t, uint32_t>> sampleRanges;
+  // Per pixel rgb sum and sample count, 4 values, like the accumulation
+  // buffer. Doubles, so merging adds no rounding of its own that would make
+  // the result depend on the merge order.
+  std::vector<double> sums;
+
+  // Sets the size and the single range of a shard, the sums from a float
+  // accumulation buffer of 4 floats per pixel
+  void assign(uint32_t width, uint32_t height, uint32_t firstSample,
+              uint32_t lastSample, const float* accumulation);
+};
+
+// Adds a shard of the same image to partial. Returns false and leaves
+// partial unchanged if the resolutions differ or a sample is in both.
+bool mergePartialAccumulation(PartialAccumulation& partial,
+                              const PartialAccumulation& shard);
+// Averages the sums into width * height RGB pixels
+void resolvePartialAccumulation(const PartialAccumulation& partial,
+                                std::vector<float>& rgb);
+
+bool savePartialAccumulation(const std::string& path,
+                             const PartialAccumulation& partial);
+// Returns false if the file can't be read or is not a partial accumulation
+bool loadPartialAccumulation(const std::string& path,
+                             PartialAccumulation& partial);
+}  // namespace core_internal::rendering
@@ -0,0 +1,115 @@
+#include "RenderJob.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include "../Tools/HelperMacros.hpp"
+
+namespace core_internal::rendering {
+bool parseRenderJobOption(const std::vector<std::string>& args, size_t& i,
+                          RenderJob& job) {
+  const std::string& option = args[i];
+  auto hasValues = [&](size_t count) { return i + count < args.size(); };
+  auto nextUint = [&]() {
+    return static_cast<uint32_t>(std::max(0, atoi(args[++i].c_str())));
+  };
+  auto nextFloat = [&]() {
+    return static_cast<float>(atof(args[++i].c_str()));
+  };
+
+  if (option == "--scene" && hasValues(1)) {
+    job.scenePath = args[++i];
+  } else if (option == "--out" && hasValues(1)) {
+    job.outputPath = args[++i];
+  } else if (option == "--spp" && hasValues(1)) {
+    // An image needs at least one sample
+    job.targetSamples = std::max(1u, nextUint());
+  } else if (option == "--sample-range" && hasValues(2)) {
+    job.firstSample = nextUint();
+    job.lastSample = nextUint();
+  } else if (option == "--partial" && hasValues(1)) {
+    job.partialPath = args[++i];
+  } else if (option == "--spp-per-dispatch" && hasValues(1)) {
+    job.params.samplesPerDispatch = std::max(1u, nextUint());
+  } else if (option == "--time-budget" && hasValues(1)) {
+    job.timeBudgetSeconds = atof(args[++i].c_str());
+  } else if (option == "--width" && hasValues(1)) {
+    job.params.resolution[0] = std::max(1u, nextUint());
+  } else if (option == "--height" && hasValues(1)) {
+    job.params.resolution[1] = std::max(1u, nextUint());
+  } else if (option == "--fov" && hasValues(1)) {
+    setCameraFov(job.params, nextFloat());
+  } else if (option == "--max-bounces" && hasValues(1)) {
+    job.params.maxSegments = nextUint() + 1;
+  } else if (option == "--roulette-bounces" && hasValues(1)) {
+    job.params.rouletteMinBounces = nextUint();
+  } else if (option == "--no-roulette") {
+    job.params.rouletteMinBounces = RouletteDisabled;
+  } else if (option == "--no-light-sampling") {
+    job.params.lightSampling = 0;
+  } else if (option == "--sampler" && hasValues(1)) {
+    SamplerType type;
+    if (parseSamplerType(args[++i], type)) {
+      job.params.samplerType = static_cast<uint32_t>(type);
+    } else {
+      DEBUG_WARNING("Ignoring unknown sampler \"" + args[i] + "\"");
+    }
+  } else if (option == "--dynamic-kernel") {
+    job.specializeKernel = false;
+  } else if (option == "--wavefront") {
+    job.wavefront = true;
+  } else if (option == "--camera" && hasValues(6)) {
+    // Eye position followed by the point it looks at, +y up
+    float eye[3], target[3];
+    for (int c = 0; c < 3; c++) {
+      eye[c] = nextFloat();
+    }
+    for (int c = 0; c < 3; c++) {
+      target[c] = nextFloat();
+    }
+    const float up[3] = {0.0f, 1.0f, 0.0f};
+    if (!setCameraLookAt(job.params, eye, target, up)) {
+      DEBUG_WARNING("Ignoring --camera, its eye must differ from the target");
+    }
+  } else {
+    return false;
+  }
+  return true;
+}
+
+std::vector<RenderJob> loadRenderJobs(const std::string& path,
+                                      const RenderJob& defaults) {
+  std::vector<RenderJob> jobs;
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    DEBUG_WARNING("Could not open job list \"" + path + "\"");
+    return jobs;
+  }
+
+  std::string line;
+  uint32_t lineNumber = 0;
+  while (std::getline(file, line)) {
+    lineNumber++;
+    std::vector<std::string> args;
+    std::stringstream tokens(line);
+    for (std::string token; tokens >> token;) {
+      args.push_back(token);
+    }
+    if (args.empty() || args[0][0] == '#') {
+      continue;
+    }
+
+    RenderJob job = defaults;
+    for (size_t i = 0; i < args.size(); i++) {
+      if (!parseRenderJobOption(args, i, job)) {
+        DEBUG_WARNING(path + ":" + std::to_string(lineNumber) +
+                      ": ignoring unknown option \"" + args[i] + "\"");
+      }
+    }
+    jobs.push_back(job);
+  }
+  return jobs;
+}
+}  // namespace core_internal::rendering
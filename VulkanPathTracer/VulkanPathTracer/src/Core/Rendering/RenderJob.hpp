@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "RenderParameters.hpp"
+
+namespace core_internal::rendering {
+// One image to render: the scene, how to view it and where to write it
+struct RenderJob {
+  std::string scenePath = "assets/CornellBox-Original-Merged.obj";
+  std::string outputPath = "out.hdr";
+  RenderParameters params = makeDefaultRenderParameters(800, 600);
+  // Progressive rendering stops at whichever of these is reached first
+  uint32_t targetSamples = 64;
+  double timeBudgetSeconds = 0.0;  // 0 disables the time budget
+  // Share [firstSample, lastSample) of the targetSamples samples of the
+  // image this job traces, 0 as the last sample meaning targetSamples.
+  // Shards of one image must agree on targetSamples, which the ZSobol
+  // sampler spreads its sequence by.
+  uint32_t firstSample = 0;
+  uint32_t lastSample = 0;
+  // Where the job writes its sums as a PartialAccumulation to be merged,
+  // instead of the image to outputPath. Empty writes the image.
+  std::string partialPath;
+
+  uint32_t getLastSample() const {
+    return lastSample > 0 ? std::min(lastSample, targetSamples)
+                          : targetSamples;
+  }
+  // Compile the bounce and per-dispatch sample counts into the kernel rather
+  // than reading them per dispatch, one pipeline per distinct setting
+  bool specializeKernel = true;
+  // Trace with the wavefront kernels instead of the megakernel. Same image,
+  // faster when paths have long divergent tails.
+  bool wavefront = false;
+};
+
+// Applies the option at args[i] to job and advances i past its values.
+// Returns false if args[i] is not a render option. Options:
+//   --scene <obj> --out <hdr> --width <px> --height <px> --spp <n>
+//   --spp-per-dispatch <n> --time-budget <s> --fov <degrees>
+//   --max-bounces <n> --camera <eye x y z> <target x y z> --dynamic-kernel
+//   --wavefront --roulette-bounces <n> --no-roulette --no-light-sampling
+//   --sampler <random|sobol|zsobol> --sample-range <first> <last>
+//   --partial <path>
+bool parseRenderJobOption(const std::vector<std::string>& args, size_t& i,
+                          RenderJob& job);
+
+// Reads a job list with one job per line, written as render options on top
+// of the given defaults. Blank lines and lines starting with '#' are skipped.
+std::vector<RenderJob> loadRenderJobs(const std::string& path,
+                                      const RenderJob& defaults = {});
+}  // namespace core_internal::rendering
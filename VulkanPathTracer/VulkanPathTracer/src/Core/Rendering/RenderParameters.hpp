@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "Sampler.hpp"
+
+namespace core_internal::rendering {
+// Value of RenderParameters::rouletteMinBounces that disables Russian
+// roulette, leaving maxSegments as the only path length limit
+inline constexpr uint32_t RouletteDisabled = 0xFFFFFFFFu;
+
+// Per-dispatch parameter block. Must match the push_constant block in
+// shaders/pt_common.glsl (std430 layout, 108 bytes, within the 128 byte
+// minimum together with WavefrontParameters).
+struct RenderParameters {
+  // Column-major camera to world transform. The camera looks down its -z
+  // axis with +y up, like the OBJ coordinate system.
+  float cameraToWorld[16];
+  uint32_t resolution[2];
+  // Vertical slope of the topmost rays, tan(verticalFov / 2)
+  float fovVerticalSlope;
+  // Path segments traced per sample, i.e. bounces + 1
+  uint32_t maxSegments;
+  // Samples [sampleOffset, sampleOffset + samplesPerDispatch) are traced by
+  // one dispatch; an offset of firstSample restarts accumulation
+  uint32_t sampleOffset;
+  uint32_t samplesPerDispatch;
+  // Bounces every path takes before Russian roulette may end it. Later
+  // bounces survive with the probability of the path throughput and are
+  // reweighted, so dim paths end early without biasing the image.
+  // maxSegments stays a hard cap on top.
+  uint32_t rouletteMinBounces;
+  // A SamplerType
+  uint32_t samplerType;
+  // Bits of the sample indices of the whole render, see getLog2SampleCount.
+  // Set by the render loops, the ZSobol sampler gives every pixel a run of
+  // this many bits of its sequence.
+  uint32_t log2SamplesPerPixel;
+  // First sample of the range accumulated, 0 unless a render only traces a
+  // share of the image's samples. Set by the render loops.
+  uint32_t firstSample;
+  // 1 samples the scene's emissive triangles at every bounce and weighs
+  // them against hitting the lights by chance with multiple importance
+  // sampling, 0 only finds lights by chance
+  uint32_t lightSampling;
+};
+static_assert(sizeof(RenderParameters) == 108,
+              "RenderParameters must match the pt.comp push constants");
+static_assert(offsetof(RenderParameters, resolution) == 64 &&
+                  offsetof(RenderParameters, lightSampling) == 104,
+              "RenderParameters must follow the std430 push constant offsets");
+
+// Pushed after RenderParameters for each step of the wavefront kernels in
+// shaders/wavefront.comp, the megakernel ignores it
+struct WavefrontParameters {
+  // Path segment traced by the extend and shade steps
+  uint32_t segment;
+  // Ray queue (0 or 1) they read, the shade step fills the other one
+  uint32_t queue;
+  // Sample of the dispatch the generate step starts
+  uint32_t sample;
+};
+static_assert(sizeof(WavefrontParameters) == 12,
+              "WavefrontParameters must match the pt_common.glsl push "
+              "constants");
+
+// Points the camera from eye at target. An up vector that is zero or
+// parallel to the view direction is replaced by the world axis least aligned
+// with it. Returns false and leaves params unchanged if eye and target
+// coincide or aren't finite.
+inline bool setCameraLookAt(RenderParameters& params, const float eye[3],
+                            const float target[3], const float up[3]) {
+  auto length = [](const float v[3]) {
+    return std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+  };
+  auto scale = [](float v[3], float s) {
+    v[0] *= s;
+    v[1] *= s;
+    v[2] *= s;
+  };
+  auto cross = [](const float a[3], const float b[3], float out[3]) {
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+  };
+
+  // The camera's +z axis points away from the target
+  float back[3] = {eye[0] - target[0], eye[1] - target[1], eye[2] - target[2]};
+  const float backLength = length(back);
+  if (!std::isfinite(backLength) || backLength <= 0.0f) {
+    return false;
+  }
+  scale(back, 1.0f / backLength);
+  float right[3];
+  cross(up, back, right);
+  float rightLength = length(right);
+  if (!(rightLength > 1e-6f * length(up))) {
+    float fallbackUp[3] = {0.0f, 0.0f, 0.0f};
+    int axis = 0;
+    for (int c = 1; c < 3; c++) {
+      if (std::abs(back[c]) < std::abs(back[axis])) {
+        axis = c;
+      }
+    }
+    fallbackUp[axis] = 1.0f;
+    cross(fallbackUp, back, right);
+    rightLength = length(right);
+  }
+  scale(right, 1.0f / rightLength);
+  float cameraUp[3];
+  cross(back, right, cameraUp);
+
+  float* m = params.cameraToWorld;
+  for (int i = 0; i < 3; i++) {
+    m[0 + i] = right[i];
+    m[4 + i] = cameraUp[i];
+    m[8 + i] = back[i];
+    m[12 + i] = eye[i];
+  }
+  m[3] = m[7] = m[11] = 0.0f;
+  m[15] = 1.0f;
+  return true;
+}
+
+inline void setCameraFov(RenderParameters& params, float verticalFovDegrees) {
+  params.fovVerticalSlope =
+      std::tan(0.5f * verticalFovDegrees * 3.14159265f / 180.0f);
+}
+
+// The view the renderer used before it was configurable: axis aligned at
+// (-0.001, 1, 6), looking down -z with a slope of 1/5
+inline RenderParameters makeDefaultRenderParameters(uint32_t width,
+                                                    uint32_t height) {
+  RenderParameters params{};
+  params.cameraToWorld[0] = params.cameraToWorld[5] =
+      params.cameraToWorld[10] = params.cameraToWorld[15] = 1.0f;
+  params.cameraToWorld[12] = -0.001f;
+  params.cameraToWorld[13] = 1.0f;
+  params.cameraToWorld[14] = 6.0f;
+  params.resolution[0] = width;
+  params.resolution[1] = height;
+  params.fovVerticalSlope = 1.0f / 5.0f;
+  params.maxSegments = 32;
+  params.sampleOffset = 0;
+  params.samplesPerDispatch = 8;
+  params.rouletteMinBounces = 3;
+  params.samplerType = static_cast<uint32_t>(SamplerType::Sobol);
+  params.log2SamplesPerPixel = 0;
+  params.firstSample = 0;
+  params.lightSampling = 1;
+  return params;
+}
+}  // namespace core_internal::rendering
@@ -0,0 +1,90 @@
+#include "Sampler.hpp"
+
+#include <bit>
+
+namespace core_internal::rendering {
+namespace {
+// Primitive polynomial of a Sobol dimension and its initial direction
+// numbers m_1..m_degree, as listed by Joe and Kuo. Dimension 0, the van der
+// Corput sequence, has no polynomial.
+struct SobolPolynomial {
+  uint32_t degree;
+  // Inner coefficients of the polynomial, highest first
+  uint32_t coefficients;
+  uint32_t initialNumbers[6];
+};
+
+constexpr SobolPolynomial SobolPolynomials[SobolDimensions - 1] = {
+    {1, 0, {1}},
+    {2, 1, {1, 3}},
+    {3, 1, {1, 3, 1}},
+    {3, 2, {1, 1, 1}},
+    {4, 1, {1, 1, 3, 3}},
+    {4, 4, {1, 3, 5, 13}},
+    {5, 2, {1, 1, 5, 5, 17}},
+    {5, 4, {1, 1, 5, 5, 5}},
+    {5, 7, {1, 1, 7, 11, 19}},
+    {5, 11, {1, 1, 5, 1, 1}},
+    {5, 13, {1, 1, 1, 3, 11}},
+    {5, 14, {1, 3, 5, 5, 31}},
+    {6, 1, {1, 3, 3, 9, 7, 49}},
+    {6, 13, {1, 1, 1, 15, 21, 21}},
+    {6, 16, {1, 3, 1, 13, 27, 49}},
+};
+}  // namespace
+
+const char* toString(SamplerType type) {
+  switch (type) {
+    case SamplerType::Random:
+      return "random";
+    case SamplerType::Sobol:
+      return "sobol";
+    case SamplerType::ZSobol:
+      return "zsobol";
+  }
+  return "unknown";
+}
+
+bool parseSamplerType(const std::string& name, SamplerType& type) {
+  for (SamplerType candidate :
+       {SamplerType::Random, SamplerType::Sobol, SamplerType::ZSobol}) {
+    if (name == toString(candidate)) {
+      type = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<uint32_t> makeSobolMatrices() {
+  std::vector<uint32_t> matrices(SobolDimensions * SobolMatrixColumns);
+  for (uint32_t j = 0; j < SobolMatrixColumns; j++) {
+    matrices[j] = 1u << (31 - j);
+  }
+
+  for (uint32_t d = 1; d < SobolDimensions; d++) {
+    const SobolPolynomial& polynomial = SobolPolynomials[d - 1];
+    const uint32_t s = polynomial.degree;
+    uint32_t* v = matrices.data() + d * SobolMatrixColumns;
+    for (uint32_t j = 0; j < s; j++) {
+      v[j] = polynomial.initialNumbers[j] << (31 - j);
+    }
+    // The recurrence of the polynomial, Bratley and Fox's algorithm 659
+    for (uint32_t j = s; j < SobolMatrixColumns; j++) {
+      v[j] = v[j - s] ^ (v[j - s] >> s);
+      for (uint32_t k = 1; k < s; k++) {
+        if ((polynomial.coefficients >> (s - 1 - k)) & 1) {
+          v[j] ^= v[j - k];
+        }
+      }
+    }
+  }
+  return matrices;
+}
+
+uint32_t getLog2SampleCount(uint32_t sampleCount) {
+  return sampleCount > 1
+             ? static_cast<uint32_t>(std::bit_width(sampleCount - 1))
+             : 0;
+}
+}  // namespace core_internal::rendering
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace core_internal::rendering {
+// How paths draw their random numbers, RenderParameters::samplerType. Must
+// match the SAMPLER_ constants in shaders/sampler.glsl.
+enum class SamplerType : uint32_t {
+  // Independent uniform numbers hashed from the pixel, sample index and
+  // dimension, plain Monte Carlo convergence
+  Random = 0,
+  // Owen-scrambled Sobol points, shuffled per pixel and bounce
+  Sobol = 1,
+  // One Owen-scrambled Sobol sequence over the whole image in Morton order,
+  // which also spreads the error of neighboring pixels as blue noise
+  ZSobol = 2,
+};
+
+const char* toString(SamplerType type);
+// Parses the names toString returns. Returns false for anything else.
+bool parseSamplerType(const std::string& name, SamplerType& type);
+
+// Sobol dimensions with generator matrices, each bounce draws from its own
+// block of this many. Must match SOBOL_DIMENSIONS.
+inline constexpr uint32_t SobolDimensions = 16;
+// Columns per matrix, so indices up to 2^32 stay stratified
+inline constexpr uint32_t SobolMatrixColumns = 32;
+
+// Generator matrices of the first SobolDimensions dimensions of the Sobol
+// sequence, from the direction numbers of Joe and Kuo's new-joe-kuo-6.21201.
+// Column j of dimension d is element d * SobolMatrixColumns + j and holds
+// direction number j, most significant bit first: the SobolMatrices buffer
+// of shaders/sampler.glsl.
+std::vector<uint32_t> makeSobolMatrices();
+
+// RenderParameters::log2SamplesPerPixel for renders of sampleCount samples
+// per pixel, ceil(log2(sampleCount))
+uint32_t getLog2SampleCount(uint32_t sampleCount);
+}  // namespace core_internal::rendering
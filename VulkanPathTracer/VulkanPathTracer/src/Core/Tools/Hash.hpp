@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace core_internal::rendering::tools {
+// Non-cryptographic 64-bit content hash used to key caches. Consumes 8 bytes
+// per step so hashing multi-GB meshes stays memory bound.
+inline uint64_t hashBytes(const void* data, size_t size,
+                          uint64_t seed = 0xcbf29ce484222325ull) {
+  constexpr uint64_t Multiplier = 0x9e3779b97f4a7c15ull;
+  auto mix = [](uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+  };
+
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  uint64_t h = seed ^ (size * Multiplier);
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, bytes + i, 8);
+    h = (h ^ mix(word)) * Multiplier;
+    h = (h << 29) | (h >> 35);
+  }
+  uint64_t tail = 0;
+  std::memcpy(&tail, bytes + i, size - i);
+  h ^= mix(tail ^ (size - i));
+  return mix(h);
+}
+
+inline uint64_t hashCombine(uint64_t a, uint64_t b) {
+  return hashBytes(&b, sizeof(b), a);
+}
+}  // namespace core_internal::rendering::tools
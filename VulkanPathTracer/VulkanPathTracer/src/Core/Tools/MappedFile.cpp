@@ -0,0 +1,105 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace core_internal::rendering::tools {
+MappedFile::~MappedFile() { close(); }
+
+#ifdef _WIN32
+bool MappedFile::open(const std::string& path) {
+  close();
+
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+
+  HANDLE mapping =
+      CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping == nullptr) {
+    CloseHandle(file);
+    return false;
+  }
+
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (view == nullptr) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+
+  fileHandle = file;
+  mappingHandle = mapping;
+  data = static_cast<const uint8_t*>(view);
+  size = static_cast<size_t>(fileSize.QuadPart);
+  return true;
+}
+
+void MappedFile::close() {
+  if (data != nullptr) {
+    UnmapViewOfFile(data);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+  }
+  data = nullptr;
+  size = 0;
+  fileHandle = nullptr;
+  mappingHandle = nullptr;
+}
+#else
+bool MappedFile::open(const std::string& path) {
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+
+  void* view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ,
+                    MAP_PRIVATE, fd, 0);
+  if (view == MAP_FAILED) {
+    ::close(fd);
+    return false;
+  }
+  // The arrays are streamed front to back into upload buffers
+  madvise(view, static_cast<size_t>(fileStat.st_size), MADV_SEQUENTIAL);
+
+  fileDescriptor = fd;
+  data = static_cast<const uint8_t*>(view);
+  size = static_cast<size_t>(fileStat.st_size);
+  return true;
+}
+
+void MappedFile::close() {
+  if (data != nullptr) {
+    munmap(const_cast<uint8_t*>(data), size);
+    ::close(fileDescriptor);
+  }
+  data = nullptr;
+  size = 0;
+  fileDescriptor = -1;
+}
+#endif
+}  // namespace core_internal::rendering::tools
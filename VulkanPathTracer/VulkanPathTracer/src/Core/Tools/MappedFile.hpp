@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace core_internal::rendering::tools {
+// Read-only memory mapping of a whole file. Pages are loaded by the OS on
+// first touch, so opening is cheap regardless of the file size.
+class MappedFile {
+ private:
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+#ifdef _WIN32
+  void* fileHandle = nullptr;
+  void* mappingHandle = nullptr;
+#else
+  int fileDescriptor = -1;
+#endif
+
+ public:
+  MappedFile() {}
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Returns false if the file can't be opened or is empty
+  bool open(const std::string& path);
+  void close();
+
+  bool isOpen() const { return data != nullptr; }
+  const uint8_t* getData() const { return data; }
+  size_t getSize() const { return size; }
+};
+}  // namespace core_internal::rendering::tools
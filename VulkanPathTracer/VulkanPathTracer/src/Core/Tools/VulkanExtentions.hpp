@@ -23,11 +23,25 @@ class VulkanExtentions {
   PFN_vkCopyAccelerationStructureToMemoryKHR
       pfnCopyAccelerationStructureToMemoryKHR;
   PFN_vkCreateAccelerationStructureKHR pfnCreateAccelerationStructureKHR;
+  PFN_vkDestroyAccelerationStructureKHR pfnDestroyAccelerationStructureKHR;
   PFN_vkCmdBuildAccelerationStructuresKHR pfnCmdBuildAccelerationStructuresKHR;
   PFN_vkBuildAccelerationStructuresKHR pfnBuildAccelerationStructuresKHR;
   PFN_vkCmdWriteAccelerationStructuresPropertiesKHR
       pfnCmdWriteAccelerationStructuresPropertiesKHR;
   PFN_vkCmdCopyAccelerationStructureKHR pfnCmdCopyAccelerationStructureKHR;
+  PFN_vkCmdCopyAccelerationStructureToMemoryKHR
+      pfnCmdCopyAccelerationStructureToMemoryKHR;
+  PFN_vkCmdCopyMemoryToAccelerationStructureKHR
+      pfnCmdCopyMemoryToAccelerationStructureKHR;
+  PFN_vkGetDeviceAccelerationStructureCompatibilityKHR
+      pfnGetDeviceAccelerationStructureCompatibilityKHR;
+  // VK_KHR_deferred_host_operations
+  PFN_vkCreateDeferredOperationKHR pfnCreateDeferredOperationKHR;
+  PFN_vkDestroyDeferredOperationKHR pfnDestroyDeferredOperationKHR;
+  PFN_vkDeferredOperationJoinKHR pfnDeferredOperationJoinKHR;
+  PFN_vkGetDeferredOperationResultKHR pfnGetDeferredOperationResultKHR;
+  PFN_vkGetDeferredOperationMaxConcurrencyKHR
+      pfnGetDeferredOperationMaxConcurrencyKHR;
 
   void init(VkInstance instance) {
 #ifdef VULKAN_DEBUG_EXT
@@ -66,6 +80,9 @@ class VulkanExtentions {
     pfnCreateAccelerationStructureKHR =
         reinterpret_cast<PFN_vkCreateAccelerationStructureKHR>(
             vkGetDeviceProcAddr(device, "vkCreateAccelerationStructureKHR"));
+    pfnDestroyAccelerationStructureKHR =
+        reinterpret_cast<PFN_vkDestroyAccelerationStructureKHR>(
+            vkGetDeviceProcAddr(device, "vkDestroyAccelerationStructureKHR"));
     pfnGetAccelerationStructureDeviceAddressKHR =
         reinterpret_cast<PFN_vkGetAccelerationStructureDeviceAddressKHR>(
             vkGetDeviceProcAddr(device,
@@ -83,6 +100,34 @@ class VulkanExtentions {
     pfnCmdCopyAccelerationStructureKHR =
         reinterpret_cast<PFN_vkCmdCopyAccelerationStructureKHR>(
             vkGetDeviceProcAddr(device, "vkCmdCopyAccelerationStructureKHR"));
+    pfnCmdCopyAccelerationStructureToMemoryKHR =
+        reinterpret_cast<PFN_vkCmdCopyAccelerationStructureToMemoryKHR>(
+            vkGetDeviceProcAddr(device,
+                                "vkCmdCopyAccelerationStructureToMemoryKHR"));
+    pfnCmdCopyMemoryToAccelerationStructureKHR =
+        reinterpret_cast<PFN_vkCmdCopyMemoryToAccelerationStructureKHR>(
+            vkGetDeviceProcAddr(device,
+                                "vkCmdCopyMemoryToAccelerationStructureKHR"));
+    pfnGetDeviceAccelerationStructureCompatibilityKHR =
+        reinterpret_cast<PFN_vkGetDeviceAccelerationStructureCompatibilityKHR>(
+            vkGetDeviceProcAddr(
+                device, "vkGetDeviceAccelerationStructureCompatibilityKHR"));
+    pfnCreateDeferredOperationKHR =
+        reinterpret_cast<PFN_vkCreateDeferredOperationKHR>(
+            vkGetDeviceProcAddr(device, "vkCreateDeferredOperationKHR"));
+    pfnDestroyDeferredOperationKHR =
+        reinterpret_cast<PFN_vkDestroyDeferredOperationKHR>(
+            vkGetDeviceProcAddr(device, "vkDestroyDeferredOperationKHR"));
+    pfnDeferredOperationJoinKHR =
+        reinterpret_cast<PFN_vkDeferredOperationJoinKHR>(
+            vkGetDeviceProcAddr(device, "vkDeferredOperationJoinKHR"));
+    pfnGetDeferredOperationResultKHR =
+        reinterpret_cast<PFN_vkGetDeferredOperationResultKHR>(
+            vkGetDeviceProcAddr(device, "vkGetDeferredOperationResultKHR"));
+    pfnGetDeferredOperationMaxConcurrencyKHR =
+        reinterpret_cast<PFN_vkGetDeferredOperationMaxConcurrencyKHR>(
+            vkGetDeviceProcAddr(device,
+                                "vkGetDeferredOperationMaxConcurrencyKHR"));
 #endif
   }
 };
@@ -0,0 +1,169 @@
+#include "CommandBufferManager.hpp"
+
+#include "../Tools/HelperMacros.hpp"
+
+namespace core_internal::rendering {
+CommandBufferManager::CommandBufferManager(VkDevice device,
+                                           uint32_t queueFamilyIndex,
+                                           VkQueue queue)
+    : device(device), queueFamilyIndex(queueFamilyIndex), queue(queue) {}
+
+CommandBufferManager::~CommandBufferManager() {
+  // Destroying a pool frees every buffer allocated from it
+  for (auto& [threadId, threadPool] : pools) {
+    for (auto& [cmd, fence] : threadPool->pending) {
+      vkDestroyFence(device, fence, nullptr);
+    }
+    vkDestroyCommandPool(device, threadPool->pool, nullptr);
+  }
+  for (VkFence fence : freeFences) {
+    vkDestroyFence(device, fence, nullptr);
+  }
+}
+
+VkFence CommandBufferManager::acquireFence() {
+  if (!freeFences.empty()) {
+    VkFence fence = freeFences.back();
+    freeFences.pop_back();
+    return fence;
+  }
+  VkFenceCreateInfo fenceCI{.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+  VkFence fence;
+  VK_CHECK_RESULT(vkCreateFence(device, &fenceCI, nullptr, &fence));
+  return fence;
+}
+
+void CommandBufferManager::recycleCompleted(ThreadPool& threadPool) {
+  auto& pending = threadPool.pending;
+  for (size_t i = 0; i < pending.size();) {
+    auto [cmd, fence] = pending[i];
+    if (vkGetFenceStatus(device, fence) != VK_SUCCESS) {
+      i++;
+      continue;
+    }
+    VK_CHECK_RESULT(vkResetFences(device, 1, &fence));
+    freeFences.push_back(fence);
+    threadPool.freeBuffers.push_back(cmd);
+    pending[i] = pending.back();
+    pending.pop_back();
+  }
+}
+
+VkCommandBuffer CommandBufferManager::begin() {
+  VkCommandBuffer cmd = VK_NULL_HANDLE;
+  ThreadPool* threadPool;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_ptr<ThreadPool>& slot = pools[std::this_thread::get_id()];
+    if (!slot) {
+      // Buffers are short lived and reset individually when reused
+      slot = std::make_unique<ThreadPool>();
+      VkCommandPoolCreateInfo cmdPoolInfo = {
+          .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+          .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                   VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+          .queueFamilyIndex = queueFamilyIndex,
+      };
+      VK_CHECK_RESULT(
+          vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &slot->pool));
+    }
+    threadPool = slot.get();
+
+    recycleCompleted(*threadPool);
+    if (!threadPool->freeBuffers.empty()) {
+      cmd = threadPool->freeBuffers.back();
+      threadPool->freeBuffers.pop_back();
+    }
+  }
+
+  // Only this thread touches its pool, so allocating and the implicit reset
+  // in vkBeginCommandBuffer need no lock
+  if (cmd == VK_NULL_HANDLE) {
+    VkCommandBufferAllocateInfo cmdBufAllocateInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = threadPool->pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    VK_CHECK_RESULT(
+        vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &cmd));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    owners[cmd] = threadPool;
+    threadPool->allocatedCount++;
+  }
+
+  VkCommandBufferBeginInfo cmdBufInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+  };
+  VK_CHECK_RESULT(vkBeginCommandBuffer(cmd, &cmdBufInfo));
+  return cmd;
+}
+
+void CommandBufferManager::submit(VkCommandBuffer cmd, VkFence fence,
+                                  const TimelineSync& sync) {
+  VkFence submitFence = fence;
+  if (fence == VK_NULL_HANDLE) {
+    std::lock_guard<std::mutex> lock(mutex);
+    submitFence = acquireFence();
+    owners.at(cmd)->pending.emplace_back(cmd, submitFence);
+  }
+
+  const bool waits = sync.waitSemaphore != VK_NULL_HANDLE;
+  const bool signals = sync.signalSemaphore != VK_NULL_HANDLE;
+  VkTimelineSemaphoreSubmitInfo timelineInfo{
+      .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+      .waitSemaphoreValueCount = waits ? 1u : 0u,
+      .pWaitSemaphoreValues = &sync.waitValue,
+      .signalSemaphoreValueCount = signals ? 1u : 0u,
+      .pSignalSemaphoreValues = &sync.signalValue,
+  };
+  VkSubmitInfo info{
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .pNext = (waits || signals) ? &timelineInfo : nullptr,
+      .waitSemaphoreCount = waits ? 1u : 0u,
+      .pWaitSemaphores = &sync.waitSemaphore,
+      .pWaitDstStageMask = &sync.waitStage,
+      .commandBufferCount = 1,
+      .pCommandBuffers = &cmd,
+      .signalSemaphoreCount = signals ? 1u : 0u,
+      .pSignalSemaphores = &sync.signalSemaphore,
+  };
+  std::lock_guard<std::mutex> lock(queueMutex);
+  VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &info, submitFence));
+}
+
+void CommandBufferManager::release(VkCommandBuffer cmd) {
+  std::lock_guard<std::mutex> lock(mutex);
+  owners.at(cmd)->freeBuffers.push_back(cmd);
+}
+
+void CommandBufferManager::submitAndWait(VkCommandBuffer cmd) {
+  VkFence fence;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    fence = acquireFence();
+  }
+
+  VK_CHECK_RESULT(vkEndCommandBuffer(cmd));
+  submit(cmd, fence);
+  VK_CHECK_RESULT(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
+  VK_CHECK_RESULT(vkResetFences(device, 1, &fence));
+
+  std::lock_guard<std::mutex> lock(mutex);
+  freeFences.push_back(fence);
+  owners.at(cmd)->freeBuffers.push_back(cmd);
+}
+
+CommandBufferManager::Stats CommandBufferManager::getStats() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  Stats stats;
+  stats.poolCount = static_cast<uint32_t>(pools.size());
+  for (auto& [threadId, threadPool] : pools) {
+    stats.allocatedCount += threadPool->allocatedCount;
+    stats.pendingCount += static_cast<uint32_t>(threadPool->pending.size());
+  }
+  return stats;
+}
+}  // namespace core_internal::rendering
@@ -0,0 +1,90 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace core_internal::rendering {
+// Hands out primary command buffers for one queue. Every thread allocates
+// from its own transient pool, so loader threads can record in parallel
+// without sharing a pool. Buffers are never freed while the manager lives,
+// they go back to their pool's free list and are reset when handed out
+// again:
+//  - right away when the caller releases them after waiting on its own fence
+//  - once the fence the manager attached at submission has signaled
+// A buffer must be recorded on the thread that began it, since recording
+// touches its pool. Submissions from any thread are serialized.
+class CommandBufferManager {
+ public:
+  struct Stats {
+    uint32_t poolCount = 0;
+    // Buffers allocated over the manager's lifetime, i.e. the high water mark
+    uint32_t allocatedCount = 0;
+    // Submitted without a caller fence and not yet recycled
+    uint32_t pendingCount = 0;
+  };
+
+  // Timeline semaphore operations of one submission, each skipped while its
+  // semaphore is null
+  struct TimelineSync {
+    VkSemaphore waitSemaphore = VK_NULL_HANDLE;
+    uint64_t waitValue = 0;
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkSemaphore signalSemaphore = VK_NULL_HANDLE;
+    uint64_t signalValue = 0;
+  };
+
+  CommandBufferManager(VkDevice device, uint32_t queueFamilyIndex,
+                       VkQueue queue);
+  // Every submitted buffer must have completed
+  ~CommandBufferManager();
+  CommandBufferManager(const CommandBufferManager&) = delete;
+  CommandBufferManager& operator=(const CommandBufferManager&) = delete;
+
+  // Returns a buffer of the calling thread's pool, begun for one submission
+  VkCommandBuffer begin();
+  // Submits an ended buffer. With a fence, the caller waits on it and then
+  // hands the buffer back through release(). Without one, the buffer is
+  // recycled once it completes and must not be released.
+  void submit(VkCommandBuffer cmd, VkFence fence = VK_NULL_HANDLE,
+              const TimelineSync& sync = {});
+  // Returns a buffer that is not executing to its pool, from any thread
+  void release(VkCommandBuffer cmd);
+  // Ends and submits the buffer, waits for it and recycles it
+  void submitAndWait(VkCommandBuffer cmd);
+
+  Stats getStats() const;
+  uint32_t getQueueFamilyIndex() const { return queueFamilyIndex; }
+
+ private:
+  struct ThreadPool {
+    VkCommandPool pool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> freeBuffers;
+    // Submitted without a caller fence, recycled once their fence signals
+    std::vector<std::pair<VkCommandBuffer, VkFence>> pending;
+    uint32_t allocatedCount = 0;
+  };
+
+  // Both expect mutex to be held
+  VkFence acquireFence();
+  void recycleCompleted(ThreadPool& threadPool);
+
+  VkDevice device;
+  uint32_t queueFamilyIndex;
+  VkQueue queue;
+
+  // Guards the pool map, free lists and fences, not the Vulkan pools
+  mutable std::mutex mutex;
+  // vkQueueSubmit requires external synchronization of the queue
+  std::mutex queueMutex;
+  std::unordered_map<std::thread::id, std::unique_ptr<ThreadPool>> pools;
+  // Pool every buffer came from, so any thread can release it
+  std::unordered_map<VkCommandBuffer, ThreadPool*> owners;
+  // Unsignaled fences for submissions without a caller fence
+  std::vector<VkFence> freeFences;
+};
+}  // namespace core_internal::rendering
@@ -0,0 +1,207 @@
+#include "StagingUploader.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "../Tools/HelperMacros.hpp"
+
+namespace core_internal::rendering {
+namespace {
+// Ring allocations start at this alignment so the host copies stay aligned
+constexpr VkDeviceSize RingAlignment = 64;
+}  // namespace
+
+StagingUploader::StagingUploader(VulkanDevice* device,
+                                 CommandBufferManager* transfer,
+                                 CommandBufferManager* compute,
+                                 VkDeviceSize ringSize)
+    : device(device),
+      transfer(transfer),
+      compute(compute),
+      ownershipTransfer(transfer->getQueueFamilyIndex() !=
+                        compute->getQueueFamilyIndex()) {
+  VkBufferCreateInfo ringCI{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = ringSize,
+      .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+  };
+  device->createBuffer(&ring, ringCI, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                       VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                           VMA_ALLOCATION_CREATE_MAPPED_BIT,
+                       true);
+
+  VkSemaphoreTypeCreateInfo timelineCI{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+      .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+      .initialValue = 0,
+  };
+  VkSemaphoreCreateInfo semaphoreCI{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+      .pNext = &timelineCI,
+  };
+  VK_CHECK_RESULT(vkCreateSemaphore(device->operator VkDevice(), &semaphoreCI,
+                                    nullptr, &timeline));
+}
+
+StagingUploader::~StagingUploader() {
+  waitIdle();
+  vkDestroySemaphore(device->operator VkDevice(), timeline, nullptr);
+  device->destroy(&ring);
+}
+
+bool StagingUploader::isComplete(uint64_t value) const {
+  uint64_t completed;
+  VK_CHECK_RESULT(vkGetSemaphoreCounterValue(device->operator VkDevice(),
+                                             timeline, &completed));
+  return completed >= value;
+}
+
+void StagingUploader::wait(uint64_t value) {
+  VkSemaphoreWaitInfo waitInfo{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+      .semaphoreCount = 1,
+      .pSemaphores = &timeline,
+      .pValues = &value,
+  };
+  VK_CHECK_RESULT(
+      vkWaitSemaphores(device->operator VkDevice(), &waitInfo, UINT64_MAX));
+}
+
+void StagingUploader::waitIdle() { wait(flush()); }
+
+void StagingUploader::retireCompleted() {
+  uint64_t completed;
+  VK_CHECK_RESULT(vkGetSemaphoreCounterValue(device->operator VkDevice(),
+                                             timeline, &completed));
+  while (!segments.empty() && segments.front().value <= completed) {
+    segments.pop_front();
+  }
+}
+
+VkDeviceSize StagingUploader::allocate(VkDeviceSize size) {
+  retireCompleted();
+  for (;;) {
+    // Segments are allocated in ring order, so the free space is the gap
+    // between the newest segment and the oldest. Skip the end of the ring
+    // if the allocation doesn't fit before it.
+    VkDeviceSize offset = ringHead;
+    if (offset + size > ring.size) {
+      offset = 0;
+    }
+    const bool fits = std::none_of(
+        segments.begin(), segments.end(), [&](const RingSegment& segment) {
+          return offset < segment.offset + segment.size &&
+                 segment.offset < offset + size;
+        });
+    if (fits) {
+      ringHead = (offset + size + RingAlignment - 1) & ~(RingAlignment - 1);
+      segments.push_back({offset, size, nextValue});
+      return offset;
+    }
+
+    // The oldest segment is in the way, it may still be unsubmitted
+    const uint64_t value = segments.front().value;
+    if (value == nextValue) {
+      flush();
+    }
+    wait(value);
+    retireCompleted();
+  }
+}
+
+uint64_t StagingUploader::upload(const Buffer& dst, const void* src,
+                                 VkDeviceSize size, VkDeviceSize dstOffset) {
+  // Chunks of a quarter ring keep the transfer queue busy while the host
+  // fills the next one
+  const VkDeviceSize chunkSize = ring.size / 4;
+  const auto* bytes = static_cast<const uint8_t*>(src);
+  for (VkDeviceSize done = 0; done < size;) {
+    const VkDeviceSize copySize = std::min(chunkSize, size - done);
+    const VkDeviceSize ringOffset = allocate(copySize);
+    std::memcpy(static_cast<uint8_t*>(ring.mappedData) + ringOffset,
+                bytes + done, copySize);
+    VK_CHECK_RESULT(vmaFlushAllocation(device->operator VmaAllocator(),
+                                       ring.alloc, ringOffset, copySize));
+
+    if (cmd == VK_NULL_HANDLE) {
+      cmd = transfer->begin();
+    }
+    VkBufferCopy region{
+        .srcOffset = ringOffset,
+        .dstOffset = dstOffset + done,
+        .size = copySize,
+    };
+    vkCmdCopyBuffer(cmd, ring.buffer, dst.buffer, 1, &region);
+    done += copySize;
+  }
+  if (std::find(pendingBuffers.begin(), pendingBuffers.end(), dst.buffer) ==
+      pendingBuffers.end()) {
+    pendingBuffers.push_back(dst.buffer);
+  }
+  return nextValue;
+}
+
+uint64_t StagingUploader::flush() {
+  if (cmd == VK_NULL_HANDLE) {
+    // Nothing recorded, every earlier value covers all uploads
+    return nextValue - 1;
+  }
+
+  // Release the written buffers to the compute family, or with a shared
+  // family make the copies visible to whatever runs next
+  std::vector<VkBufferMemoryBarrier> barriers(pendingBuffers.size());
+  for (size_t i = 0; i < pendingBuffers.size(); i++) {
+    barriers[i] = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask =
+            ownershipTransfer ? VkAccessFlags(0) : VK_ACCESS_MEMORY_READ_BIT,
+        .srcQueueFamilyIndex = ownershipTransfer
+                                   ? transfer->getQueueFamilyIndex()
+                                   : VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = ownershipTransfer
+                                   ? compute->getQueueFamilyIndex()
+                                   : VK_QUEUE_FAMILY_IGNORED,
+        .buffer = pendingBuffers[i],
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+    };
+  }
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       ownershipTransfer ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT
+                                         : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                       0, 0, nullptr, static_cast<uint32_t>(barriers.size()),
+                       barriers.data(), 0, nullptr);
+  VK_CHECK_RESULT(vkEndCommandBuffer(cmd));
+
+  const uint64_t value = nextValue++;
+  CommandBufferManager::TimelineSync copySync{
+      .signalSemaphore = timeline,
+      .signalValue = value,
+  };
+  transfer->submit(cmd, VK_NULL_HANDLE, copySync);
+  cmd = VK_NULL_HANDLE;
+
+  if (ownershipTransfer) {
+    // The matching acquire, ordered before later work on the compute queue
+    for (VkBufferMemoryBarrier& barrier : barriers) {
+      barrier.srcAccessMask = 0;
+      barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    }
+    VkCommandBuffer acquireCmd = compute->begin();
+    vkCmdPipelineBarrier(acquireCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr,
+                         static_cast<uint32_t>(barriers.size()),
+                         barriers.data(), 0, nullptr);
+    VK_CHECK_RESULT(vkEndCommandBuffer(acquireCmd));
+    CommandBufferManager::TimelineSync acquireSync{
+        .waitSemaphore = timeline,
+        .waitValue = value,
+        .waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+    };
+    compute->submit(acquireCmd, VK_NULL_HANDLE, acquireSync);
+  }
+  pendingBuffers.clear();
+  return value;
+}
+}  // namespace core_internal::rendering
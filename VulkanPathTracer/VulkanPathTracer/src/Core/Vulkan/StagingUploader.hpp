@@ -0,0 +1,85 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <vector>
+
+#include "CommandBufferManager.hpp"
+#include "VulkanDevice.h"
+
+namespace core_internal::rendering {
+// Uploads host data to device local buffers through a persistently mapped
+// staging ring. Data is copied into the ring right away and transferred with
+// vkCmdCopyBuffer on the transfer queue, in chunks so a large upload streams
+// through a small ring. Every flush signals the next value of a timeline
+// semaphore, which the host can poll or wait on, so mesh uploads overlap
+// with other startup work.
+//
+// When the transfer queue has its own family the destination buffers are
+// released by it and acquired by the family that runs the compute work
+// (VulkanDevice::submitCommandBuffer). The acquire is submitted right after
+// the copies and waits for them on the device, so work submitted to that
+// queue later sees the data without waiting on the host.
+//
+// Uploads must be issued from one thread at a time.
+class StagingUploader {
+ public:
+  static constexpr VkDeviceSize DefaultRingSize = VkDeviceSize(64) << 20;
+
+  // transfer records and submits the copies, compute the acquires. Both may
+  // be the same manager when there is no separate transfer family.
+  StagingUploader(VulkanDevice* device, CommandBufferManager* transfer,
+                  CommandBufferManager* compute,
+                  VkDeviceSize ringSize = DefaultRingSize);
+  // Waits for every upload
+  ~StagingUploader();
+  StagingUploader(const StagingUploader&) = delete;
+  StagingUploader& operator=(const StagingUploader&) = delete;
+
+  // Queues a copy of size bytes from src to dst at dstOffset. src can be
+  // reused once this returns; it blocks only while the ring is full. dst
+  // needs VK_BUFFER_USAGE_TRANSFER_DST_BIT. Returns the timeline value that
+  // signals once the copy completed, which requires a flush().
+  uint64_t upload(const Buffer& dst, const void* src, VkDeviceSize size,
+                  VkDeviceSize dstOffset = 0);
+  // Submits the copies queued since the last flush. Returns the value that
+  // signals once they completed.
+  uint64_t flush();
+
+  bool isComplete(uint64_t value) const;
+  void wait(uint64_t value);
+  // Flushes and waits for every upload
+  void waitIdle();
+
+  VkSemaphore getSemaphore() const { return timeline; }
+
+ private:
+  // Part of the ring holding data of the submission signaling value
+  struct RingSegment {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    uint64_t value;
+  };
+
+  // Returns the ring offset of size free bytes, waiting for earlier
+  // submissions to complete while they occupy the ring
+  VkDeviceSize allocate(VkDeviceSize size);
+  void retireCompleted();
+
+  VulkanDevice* device;
+  CommandBufferManager* transfer;
+  CommandBufferManager* compute;
+  bool ownershipTransfer;
+
+  Buffer ring{};
+  VkDeviceSize ringHead = 0;
+  std::deque<RingSegment> segments;
+
+  VkSemaphore timeline = VK_NULL_HANDLE;
+  // Value the next flush signals
+  uint64_t nextValue = 1;
+  // Copies recorded since the last flush and the buffers they write
+  VkCommandBuffer cmd = VK_NULL_HANDLE;
+  std::vector<VkBuffer> pendingBuffers;
+};
+}  // namespace core_internal::rendering
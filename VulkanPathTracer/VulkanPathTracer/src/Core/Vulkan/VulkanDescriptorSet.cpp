@@ -6,7 +6,19 @@ core_internal::rendering::VulkanDescriptorSet::VulkanDescriptorSet(
     VulkanDevice* device)
     : vulkanDevice(device) {}
 
-core_internal::rendering::VulkanDescriptorSet::~VulkanDescriptorSet() {}
+core_internal::rendering::VulkanDescriptorSet::~VulkanDescriptorSet() {
+  VkDevice device = vulkanDevice->operator VkDevice();
+  if (pipelineLayout != VK_NULL_HANDLE) {
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+  }
+  // Destroying the pool frees the set allocated from it
+  if (pool != VK_NULL_HANDLE) {
+    vkDestroyDescriptorPool(device, pool, nullptr);
+  }
+  if (layout != VK_NULL_HANDLE) {
+    vkDestroyDescriptorSetLayout(device, layout, nullptr);
+  }
+}
 
 VkDescriptorSet core_internal::rendering::VulkanDescriptorSet::getSet(
     uint32_t) {
@@ -8,12 +8,12 @@ class VulkanDescriptorSet {
  private:
   VulkanDevice* vulkanDevice;
 
-  VkDescriptorPool pool;
+  VkDescriptorPool pool = VK_NULL_HANDLE;
 
   std::vector<VkDescriptorSetLayoutBinding> bindings;
-  VkDescriptorSetLayout layout;
-  VkDescriptorSet set;
-  VkPipelineLayout pipelineLayout;
+  VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+  VkDescriptorSet set = VK_NULL_HANDLE;
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
 
  public:
   explicit VulkanDescriptorSet(core_internal::rendering::VulkanDevice*);
@@ -1,12 +1,17 @@
 #define VMA_IMPLEMENTATION
 #include "VulkanDevice.h"
 
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <map>
 #include <sstream>
 
+#include "../Tools/Hash.hpp"
 #include "../Tools/HelperMacros.hpp"
+#include "../Tools/MappedFile.hpp"
+#include "StagingUploader.hpp"
 
 namespace core_internal::rendering {
 VulkanDevice::VulkanDevice(const char *name, bool useValidation,
@@ -237,39 +242,61 @@ VulkanDevice::VulkanDevice(const char *name, bool useValidation,
 
   features = {
       .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
-      .pNext = &deviceCreateInfo.pNext,
+      .pNext = pNextChain,
       .features = enabledFeatures,
   };
 
   deviceCreateInfo.pEnabledFeatures = nullptr;
   deviceCreateInfo.pNext = &features;
 
+  // Staging uploads signal timeline semaphores, core since Vulkan 1.2
+  timelineSemaphoreFeatures = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+      .pNext = features.pNext,
+      .timelineSemaphore = VK_TRUE,
+  };
+  features.pNext = &timelineSemaphoreFeatures;
+
+  // The shaders declare their storage buffers with the scalar layout, core
+  // since Vulkan 1.2
+  scalarBlockLayoutFeatures = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SCALAR_BLOCK_LAYOUT_FEATURES,
+      .pNext = features.pNext,
+      .scalarBlockLayout = VK_TRUE,
+  };
+  features.pNext = &scalarBlockLayoutFeatures;
+
   properties = {
       .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
       .pNext = nullptr,
   };
 
-#ifdef VK_RAYTRACE
-  VkPhysicalDeviceAccelerationStructureFeaturesKHR asFeatures{
+#ifdef VULKAN_RAYTRACE
+  // Every supported acceleration structure and ray query feature is enabled,
+  // so callers can check optional ones such as host commands on the device
+  rayQueryFeatures = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR,
+      .pNext = nullptr,
+  };
+  accelFeatures = {
       .sType =
           VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR,
-      .pNext = &deviceCreateInfo.pNext,
+      .pNext = &rayQueryFeatures,
   };
-  deviceCreateInfo.pNext = &asFeatures;
-
-  VkPhysicalDeviceRayQueryFeaturesKHR rayQueryFeatures{
-      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR,
-      .pNext = &deviceCreateInfo.pNext,
+  VkPhysicalDeviceFeatures2 supportedFeatures{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+      .pNext = &accelFeatures,
   };
-  deviceCreateInfo.pNext = &rayQueryFeatures;
+  vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures);
+  rayQueryFeatures.pNext = features.pNext;
+  features.pNext = &accelFeatures;
 
   accelProperties = {
       .sType =
           VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR,
       .pNext = nullptr,
   };
-  properties.pNext = accelProperties;
-
+  properties.pNext = &accelProperties;
 #endif
 
   vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
@@ -291,6 +318,7 @@ VulkanDevice::VulkanDevice(const char *name, bool useValidation,
 
   VK_CHECK_RESULT(
       vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &device));
+  vkExt.init(device);
 
   vkGetDeviceQueue(device, queueFamilyIndices.graphics, 0, &queues.graphics);
   vkGetDeviceQueue(device, queueFamilyIndices.compute, 0, &queues.compute);
@@ -306,23 +334,35 @@ VulkanDevice::VulkanDevice(const char *name, bool useValidation,
 
   vmaCreateAllocator(&vmaAllocInfo, &allocator);
 
-  VkCommandPoolCreateInfo cmdPoolInfo = {
-      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-      .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-      .queueFamilyIndex = queueFamilyIndices.graphics,
-  };
-
-  VK_CHECK_RESULT(
-      vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &commandPool));
+  commandBuffers = new CommandBufferManager(
+      device, queueFamilyIndices.graphics, queues.graphics);
+  // Queue 0 of a shared family is the same queue, whose submissions have to
+  // go through one manager
+  transferCommandBuffers =
+      queueFamilyIndices.transfer == queueFamilyIndices.graphics
+          ? commandBuffers
+          : new CommandBufferManager(device, queueFamilyIndices.transfer,
+                                     queues.transfer);
+  uploader = new StagingUploader(this, transferCommandBuffers, commandBuffers);
 }
 
 VulkanDevice::~VulkanDevice() {
-  for (auto &shaderModule : shaderModules) {
+  for (auto &[hash, shaderModule] : shaderModules) {
     vkDestroyShaderModule(device, shaderModule, nullptr);
   }
+  if (pipelineCache) {
+    vkDestroyPipelineCache(device, pipelineCache, nullptr);
+  }
 
-  if (commandPool) {
-    vkDestroyCommandPool(device, commandPool, nullptr);
+  // Waits for the uploads still in flight
+  delete uploader;
+  if (commandBuffers) {
+    // Buffers submitted without a fence may still be executing
+    vkDeviceWaitIdle(device);
+    if (transferCommandBuffers != commandBuffers) {
+      delete transferCommandBuffers;
+    }
+    delete commandBuffers;
   }
 
   if (allocator) {
@@ -535,70 +575,130 @@ VkPipelineShaderStageCreateInfo VulkanDevice::loadShader(
       .module = shaderModule,
       .pName = "main",
   };
-  shaderModules.push_back(shaderStage.module);
   return shaderStage;
 }
 
-VkShaderModule VulkanDevice::loadShaderModule(const char *fileName) {
-  std::ifstream is(fileName, std::ios::binary | std::ios::in | std::ios::ate);
-
-  if (is.is_open()) {
-    size_t size = is.tellg();
-    is.seekg(0, std::ios::beg);
-    char *shaderCode = new char[size];
-    is.read(shaderCode, size);
-    is.close();
+VkShaderModule VulkanDevice::loadShaderModule(const char *fileName,
+                                              uint64_t *contentHash) {
+  tools::MappedFile file;
+  if (!file.open(fileName)) {
+    std::cerr << "Error: Could not open shader file \"" << fileName << "\""
+              << "\n";
+    return VK_NULL_HANDLE;
+  }
+  assert(file.getSize() % 4 == 0);
 
-    assert(size > 0);
+  const uint64_t hash = tools::hashBytes(file.getData(), file.getSize());
+  if (contentHash) {
+    *contentHash = hash;
+  }
+  auto it = shaderModules.find(hash);
+  if (it != shaderModules.end()) {
+    return it->second;
+  }
 
-    VkShaderModule shaderModule;
-    VkShaderModuleCreateInfo moduleCreateInfo{};
-    moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    moduleCreateInfo.codeSize = size;
-    moduleCreateInfo.pCode = (uint32_t *)shaderCode;
+  // SPIR-V is read straight from the mapping, which is page aligned
+  VkShaderModuleCreateInfo moduleCreateInfo{
+      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+      .codeSize = file.getSize(),
+      .pCode = reinterpret_cast<const uint32_t *>(file.getData()),
+  };
+  VkShaderModule shaderModule;
+  VK_CHECK_RESULT(
+      vkCreateShaderModule(device, &moduleCreateInfo, NULL, &shaderModule));
 
-    VK_CHECK_RESULT(
-        vkCreateShaderModule(device, &moduleCreateInfo, NULL, &shaderModule));
+  shaderModules[hash] = shaderModule;
+  return shaderModule;
+}
 
-    delete[] shaderCode;
+void VulkanDevice::initPipelineCache(const std::string &path) {
+  if (pipelineCache) {
+    vkDestroyPipelineCache(device, pipelineCache, nullptr);
+    pipelineCache = VK_NULL_HANDLE;
+  }
 
-    return shaderModule;
-  } else {
-    std::cerr << "Error: Could not open shader file \"" << fileName << "\""
-              << "\n";
-    return VK_NULL_HANDLE;
+  // Drivers reject foreign caches themselves, but checking the header first
+  // avoids handing them data from another GPU or driver version at all
+  tools::MappedFile file;
+  VkPipelineCacheHeaderVersionOne header{};
+  bool useFile = file.open(path) && file.getSize() >= sizeof(header);
+  if (useFile) {
+    std::memcpy(&header, file.getData(), sizeof(header));
+    useFile =
+        header.headerSize >= sizeof(header) &&
+        header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+        header.vendorID == properties.properties.vendorID &&
+        header.deviceID == properties.properties.deviceID &&
+        std::memcmp(header.pipelineCacheUUID,
+                    properties.properties.pipelineCacheUUID,
+                    VK_UUID_SIZE) == 0;
+    if (!useFile) {
+      DEBUG_LOG("Ignoring pipeline cache \"" + path +
+                "\" written by another device or driver\n");
+    }
   }
-}
 
-// Returns a command buffer that has been started
-VkCommandBuffer VulkanDevice::createCommandBuffer() {
-  VkCommandBufferAllocateInfo cmdBufAllocateInfo{
-      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-      .commandPool = commandPool,
-      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-      .commandBufferCount = 1,
+  VkPipelineCacheCreateInfo cacheCI{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+      .initialDataSize = useFile ? file.getSize() : 0,
+      .pInitialData = useFile ? file.getData() : nullptr,
   };
+  VK_CHECK_RESULT(
+      vkCreatePipelineCache(device, &cacheCI, nullptr, &pipelineCache));
+}
 
-  VkCommandBuffer cmdBuffer;
+bool VulkanDevice::savePipelineCache(const std::string &path) {
+  if (!pipelineCache) {
+    return false;
+  }
+  size_t size = 0;
   VK_CHECK_RESULT(
-      vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &cmdBuffer));
+      vkGetPipelineCacheData(device, pipelineCache, &size, nullptr));
+  std::vector<char> data(size);
+  VK_CHECK_RESULT(
+      vkGetPipelineCacheData(device, pipelineCache, &size, data.data()));
+
+  const std::string tempPath = path + ".tmp";
+  {
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), static_cast<std::streamsize>(size));
+    if (!file.good()) {
+      file.close();
+      std::filesystem::remove(tempPath);
+      return false;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(tempPath, path, error);
+  if (error) {
+    std::filesystem::remove(tempPath, error);
+    return false;
+  }
+  return true;
+}
 
-  VkCommandBufferBeginInfo cmdBufInfo{
-      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+VkCommandBuffer VulkanDevice::createCommandBuffer() {
+  return commandBuffers->begin();
+}
 
-  VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
+void VulkanDevice::submitCommandBuffer(VkCommandBuffer buf, VkFence fence) {
+  commandBuffers->submit(buf, fence);
+}
 
-  return cmdBuffer;
+void VulkanDevice::freeCommandBuffer(VkCommandBuffer buf) {
+  commandBuffers->release(buf);
 }
 
-void VulkanDevice::submitCommandBuffer(VkCommandBuffer buf, VkFence fence) {
-  VkSubmitInfo info{
-      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-      .commandBufferCount = 1,
-      .pCommandBuffers = &buf,
-  };
+void VulkanDevice::submitAndWait(VkCommandBuffer buf) {
+  commandBuffers->submitAndWait(buf);
+}
+
+CommandBufferManager::Stats VulkanDevice::getCommandBufferStats() const {
+  return commandBuffers->getStats();
+}
 
-  vkQueueSubmit(queues.graphics, 1, &info, fence);
+uint32_t VulkanDevice::getTimestampValidBits() const {
+  return queueFamilyProperties[queueFamilyIndices.graphics].timestampValidBits;
 }
 
 void VulkanDevice::createBuffer(Buffer *buf, const VkBufferCreateInfo &bufCI,
@@ -636,13 +736,23 @@ void VulkanDevice::createBuffer(Buffer *buf, const VkBufferCreateInfo &bufCI,
 }
 
 void VulkanDevice::copyAllocToMemory(core_internal::rendering::Buffer *buf,
-                                     void *dst) {
-  vmaCopyAllocationToMemory(allocator, buf->alloc, 0, dst, buf->size);
+                                     void *dst, VkDeviceSize size,
+                                     VkDeviceSize offset) {
+  vmaCopyAllocationToMemory(allocator, buf->alloc, offset, dst,
+                            size == VK_WHOLE_SIZE ? buf->size - offset : size);
 }
 
 void VulkanDevice::copyMemoryToAlloc(core_internal::rendering::Buffer *buf,
-                                     void *src, VkDeviceSize size) {
-  vmaCopyMemoryToAllocation(allocator, src, buf->alloc, 0, size);
+                                     const void *src, VkDeviceSize size,
+                                     VkDeviceSize offset) {
+  VkMemoryPropertyFlags memoryFlags;
+  vmaGetAllocationMemoryProperties(allocator, buf->alloc, &memoryFlags);
+  if (memoryFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    vmaCopyMemoryToAllocation(allocator, src, buf->alloc, offset, size);
+    return;
+  }
+  uploader->upload(*buf, src, size, offset);
+  uploader->waitIdle();
 }
 
 void VulkanDevice::destroy(Buffer *buf) {
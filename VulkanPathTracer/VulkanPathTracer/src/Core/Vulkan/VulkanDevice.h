@@ -5,12 +5,15 @@
 #include <vulkan/vulkan.h>
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "../Tools/VulkanExtentions.hpp"
+#include "CommandBufferManager.hpp"
 
 namespace core_internal::rendering {
 using DeviceAddress = uint64_t;
+class StagingUploader;
 
 struct Buffer {
   VkBuffer buffer;
@@ -39,16 +42,25 @@ class VulkanDevice {
   VkDevice device;
   VmaAllocator allocator;
   VkPhysicalDeviceProperties2 properties;
-  VkPhysicalDeviceAccelerationStructurePropertiesKHR accelProperties;
+  VkPhysicalDeviceAccelerationStructurePropertiesKHR accelProperties{};
+  VkPhysicalDeviceAccelerationStructureFeaturesKHR accelFeatures{};
+  VkPhysicalDeviceRayQueryFeaturesKHR rayQueryFeatures{};
+  VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures{};
+  VkPhysicalDeviceScalarBlockLayoutFeatures scalarBlockLayoutFeatures{};
   VkPhysicalDeviceFeatures2 features;
   VkPhysicalDeviceFeatures enabledFeatures;
   VkPhysicalDeviceMemoryProperties memoryProperties;
   std::vector<VkQueueFamilyProperties> queueFamilyProperties;
   std::vector<std::string> supportedDeviceExtensions;
   std::vector<std::string> supportedInstanceExtensions;
-  std::vector<VkShaderModule> shaderModules;
-  // Command pool for helper functions
-  VkCommandPool commandPool = VK_NULL_HANDLE;
+  // Every module loaded, by SPIR-V content hash
+  std::unordered_map<uint64_t, VkShaderModule> shaderModules;
+  VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+  // Per-thread command pools for the queue submitCommandBuffer uses
+  CommandBufferManager *commandBuffers = nullptr;
+  // Pools of the transfer queue, commandBuffers when it shares its family
+  CommandBufferManager *transferCommandBuffers = nullptr;
+  StagingUploader *uploader = nullptr;
 
   tools::VulkanExtentions vkExt;
 
@@ -86,6 +98,10 @@ class VulkanDevice {
   operator VkPhysicalDeviceAccelerationStructurePropertiesKHR() const {
     return accelProperties;
   };
+  // Acceleration structure features enabled on the device
+  operator VkPhysicalDeviceAccelerationStructureFeaturesKHR() const {
+    return accelFeatures;
+  };
 
   explicit VulkanDevice(const char *name, bool useValidation,
                         std::vector<const char *> enabledDeviceExtensions,
@@ -108,20 +124,52 @@ class VulkanDevice {
 
   VkPipelineShaderStageCreateInfo loadShader(std::string fileName,
                                              VkShaderStageFlagBits stage);
-  VkShaderModule loadShaderModule(const char *fileName);
+  // Maps the SPIR-V file and returns the module for its content, creating it
+  // on first use. Modules are owned by the device and shared between files
+  // with the same content. Returns VK_NULL_HANDLE if the file can't be read.
+  VkShaderModule loadShaderModule(const char *fileName,
+                                  uint64_t *contentHash = nullptr);
+
+  // Pipeline cache passed to every pipeline creation. Loads the cache saved
+  // at path, or starts empty when there is none or it was written by another
+  // device or driver (checked against pipelineCacheUUID).
+  void initPipelineCache(const std::string &path);
+  // Writes the pipeline cache to path under a temporary name and renames it
+  bool savePipelineCache(const std::string &path);
+  operator VkPipelineCache() const { return pipelineCache; };
 
   // Vk Resources
+  // Command buffers come from a pool of the calling thread and are recycled
+  // rather than freed, see CommandBufferManager. createCommandBuffer returns
+  // a begun one-time-submit buffer, which has to be recorded on that thread.
   VkCommandBuffer createCommandBuffer();
+  // With a fence, wait on it and then call freeCommandBuffer. Without one the
+  // buffer is recycled once it completes and must not be freed.
   void submitCommandBuffer(VkCommandBuffer, VkFence = nullptr);
+  void freeCommandBuffer(VkCommandBuffer);
+  // Ends and submits the buffer, waits for it and recycles it
+  void submitAndWait(VkCommandBuffer);
+  CommandBufferManager::Stats getCommandBufferStats() const;
+  // Valid bits of timestamps written on the queue submitCommandBuffer uses,
+  // 0 if it doesn't support timestamps
+  uint32_t getTimestampValidBits() const;
 
   void createBuffer(core_internal::rendering::Buffer *buf,
                     const VkBufferCreateInfo &bufCI,
                     VkMemoryPropertyFlags propertyFlags,
                     VmaAllocationCreateFlags vmaFlags = 0, bool mapped = false);
 
-  void copyAllocToMemory(core_internal::rendering::Buffer *, void *dst);
-  void copyMemoryToAlloc(core_internal::rendering::Buffer *, void *src,
-                         VkDeviceSize size);
+  // Copies size bytes from offset into the buffer, by default all of it
+  void copyAllocToMemory(core_internal::rendering::Buffer *, void *dst,
+                         VkDeviceSize size = VK_WHOLE_SIZE,
+                         VkDeviceSize offset = 0);
+  // Host visible allocations are written directly. Others go through the
+  // staging uploader, waiting for the copy, and need
+  // VK_BUFFER_USAGE_TRANSFER_DST_BIT.
+  void copyMemoryToAlloc(core_internal::rendering::Buffer *, const void *src,
+                         VkDeviceSize size, VkDeviceSize offset = 0);
+  // Asynchronous uploads on the transfer queue, see StagingUploader
+  StagingUploader &getUploader() { return *uploader; }
 
   void destroy(core_internal::rendering::Buffer *);
 };
@@ -0,0 +1,413 @@
+#include "Bvh.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <future>
+#include <sstream>
+#include <thread>
+
+namespace core_internal::rendering::cpu {
+struct Bvh::BuildContext {
+  BvhBuildSettings settings;
+  std::vector<Aabb> primitiveBounds;
+  std::vector<Vec3> primitiveCentroids;
+  uint32_t threadCount = 1;
+  std::atomic<uint32_t> activeTasks{0};
+  std::atomic<uint32_t> nodeCount{0};
+};
+
+namespace {
+struct Bin {
+  Aabb bounds;
+  uint32_t count = 0;
+};
+
+inline Vec3 loadVertex(const float* vertices, uint32_t index) {
+  return Vec3(vertices[3 * index + 0], vertices[3 * index + 1],
+              vertices[3 * index + 2]);
+}
+
+inline bool intersectAabb(const BvhNode& node, const Vec3& origin,
+                          const Vec3& invDirection, float tMin, float tMax,
+                          float& tEntry) {
+  float tx1 = (node.boundsMin[0] - origin.x) * invDirection.x;
+  float tx2 = (node.boundsMax[0] - origin.x) * invDirection.x;
+  float ty1 = (node.boundsMin[1] - origin.y) * invDirection.y;
+  float ty2 = (node.boundsMax[1] - origin.y) * invDirection.y;
+  float tz1 = (node.boundsMin[2] - origin.z) * invDirection.z;
+  float tz2 = (node.boundsMax[2] - origin.z) * invDirection.z;
+
+  float tNear = std::max({std::min(tx1, tx2), std::min(ty1, ty2),
+                          std::min(tz1, tz2), tMin});
+  float tFar = std::min({std::max(tx1, tx2), std::max(ty1, ty2),
+                         std::max(tz1, tz2), tMax});
+  tEntry = tNear;
+  return tNear <= tFar;
+}
+}  // namespace
+
+bool intersectTriangle(const Vec3& origin, const Vec3& direction,
+                       const Vec3& v0, const Vec3& v1, const Vec3& v2,
+                       float tMin, float& t, float& u, float& v) {
+  // Moller-Trumbore with back faces enabled, like an instance flagged with
+  // VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR
+  const Vec3 e1 = v1 - v0;
+  const Vec3 e2 = v2 - v0;
+  const Vec3 p = cross(direction, e2);
+  const float det = dot(e1, p);
+  if (std::abs(det) < 1e-12f) {
+    return false;
+  }
+  const float invDet = 1.0f / det;
+  const Vec3 s = origin - v0;
+  const float hitU = dot(s, p) * invDet;
+  if (hitU < 0.0f || hitU > 1.0f) {
+    return false;
+  }
+  const Vec3 q = cross(s, e1);
+  const float hitV = dot(direction, q) * invDet;
+  if (hitV < 0.0f || hitU + hitV > 1.0f) {
+    return false;
+  }
+  const float hitT = dot(e2, q) * invDet;
+  if (hitT <= tMin || hitT >= t) {
+    return false;
+  }
+  t = hitT;
+  u = hitU;
+  v = hitV;
+  return true;
+}
+
+std::string Bvh::Stats::toString() const {
+  std::stringstream ss;
+  ss << "BVH: " << nodeCount << " nodes, " << leafCount << " leaves, depth "
+     << maxDepth << ", built in " << buildMilliseconds << " ms\n";
+  return ss.str();
+}
+
+Bvh::Bvh() {}
+
+Bvh::~Bvh() {}
+
+void Bvh::build(std::span<const float> vertices,
+                std::span<const uint32_t> indices,
+                const BvhBuildSettings& settings) {
+  auto start = std::chrono::high_resolution_clock::now();
+
+  this->vertices = vertices.data();
+  this->indices = indices.data();
+  nodes.clear();
+  stats = {};
+
+  const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+  primitiveIndices.resize(triangleCount);
+  if (triangleCount == 0) {
+    return;
+  }
+
+  BuildContext ctx;
+  ctx.settings = settings;
+  ctx.settings.binCount = std::max(2u, settings.binCount);
+  ctx.settings.maxLeafSize = std::max(1u, settings.maxLeafSize);
+  ctx.threadCount = settings.threadCount;
+  if (ctx.threadCount == 0) {
+    ctx.threadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+  ctx.primitiveBounds.resize(triangleCount);
+  ctx.primitiveCentroids.resize(triangleCount);
+
+  // Per-triangle bounds are independent, so split them evenly across threads
+  {
+    auto computeBounds = [&](uint32_t begin, uint32_t end) {
+      for (uint32_t i = begin; i < end; i++) {
+        Aabb bounds;
+        bounds.grow(loadVertex(this->vertices, this->indices[3 * i + 0]));
+        bounds.grow(loadVertex(this->vertices, this->indices[3 * i + 1]));
+        bounds.grow(loadVertex(this->vertices, this->indices[3 * i + 2]));
+        ctx.primitiveBounds[i] = bounds;
+        ctx.primitiveCentroids[i] = bounds.centroid();
+        primitiveIndices[i] = i;
+      }
+    };
+    uint32_t chunk = (triangleCount + ctx.threadCount - 1) / ctx.threadCount;
+    std::vector<std::thread> workers;
+    for (uint32_t begin = chunk; begin < triangleCount; begin += chunk) {
+      workers.emplace_back(computeBounds, begin,
+                           std::min(begin + chunk, triangleCount));
+    }
+    computeBounds(0, std::min(chunk, triangleCount));
+    for (auto& worker : workers) {
+      worker.join();
+    }
+  }
+
+  BuildNode root;
+  root.first = 0;
+  root.count = triangleCount;
+  ctx.nodeCount = 1;
+  buildRecursive(ctx, root, 0);
+
+  nodes.resize(ctx.nodeCount.load());
+  uint32_t nodesUsed = 1;
+  flatten(root, 0, 0, nodesUsed);
+  assert(nodesUsed == nodes.size());
+
+  auto end = std::chrono::high_resolution_clock::now();
+  stats.nodeCount = static_cast<uint32_t>(nodes.size());
+  stats.buildMilliseconds =
+      std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void Bvh::buildRecursive(BuildContext& ctx, BuildNode& node, uint32_t depth) {
+  const BvhBuildSettings& settings = ctx.settings;
+
+  Aabb centroidBounds;
+  for (uint32_t i = node.first; i < node.first + node.count; i++) {
+    uint32_t prim = primitiveIndices[i];
+    node.bounds.grow(ctx.primitiveBounds[prim]);
+    centroidBounds.grow(ctx.primitiveCentroids[prim]);
+  }
+
+  if (node.count <= 1) {
+    return;
+  }
+
+  uint32_t* begin = primitiveIndices.data() + node.first;
+  uint32_t* end = begin + node.count;
+  uint32_t* middle = begin;
+  const Vec3 centroidExtent = centroidBounds.extent();
+  if (depth >= MedianSplitDepth) {
+    // SAH splits that peel off few primitives at a time have made the tree
+    // this deep, so halve the range on the widest centroid axis instead,
+    // which bounds the depth by MaxDepth
+    if (node.count <= settings.maxLeafSize) {
+      return;
+    }
+    int axis = 0;
+    for (int a = 1; a < 3; a++) {
+      if (centroidExtent[a] > centroidExtent[axis]) {
+        axis = a;
+      }
+    }
+    middle = begin + node.count / 2;
+    std::nth_element(begin, middle, end, [&](uint32_t a, uint32_t b) {
+      return ctx.primitiveCentroids[a][axis] <
+             ctx.primitiveCentroids[b][axis];
+    });
+    splitNode(ctx, node, static_cast<uint32_t>(middle - begin), depth);
+    return;
+  }
+
+  // Binned SAH: evaluate binCount - 1 candidate planes per axis
+  const uint32_t binCount = settings.binCount;
+  float bestCost = std::numeric_limits<float>::max();
+  int bestAxis = -1;
+  uint32_t bestSplit = 0;
+
+  std::vector<Bin> bins(binCount);
+  std::vector<float> rightAreas(binCount);
+  std::vector<uint32_t> rightCounts(binCount);
+
+  for (int axis = 0; axis < 3; axis++) {
+    if (centroidExtent[axis] <= 0.0f) {
+      continue;
+    }
+    std::fill(bins.begin(), bins.end(), Bin{});
+    const float scale = float(binCount) / centroidExtent[axis];
+    const float axisMin = centroidBounds.min[axis];
+    for (uint32_t i = node.first; i < node.first + node.count; i++) {
+      uint32_t prim = primitiveIndices[i];
+      uint32_t binIdx = std::min(
+          binCount - 1,
+          uint32_t((ctx.primitiveCentroids[prim][axis] - axisMin) * scale));
+      bins[binIdx].count++;
+      bins[binIdx].bounds.grow(ctx.primitiveBounds[prim]);
+    }
+
+    // Sweep from the right to get the area/count of every right partition
+    Aabb rightBounds;
+    uint32_t rightCount = 0;
+    for (uint32_t i = binCount - 1; i > 0; i--) {
+      rightBounds.grow(bins[i].bounds);
+      rightCount += bins[i].count;
+      rightAreas[i] = rightBounds.surfaceArea();
+      rightCounts[i] = rightCount;
+    }
+
+    Aabb leftBounds;
+    uint32_t leftCount = 0;
+    for (uint32_t i = 0; i < binCount - 1; i++) {
+      leftBounds.grow(bins[i].bounds);
+      leftCount += bins[i].count;
+      if (leftCount == 0 || rightCounts[i + 1] == 0) {
+        continue;
+      }
+      float cost = leftBounds.surfaceArea() * leftCount +
+                   rightAreas[i + 1] * rightCounts[i + 1];
+      if (cost < bestCost) {
+        bestCost = cost;
+        bestAxis = axis;
+        bestSplit = i + 1;
+      }
+    }
+  }
+
+  const float parentArea = node.bounds.surfaceArea();
+  const float leafCost = settings.intersectionCost * node.count;
+  const float splitCost =
+      settings.traversalCost +
+      settings.intersectionCost * bestCost / std::max(parentArea, 1e-20f);
+
+  if (node.count <= settings.maxLeafSize &&
+      (bestAxis < 0 || splitCost >= leafCost)) {
+    return;
+  }
+
+  if (bestAxis >= 0) {
+    const float scale = float(binCount) / centroidExtent[bestAxis];
+    const float axisMin = centroidBounds.min[bestAxis];
+    middle = std::partition(begin, end, [&](uint32_t prim) {
+      uint32_t binIdx = std::min(
+          binCount - 1,
+          uint32_t((ctx.primitiveCentroids[prim][bestAxis] - axisMin) * scale));
+      return binIdx < bestSplit;
+    });
+  }
+  // Degenerate centroids (or float round-off) give no usable plane: fall back
+  // to an object median so oversized leaves still get split
+  if (middle == begin || middle == end) {
+    middle = begin + node.count / 2;
+  }
+  splitNode(ctx, node, static_cast<uint32_t>(middle - begin), depth);
+}
+
+void Bvh::splitNode(BuildContext& ctx, BuildNode& node, uint32_t leftCount,
+                    uint32_t depth) {
+  const BvhBuildSettings& settings = ctx.settings;
+  node.children[0] = std::make_unique<BuildNode>();
+  node.children[1] = std::make_unique<BuildNode>();
+  node.children[0]->first = node.first;
+  node.children[0]->count = leftCount;
+  node.children[1]->first = node.first + leftCount;
+  node.children[1]->count = node.count - leftCount;
+  ctx.nodeCount += 2;
+
+  // Top-level splits operate on disjoint primitive ranges, so the left
+  // subtree can be handed to another thread while this one builds the right
+  bool spawn = false;
+  if (node.count > settings.parallelThreshold) {
+    spawn = ctx.activeTasks.fetch_add(1) + 1 < ctx.threadCount;
+    if (!spawn) {
+      ctx.activeTasks--;
+    }
+  }
+  if (spawn) {
+    auto left = std::async(std::launch::async, [&]() {
+      buildRecursive(ctx, *node.children[0], depth + 1);
+    });
+    buildRecursive(ctx, *node.children[1], depth + 1);
+    left.get();
+    ctx.activeTasks--;
+  } else {
+    buildRecursive(ctx, *node.children[0], depth + 1);
+    buildRecursive(ctx, *node.children[1], depth + 1);
+  }
+}
+
+void Bvh::flatten(const BuildNode& node, uint32_t nodeIdx, uint32_t depth,
+                  uint32_t& nodesUsed) {
+  BvhNode& flat = nodes[nodeIdx];
+  flat.boundsMin[0] = node.bounds.min.x;
+  flat.boundsMin[1] = node.bounds.min.y;
+  flat.boundsMin[2] = node.bounds.min.z;
+  flat.boundsMax[0] = node.bounds.max.x;
+  flat.boundsMax[1] = node.bounds.max.y;
+  flat.boundsMax[2] = node.bounds.max.z;
+  stats.maxDepth = std::max(stats.maxDepth, depth);
+
+  if (!node.children[0]) {
+    flat.leftFirst = node.first;
+    flat.primitiveCount = node.count;
+    stats.leafCount++;
+    return;
+  }
+
+  uint32_t leftIdx = nodesUsed;
+  nodesUsed += 2;
+  flat.leftFirst = leftIdx;
+  flat.primitiveCount = 0;
+  flatten(*node.children[0], leftIdx, depth + 1, nodesUsed);
+  flatten(*node.children[1], leftIdx + 1, depth + 1, nodesUsed);
+}
+
+bool Bvh::intersect(const Vec3& origin, const Vec3& direction, float tMin,
+                    float tMax, BvhHit& hit) const {
+  if (nodes.empty()) {
+    return false;
+  }
+
+  const Vec3 invDirection(1.0f / direction.x, 1.0f / direction.y,
+                          1.0f / direction.z);
+  hit.t = tMax;
+  hit.primitiveID = std::numeric_limits<uint32_t>::max();
+
+  float tEntry;
+  if (!intersectAabb(nodes[0], origin, invDirection, tMin, hit.t, tEntry)) {
+    return false;
+  }
+
+  uint32_t stack[MaxStackSize];
+  uint32_t stackSize = 0;
+  uint32_t nodeIdx = 0;
+
+  while (true) {
+    const BvhNode& node = nodes[nodeIdx];
+    if (node.isLeaf()) {
+      for (uint32_t i = 0; i < node.primitiveCount; i++) {
+        uint32_t prim = primitiveIndices[node.leftFirst + i];
+        const Vec3 v0 = loadVertex(vertices, indices[3 * prim + 0]);
+        const Vec3 v1 = loadVertex(vertices, indices[3 * prim + 1]);
+        const Vec3 v2 = loadVertex(vertices, indices[3 * prim + 2]);
+        if (intersectTriangle(origin, direction, v0, v1, v2, tMin, hit.t,
+                              hit.u, hit.v)) {
+          hit.primitiveID = prim;
+        }
+      }
+    } else {
+      // Visit the nearer child first and defer the other one
+      uint32_t nearIdx = node.leftFirst;
+      uint32_t farIdx = node.leftFirst + 1;
+      float tNear, tFar;
+      bool hitNear = intersectAabb(nodes[nearIdx], origin, invDirection, tMin,
+                                   hit.t, tNear);
+      bool hitFar = intersectAabb(nodes[farIdx], origin, invDirection, tMin,
+                                  hit.t, tFar);
+      if (hitNear && hitFar) {
+        if (tFar < tNear) {
+          std::swap(nearIdx, farIdx);
+        }
+        assert(stackSize < MaxStackSize);
+        stack[stackSize++] = farIdx;
+        nodeIdx = nearIdx;
+        continue;
+      } else if (hitNear) {
+        nodeIdx = nearIdx;
+        continue;
+      } else if (hitFar) {
+        nodeIdx = farIdx;
+        continue;
+      }
+    }
+
+    if (stackSize == 0) {
+      break;
+    }
+    nodeIdx = stack[--stackSize];
+  }
+
+  return hit.isValid();
+}
+}  // namespace core_internal::rendering::cpu
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "CpuMath.hpp"
+
+namespace core_internal::rendering::cpu {
+struct Aabb {
+  Vec3 min{std::numeric_limits<float>::max()};
+  Vec3 max{-std::numeric_limits<float>::max()};
+
+  void grow(const Vec3& p) {
+    min = cpu::min(min, p);
+    max = cpu::max(max, p);
+  }
+  void grow(const Aabb& b) {
+    min = cpu::min(min, b.min);
+    max = cpu::max(max, b.max);
+  }
+  Vec3 extent() const { return max - min; }
+  Vec3 centroid() const { return (min + max) * 0.5f; }
+  float surfaceArea() const {
+    Vec3 e = extent();
+    if (e.x < 0.0f) {
+      return 0.0f;
+    }
+    return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+  }
+};
+
+// 32 byte flattened node. Interior nodes store their children next to each
+// other, so leftFirst is the left child and leftFirst + 1 the right one.
+// Leaves store the offset of their first primitive in the primitive index
+// array instead.
+struct BvhNode {
+  float boundsMin[3];
+  uint32_t leftFirst;
+  float boundsMax[3];
+  uint32_t primitiveCount;  // 0 for interior nodes
+
+  bool isLeaf() const { return primitiveCount > 0; }
+};
+static_assert(sizeof(BvhNode) == 32, "BvhNode must stay 32 bytes");
+
+struct BvhHit {
+  float t = std::numeric_limits<float>::max();
+  float u = 0.0f;
+  float v = 0.0f;
+  uint32_t primitiveID = std::numeric_limits<uint32_t>::max();
+
+  bool isValid() const {
+    return primitiveID != std::numeric_limits<uint32_t>::max();
+  }
+};
+
+struct BvhBuildSettings {
+  uint32_t binCount = 16;
+  uint32_t maxLeafSize = 4;
+  // Nodes with more primitives than this build their children in parallel
+  uint32_t parallelThreshold = 16384;
+  // 0 uses every hardware thread
+  uint32_t threadCount = 0;
+  float traversalCost = 1.0f;
+  float intersectionCost = 1.0f;
+};
+
+// Host side BVH over the same vertex/index arrays that are uploaded for the
+// BLAS. Built top-down with binned SAH; subtrees above parallelThreshold
+// primitives are split off to worker threads.
+class Bvh {
+ private:
+  struct BuildNode {
+    Aabb bounds;
+    uint32_t first = 0;
+    uint32_t count = 0;
+    std::unique_ptr<BuildNode> children[2];
+  };
+
+  struct BuildContext;
+
+  const float* vertices = nullptr;
+  const uint32_t* indices = nullptr;
+
+  std::vector<BvhNode> nodes;
+  std::vector<uint32_t> primitiveIndices;
+
+  struct Stats {
+    uint32_t nodeCount = 0;
+    uint32_t leafCount = 0;
+    uint32_t maxDepth = 0;
+    double buildMilliseconds = 0.0;
+
+    std::string toString() const;
+  } stats;
+
+  void buildRecursive(BuildContext& ctx, BuildNode& node, uint32_t depth);
+  // Gives node two children over its first leftCount primitives and the
+  // rest, and builds them
+  void splitNode(BuildContext& ctx, BuildNode& node, uint32_t leftCount,
+                 uint32_t depth);
+  void flatten(const BuildNode& node, uint32_t nodeIdx, uint32_t depth,
+               uint32_t& nodesUsed);
+
+ public:
+  // Deepest level the builder creates, whatever the input. Below
+  // MedianSplitDepth every split halves its range, so even 2^32 primitives
+  // reach leaves within 32 more levels. Traversal pushes at most one entry
+  // per level, so MaxDepth entries always suffice.
+  static constexpr uint32_t MaxDepth = 128;
+  static constexpr uint32_t MedianSplitDepth = MaxDepth - 32;
+  static constexpr uint32_t MaxStackSize = MaxDepth;
+
+  Bvh();
+  ~Bvh();
+
+  void build(std::span<const float> vertices,
+             std::span<const uint32_t> indices,
+             const BvhBuildSettings& settings = {});
+
+  // Closest hit in (tMin, tMax), back faces included
+  bool intersect(const Vec3& origin, const Vec3& direction, float tMin,
+                 float tMax, BvhHit& hit) const;
+
+  const std::vector<BvhNode>& getNodes() const { return nodes; }
+  const std::vector<uint32_t>& getPrimitiveIndices() const {
+    return primitiveIndices;
+  }
+  const float* getVertices() const { return vertices; }
+  const uint32_t* getIndices() const { return indices; }
+
+  std::string getStatistics() const { return stats.toString(); }
+};
+
+bool intersectTriangle(const Vec3& origin, const Vec3& direction,
+                       const Vec3& v0, const Vec3& v1, const Vec3& v2,
+                       float tMin, float& t, float& u, float& v);
+}  // namespace core_internal::rendering::cpu
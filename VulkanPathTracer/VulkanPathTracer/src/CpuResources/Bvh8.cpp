@@ -0,0 +1,488 @@
+#include "Bvh8.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+
+#include "Simd.hpp"
+
+namespace core_internal::rendering::cpu {
+namespace {
+struct StackEntry {
+  uint32_t ref;
+  uint32_t primitiveCount;  // 0 for interior nodes
+  float tNear;
+};
+
+struct vec3f8 {
+  vfloat8 x, y, z;
+};
+
+inline vec3f8 operator-(const vec3f8& a, const vec3f8& b) {
+  return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+inline vfloat8 dot(const vec3f8& a, const vec3f8& b) {
+  return fmadd(a.x, b.x, fmadd(a.y, b.y, a.z * b.z));
+}
+inline vec3f8 cross(const vec3f8& a, const vec3f8& b) {
+  return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
+          a.x * b.y - a.y * b.x};
+}
+inline vec3f8 broadcast(const float* v) {
+  return {vfloat8::broadcast(v[0]), vfloat8::broadcast(v[1]),
+          vfloat8::broadcast(v[2])};
+}
+
+inline Aabb toAabb(const BvhNode& node) {
+  Aabb bounds;
+  bounds.min = Vec3(node.boundsMin[0], node.boundsMin[1], node.boundsMin[2]);
+  bounds.max = Vec3(node.boundsMax[0], node.boundsMax[1], node.boundsMax[2]);
+  return bounds;
+}
+
+// Pushes the children selected by hitMask so the nearest one is popped first
+inline void pushSorted(const Bvh8Node& node, uint32_t hitMask,
+                       const float* tNear, StackEntry* stack,
+                       uint32_t& stackSize) {
+  StackEntry entries[8];
+  uint32_t count = 0;
+  while (hitMask) {
+    uint32_t i = 0;
+    while (!(hitMask & (1u << i))) {
+      i++;
+    }
+    hitMask &= hitMask - 1;
+    entries[count++] = {node.child[i], node.primitiveCount[i], tNear[i]};
+  }
+  std::sort(entries, entries + count,
+            [](const StackEntry& a, const StackEntry& b) {
+              return a.tNear > b.tNear;
+            });
+  assert(stackSize + count <= Bvh8::MaxStackSize);
+  for (uint32_t i = 0; i < count; i++) {
+    stack[stackSize++] = entries[i];
+  }
+}
+
+inline bool intersectTriangle(const Bvh8Triangle& tri, const Vec3& origin,
+                              const Vec3& direction, float tMin, float& t,
+                              float& u, float& v) {
+  const Vec3 v0(tri.v0[0], tri.v0[1], tri.v0[2]);
+  const Vec3 e1(tri.e1[0], tri.e1[1], tri.e1[2]);
+  const Vec3 e2(tri.e2[0], tri.e2[1], tri.e2[2]);
+  const Vec3 p = cross(direction, e2);
+  const float det = dot(e1, p);
+  if (std::abs(det) < 1e-12f) {
+    return false;
+  }
+  const float invDet = 1.0f / det;
+  const Vec3 s = origin - v0;
+  const float hitU = dot(s, p) * invDet;
+  if (hitU < 0.0f || hitU > 1.0f) {
+    return false;
+  }
+  const Vec3 q = cross(s, e1);
+  const float hitV = dot(direction, q) * invDet;
+  if (hitV < 0.0f || hitU + hitV > 1.0f) {
+    return false;
+  }
+  const float hitT = dot(e2, q) * invDet;
+  if (hitT <= tMin || hitT >= t) {
+    return false;
+  }
+  t = hitT;
+  u = hitU;
+  v = hitV;
+  return true;
+}
+}  // namespace
+
+std::string Bvh8::Stats::toString() const {
+  std::stringstream ss;
+  ss << "BVH8 (" << simdIsaName() << "): " << nodeCount << " nodes, "
+     << leafCount << " leaves, " << triangleCount << " triangles, "
+     << averageChildren << " children/node, collapsed in "
+     << collapseMilliseconds << " ms\n";
+  return ss.str();
+}
+
+Bvh8::Bvh8() {}
+
+Bvh8::~Bvh8() {}
+
+void Bvh8::build(const Bvh& bvh) {
+  auto start = std::chrono::high_resolution_clock::now();
+
+  nodes.clear();
+  triangles.clear();
+  stats = {};
+
+  if (bvh.getNodes().empty()) {
+    return;
+  }
+
+  nodes.reserve(bvh.getNodes().size() / 4 + 1);
+  triangles.reserve(bvh.getPrimitiveIndices().size());
+  collapseNode(bvh, 0);
+
+  uint32_t childCount = 0;
+  for (const auto& node : nodes) {
+    for (uint32_t i = 0; i < 8; i++) {
+      childCount += (node.validMask >> i) & 1;
+    }
+  }
+
+  auto end = std::chrono::high_resolution_clock::now();
+  stats.nodeCount = static_cast<uint32_t>(nodes.size());
+  stats.triangleCount = static_cast<uint32_t>(triangles.size());
+  stats.averageChildren = double(childCount) / double(nodes.size());
+  stats.collapseMilliseconds =
+      std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+uint32_t Bvh8::collapseNode(const Bvh& bvh, uint32_t binaryNodeIdx) {
+  const std::vector<BvhNode>& binaryNodes = bvh.getNodes();
+  const uint32_t nodeIdx = static_cast<uint32_t>(nodes.size());
+  nodes.emplace_back();
+
+  // Open up the interior child with the largest surface area until the node
+  // is full or only leaves are left
+  uint32_t children[8];
+  uint32_t childCount = 0;
+  if (binaryNodes[binaryNodeIdx].isLeaf()) {
+    children[childCount++] = binaryNodeIdx;
+  } else {
+    children[childCount++] = binaryNodes[binaryNodeIdx].leftFirst;
+    children[childCount++] = binaryNodes[binaryNodeIdx].leftFirst + 1;
+  }
+  while (childCount < 8) {
+    int best = -1;
+    float bestArea = -1.0f;
+    for (uint32_t i = 0; i < childCount; i++) {
+      const BvhNode& child = binaryNodes[children[i]];
+      float area = toAabb(child).surfaceArea();
+      if (!child.isLeaf() && area > bestArea) {
+        best = int(i);
+        bestArea = area;
+      }
+    }
+    if (best < 0) {
+      break;
+    }
+    uint32_t left = binaryNodes[children[best]].leftFirst;
+    children[best] = left;
+    children[childCount++] = left + 1;
+  }
+
+  Bvh8Node node{};
+  Aabb bounds;
+  for (uint32_t i = 0; i < childCount; i++) {
+    bounds.grow(toAabb(binaryNodes[children[i]]));
+  }
+
+  // Power of two scales keep q * scale exact, so the traversal kernels
+  // dequantize to exactly the planes that were validated here
+  float scale[3];
+  for (int axis = 0; axis < 3; axis++) {
+    const float extent = bounds.max[axis] - bounds.min[axis];
+    int exponent = -126;
+    if (extent > 0.0f) {
+      exponent = int(std::ceil(std::log2(extent / 255.0f)));
+      exponent = std::clamp(exponent, -126, 127);
+      while (exponent < 127 && std::ldexp(255.0f, exponent) < extent) {
+        exponent++;
+      }
+    }
+    node.origin[axis] = bounds.min[axis];
+    node.exponent[axis] = static_cast<int8_t>(exponent);
+    scale[axis] = std::ldexp(1.0f, exponent);
+  }
+
+  auto quantize = [&](int axis, float lo, float hi, uint8_t& qLo,
+                      uint8_t& qHi) {
+    const float origin = node.origin[axis];
+    int lower =
+        std::clamp(int(std::floor((lo - origin) / scale[axis])), 0, 255);
+    int upper =
+        std::clamp(int(std::ceil((hi - origin) / scale[axis])), 0, 255);
+    while (lower > 0 && origin + float(lower) * scale[axis] > lo) {
+      lower--;
+    }
+    while (upper < 255 && origin + float(upper) * scale[axis] < hi) {
+      upper++;
+    }
+    qLo = static_cast<uint8_t>(lower);
+    qHi = static_cast<uint8_t>(upper);
+  };
+
+  for (uint32_t i = 0; i < childCount; i++) {
+    const BvhNode& child = binaryNodes[children[i]];
+    node.validMask |= uint8_t(1u << i);
+    quantize(0, child.boundsMin[0], child.boundsMax[0], node.lowerX[i],
+             node.upperX[i]);
+    quantize(1, child.boundsMin[1], child.boundsMax[1], node.lowerY[i],
+             node.upperY[i]);
+    quantize(2, child.boundsMin[2], child.boundsMax[2], node.lowerZ[i],
+             node.upperZ[i]);
+
+    if (child.isLeaf()) {
+      assert(child.primitiveCount <= 255);
+      node.child[i] = static_cast<uint32_t>(triangles.size());
+      node.primitiveCount[i] = static_cast<uint8_t>(child.primitiveCount);
+      for (uint32_t p = 0; p < child.primitiveCount; p++) {
+        uint32_t prim = bvh.getPrimitiveIndices()[child.leftFirst + p];
+        const float* vertices = bvh.getVertices();
+        const uint32_t* indices = bvh.getIndices();
+        const float* v0 = vertices + 3 * indices[3 * prim + 0];
+        const float* v1 = vertices + 3 * indices[3 * prim + 1];
+        const float* v2 = vertices + 3 * indices[3 * prim + 2];
+        Bvh8Triangle tri;
+        for (int axis = 0; axis < 3; axis++) {
+          tri.v0[axis] = v0[axis];
+          tri.e1[axis] = v1[axis] - v0[axis];
+          tri.e2[axis] = v2[axis] - v0[axis];
+        }
+        tri.primitiveID = prim;
+        triangles.push_back(tri);
+      }
+      stats.leafCount++;
+    } else {
+      node.primitiveCount[i] = 0;
+      node.child[i] = collapseNode(bvh, children[i]);
+    }
+  }
+
+  nodes[nodeIdx] = node;
+  return nodeIdx;
+}
+
+bool Bvh8::intersect(const Vec3& origin, const Vec3& direction, float tMin,
+                     float tMax, BvhHit& hit,
+                     bool terminateOnFirstHit) const {
+  hit.t = tMax;
+  hit.primitiveID = UINT32_MAX;
+  if (nodes.empty()) {
+    return false;
+  }
+
+  const Vec3 invDirection(1.0f / direction.x, 1.0f / direction.y,
+                          1.0f / direction.z);
+  // Slab planes are evaluated as (plane - origin) * invDirection. The
+  // cheaper plane * invDirection - origin * invDirection turns into
+  // inf - inf = NaN on axes the ray runs parallel to, dropping the child.
+  const vfloat8 invDirX = vfloat8::broadcast(invDirection.x);
+  const vfloat8 invDirY = vfloat8::broadcast(invDirection.y);
+  const vfloat8 invDirZ = vfloat8::broadcast(invDirection.z);
+  const vfloat8 rayOriginX = vfloat8::broadcast(origin.x);
+  const vfloat8 rayOriginY = vfloat8::broadcast(origin.y);
+  const vfloat8 rayOriginZ = vfloat8::broadcast(origin.z);
+  const vfloat8 tMinV = vfloat8::broadcast(tMin);
+
+  StackEntry stack[MaxStackSize];
+  uint32_t stackSize = 0;
+  stack[stackSize++] = {0, 0, tMin};
+
+  alignas(32) float tNear[8];
+  while (stackSize > 0) {
+    const StackEntry entry = stack[--stackSize];
+    if (entry.tNear > hit.t) {
+      continue;
+    }
+
+    if (entry.primitiveCount > 0) {
+      for (uint32_t i = 0; i < entry.primitiveCount; i++) {
+        const Bvh8Triangle& tri = triangles[entry.ref + i];
+        if (intersectTriangle(tri, origin, direction, tMin, hit.t, hit.u,
+                              hit.v)) {
+          hit.primitiveID = tri.primitiveID;
+          if (terminateOnFirstHit) {
+            return true;
+          }
+        }
+      }
+      continue;
+    }
+
+    const Bvh8Node& node = nodes[entry.ref];
+    const vfloat8 nodeOriginX = vfloat8::broadcast(node.origin[0]);
+    const vfloat8 nodeOriginY = vfloat8::broadcast(node.origin[1]);
+    const vfloat8 nodeOriginZ = vfloat8::broadcast(node.origin[2]);
+    const vfloat8 scaleX =
+        vfloat8::broadcast(std::ldexp(1.0f, node.exponent[0]));
+    const vfloat8 scaleY =
+        vfloat8::broadcast(std::ldexp(1.0f, node.exponent[1]));
+    const vfloat8 scaleZ =
+        vfloat8::broadcast(std::ldexp(1.0f, node.exponent[2]));
+
+    const vfloat8 tLoX =
+        (fmadd(vfloat8::fromBytes(node.lowerX), scaleX, nodeOriginX) -
+         rayOriginX) *
+        invDirX;
+    const vfloat8 tHiX =
+        (fmadd(vfloat8::fromBytes(node.upperX), scaleX, nodeOriginX) -
+         rayOriginX) *
+        invDirX;
+    const vfloat8 tLoY =
+        (fmadd(vfloat8::fromBytes(node.lowerY), scaleY, nodeOriginY) -
+         rayOriginY) *
+        invDirY;
+    const vfloat8 tHiY =
+        (fmadd(vfloat8::fromBytes(node.upperY), scaleY, nodeOriginY) -
+         rayOriginY) *
+        invDirY;
+    const vfloat8 tLoZ =
+        (fmadd(vfloat8::fromBytes(node.lowerZ), scaleZ, nodeOriginZ) -
+         rayOriginZ) *
+        invDirZ;
+    const vfloat8 tHiZ =
+        (fmadd(vfloat8::fromBytes(node.upperZ), scaleZ, nodeOriginZ) -
+         rayOriginZ) *
+        invDirZ;
+
+    const vfloat8 entryT = max(max(min(tLoX, tHiX), min(tLoY, tHiY)),
+                               max(min(tLoZ, tHiZ), tMinV));
+    const vfloat8 exitT =
+        min(min(max(tLoX, tHiX), max(tLoY, tHiY)),
+            min(max(tLoZ, tHiZ), vfloat8::broadcast(hit.t)));
+    uint32_t hitMask = movemask(entryT <= exitT) & node.validMask;
+    if (hitMask) {
+      entryT.store(tNear);
+      pushSorted(node, hitMask, tNear, stack, stackSize);
+    }
+  }
+
+  return hit.isValid();
+}
+
+uint32_t Bvh8::intersect(const RayPacket8& packet, PacketHit8& hit) const {
+  for (int lane = 0; lane < 8; lane++) {
+    hit.t[lane] = packet.tMax[lane];
+    hit.u[lane] = 0.0f;
+    hit.v[lane] = 0.0f;
+    hit.primitiveID[lane] = UINT32_MAX;
+  }
+  if (nodes.empty()) {
+    return 0;
+  }
+
+  const vec3f8 origin{vfloat8::load(packet.originX),
+                      vfloat8::load(packet.originY),
+                      vfloat8::load(packet.originZ)};
+  const vec3f8 direction{vfloat8::load(packet.directionX),
+                         vfloat8::load(packet.directionY),
+                         vfloat8::load(packet.directionZ)};
+  const vec3f8 invDirection{rcp(direction.x), rcp(direction.y),
+                            rcp(direction.z)};
+  const vfloat8 tMinV = vfloat8::load(packet.tMin);
+  vfloat8 hitT = vfloat8::load(hit.t);
+  vfloat8 hitU = vfloat8::broadcast(0.0f);
+  vfloat8 hitV = vfloat8::broadcast(0.0f);
+
+  StackEntry stack[MaxStackSize];
+  uint32_t stackSize = 0;
+  stack[stackSize++] = {0, 0, 0.0f};
+
+  alignas(32) float laneT[8];
+  float tNear[8];
+  while (stackSize > 0) {
+    const StackEntry entry = stack[--stackSize];
+
+    if (entry.primitiveCount > 0) {
+      // Vectorized Moller-Trumbore, one triangle against all eight rays
+      for (uint32_t i = 0; i < entry.primitiveCount; i++) {
+        const Bvh8Triangle& tri = triangles[entry.ref + i];
+        const vec3f8 v0 = broadcast(tri.v0);
+        const vec3f8 e1 = broadcast(tri.e1);
+        const vec3f8 e2 = broadcast(tri.e2);
+        const vec3f8 p = cross(direction, e2);
+        const vfloat8 det = dot(e1, p);
+        const vfloat8 invDet = rcp(det);
+        const vec3f8 s = origin - v0;
+        const vfloat8 u = dot(s, p) * invDet;
+        const vec3f8 q = cross(s, e1);
+        const vfloat8 v = dot(direction, q) * invDet;
+        const vfloat8 t = dot(e2, q) * invDet;
+
+        const vfloat8 zero = vfloat8::broadcast(0.0f);
+        const vfloat8 one = vfloat8::broadcast(1.0f);
+        const vbool8 accept = (abs(det) >= vfloat8::broadcast(1e-12f)) &
+                              (u >= zero) & (u <= one) & (v >= zero) &
+                              (u + v <= one) & (t > tMinV) & (t < hitT);
+        uint32_t acceptMask = movemask(accept);
+        if (acceptMask) {
+          hitT = select(accept, t, hitT);
+          hitU = select(accept, u, hitU);
+          hitV = select(accept, v, hitV);
+          for (int lane = 0; lane < 8; lane++) {
+            if (acceptMask & (1u << lane)) {
+              hit.primitiveID[lane] = tri.primitiveID;
+            }
+          }
+        }
+      }
+      continue;
+    }
+
+    // Packet traversal visits a child if any active lane overlaps it, and
+    // orders children by the nearest entry over the packet
+    const Bvh8Node& node = nodes[entry.ref];
+    const uint8_t* lower[3] = {node.lowerX, node.lowerY, node.lowerZ};
+    const uint8_t* upper[3] = {node.upperX, node.upperY, node.upperZ};
+    float scale[3];
+    for (int axis = 0; axis < 3; axis++) {
+      scale[axis] = std::ldexp(1.0f, node.exponent[axis]);
+    }
+    const vfloat8* o[3] = {&origin.x, &origin.y, &origin.z};
+    const vfloat8* invD[3] = {&invDirection.x, &invDirection.y,
+                              &invDirection.z};
+
+    uint32_t hitMask = 0;
+    for (uint32_t i = 0; i < 8; i++) {
+      if (!(node.validMask & (1u << i))) {
+        continue;
+      }
+      vfloat8 tLo[3], tHi[3];
+      for (int axis = 0; axis < 3; axis++) {
+        float lo = node.origin[axis] + float(lower[axis][i]) * scale[axis];
+        float hi = node.origin[axis] + float(upper[axis][i]) * scale[axis];
+        tLo[axis] = (vfloat8::broadcast(lo) - *o[axis]) * *invD[axis];
+        tHi[axis] = (vfloat8::broadcast(hi) - *o[axis]) * *invD[axis];
+      }
+      const vfloat8 entryT =
+          max(max(min(tLo[0], tHi[0]), min(tLo[1], tHi[1])),
+              max(min(tLo[2], tHi[2]), tMinV));
+      const vfloat8 exitT = min(min(max(tLo[0], tHi[0]), max(tLo[1], tHi[1])),
+                                min(max(tLo[2], tHi[2]), hitT));
+      uint32_t laneMask = movemask(entryT <= exitT);
+      if (laneMask) {
+        hitMask |= 1u << i;
+        entryT.store(laneT);
+        tNear[i] = FLT_MAX;
+        for (int lane = 0; lane < 8; lane++) {
+          if (laneMask & (1u << lane)) {
+            tNear[i] = std::min(tNear[i], laneT[lane]);
+          }
+        }
+      }
+    }
+    if (hitMask) {
+      pushSorted(node, hitMask, tNear, stack, stackSize);
+    }
+  }
+
+  hitT.store(hit.t);
+  hitU.store(hit.u);
+  hitV.store(hit.v);
+
+  uint32_t laneMask = 0;
+  for (int lane = 0; lane < 8; lane++) {
+    if (hit.isValid(lane)) {
+      laneMask |= 1u << lane;
+    }
+  }
+  return laneMask;
+}
+}  // namespace core_internal::rendering::cpu
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Bvh.hpp"
+#include "CpuMath.hpp"
+
+namespace core_internal::rendering::cpu {
+// Compressed 8-wide node. Child boxes are quantized to 8 bits per plane
+// relative to the node origin with a power of two scale per axis, and stored
+// SoA so one vector load fetches a plane for all eight children.
+struct alignas(16) Bvh8Node {
+  float origin[3];
+  int8_t exponent[3];
+  uint8_t validMask;  // Bit i set when child slot i is used
+
+  uint8_t lowerX[8];
+  uint8_t upperX[8];
+  uint8_t lowerY[8];
+  uint8_t upperY[8];
+  uint8_t lowerZ[8];
+  uint8_t upperZ[8];
+
+  // Interior children index the node array, leaves index the triangle array
+  uint32_t child[8];
+  uint8_t primitiveCount[8];  // 0 for interior children
+};
+static_assert(sizeof(Bvh8Node) == 112, "Bvh8Node layout changed");
+
+// Leaf triangles are copied out of the index buffer in traversal order and
+// stored in the form Moller-Trumbore consumes
+struct Bvh8Triangle {
+  float v0[3];
+  float e1[3];
+  float e2[3];
+  uint32_t primitiveID;
+};
+
+// Coherent ray packet, SoA so each component loads as one 8-wide vector.
+// Lanes with tMax < tMin are inactive.
+struct alignas(32) RayPacket8 {
+  float originX[8], originY[8], originZ[8];
+  float directionX[8], directionY[8], directionZ[8];
+  float tMin[8];
+  float tMax[8];
+};
+
+struct alignas(32) PacketHit8 {
+  float t[8];
+  float u[8];
+  float v[8];
+  uint32_t primitiveID[8];
+
+  bool isValid(int lane) const { return primitiveID[lane] != UINT32_MAX; }
+};
+
+// 8-wide BVH collapsed from a binary SAH BVH. Binary interior children are
+// pulled up greedily by surface area until each node holds up to eight
+// children, which keeps traversal depth at roughly a third of the binary tree.
+class Bvh8 {
+ private:
+  std::vector<Bvh8Node> nodes;
+  std::vector<Bvh8Triangle> triangles;
+
+  struct Stats {
+    uint32_t nodeCount = 0;
+    uint32_t leafCount = 0;
+    uint32_t triangleCount = 0;
+    double averageChildren = 0.0;
+    double collapseMilliseconds = 0.0;
+
+    std::string toString() const;
+  } stats;
+
+  uint32_t collapseNode(const Bvh& bvh, uint32_t binaryNodeIdx);
+
+ public:
+  // Every node is collapsed from at least one binary level, so there are at
+  // most Bvh::MaxDepth interior levels, and each visit replaces one entry
+  // with up to eight
+  static constexpr uint32_t MaxStackSize = 7 * Bvh::MaxDepth + 1;
+
+  Bvh8();
+  ~Bvh8();
+
+  void build(const Bvh& bvh);
+
+  // Closest hit in (tMin, tMax) for a single ray. terminateOnFirstHit
+  // returns at any hit instead, like gl_RayFlagsTerminateOnFirstHitEXT, for
+  // shadow rays.
+  bool intersect(const Vec3& origin, const Vec3& direction, float tMin,
+                 float tMax, BvhHit& hit,
+                 bool terminateOnFirstHit = false) const;
+  // Closest hits for a packet, traversing the tree once for all lanes.
+  // Returns the mask of lanes that hit.
+  uint32_t intersect(const RayPacket8& packet, PacketHit8& hit) const;
+
+  const std::vector<Bvh8Node>& getNodes() const { return nodes; }
+
+  std::string getStatistics() const { return stats.toString(); }
+};
+}  // namespace core_internal::rendering::cpu
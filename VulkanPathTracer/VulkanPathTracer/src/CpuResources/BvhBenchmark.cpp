@@ -0,0 +1,204 @@
+#include "BvhBenchmark.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+
+#include "Bvh.hpp"
+#include "Bvh8.hpp"
+#include "CpuMath.hpp"
+#include "CpuPathTracer.hpp"
+#include "ParallelFor.hpp"
+#include "Simd.hpp"
+
+namespace core_internal::rendering::cpu {
+namespace {
+struct Ray {
+  Vec3 origin;
+  Vec3 direction;
+};
+
+// Rays per work item handed to a thread; a multiple of the packet width
+constexpr uint32_t ChunkSize = 512;
+
+double timeKernel(uint32_t repetitions, const std::function<void()>& kernel) {
+  double best = 1e30;
+  for (uint32_t i = 0; i < std::max(1u, repetitions); i++) {
+    auto start = std::chrono::high_resolution_clock::now();
+    kernel();
+    auto end = std::chrono::high_resolution_clock::now();
+    best = std::min(best, std::chrono::duration<double>(end - start).count());
+  }
+  return best;
+}
+
+void traceSingle(const std::vector<Ray>& rays, uint32_t threadCount,
+                 const std::function<bool(const Ray&, BvhHit&)>& trace,
+                 std::atomic<uint64_t>& hitCount) {
+  const uint32_t chunks =
+      static_cast<uint32_t>((rays.size() + ChunkSize - 1) / ChunkSize);
+  parallelFor(chunks, threadCount, [&](uint32_t chunk) {
+    size_t begin = size_t(chunk) * ChunkSize;
+    size_t end = std::min(begin + ChunkSize, rays.size());
+    uint64_t hits = 0;
+    for (size_t i = begin; i < end; i++) {
+      BvhHit hit;
+      hits += trace(rays[i], hit);
+    }
+    hitCount += hits;
+  });
+}
+
+void tracePackets(const std::vector<Ray>& rays, uint32_t threadCount,
+                  const Bvh8& bvh8, std::atomic<uint64_t>& hitCount) {
+  const uint32_t chunks =
+      static_cast<uint32_t>((rays.size() + ChunkSize - 1) / ChunkSize);
+  parallelFor(chunks, threadCount, [&](uint32_t chunk) {
+    size_t begin = size_t(chunk) * ChunkSize;
+    size_t end = std::min(begin + ChunkSize, rays.size());
+    uint64_t hits = 0;
+    RayPacket8 packet;
+    PacketHit8 packetHit;
+    for (size_t first = begin; first < end; first += 8) {
+      for (uint32_t lane = 0; lane < 8; lane++) {
+        size_t i = first + lane;
+        // Pad partial packets with inactive lanes
+        bool active = i < end;
+        const Ray& ray = rays[active ? i : first];
+        packet.originX[lane] = ray.origin.x;
+        packet.originY[lane] = ray.origin.y;
+        packet.originZ[lane] = ray.origin.z;
+        packet.directionX[lane] = ray.direction.x;
+        packet.directionY[lane] = ray.direction.y;
+        packet.directionZ[lane] = ray.direction.z;
+        packet.tMin[lane] = 0.0f;
+        packet.tMax[lane] = active ? 10000.0f : -1.0f;
+      }
+      uint32_t mask = bvh8.intersect(packet, packetHit);
+      for (uint32_t lane = 0; lane < 8; lane++) {
+        hits += (mask >> lane) & 1;
+      }
+    }
+    hitCount += hits;
+  });
+}
+}  // namespace
+
+std::string runBvhBenchmark(std::span<const float> vertices,
+                            std::span<const uint32_t> indices,
+                            const BvhBenchmarkSettings& settings) {
+  const uint32_t threadCount = resolveThreadCount(settings.threadCount);
+  std::stringstream report;
+  const uint32_t width = settings.view.resolution[0];
+  const uint32_t height = settings.view.resolution[1];
+  report << "BVH benchmark: " << indices.size() / 3 << " triangles, "
+         << width << "x" << height << ", " << threadCount
+         << " threads, " << simdIsaName() << "\n";
+
+  BvhBuildSettings buildSettings;
+  buildSettings.threadCount = threadCount;
+  Bvh bvh;
+  bvh.build(vertices, indices, buildSettings);
+  Bvh8 bvh8;
+  bvh8.build(bvh);
+  report << bvh.getStatistics() << bvh8.getStatistics();
+
+  // Primary rays follow the pt.comp camera through pixel centers, grouped in
+  // 4x2 pixel blocks so consecutive groups of 8 rays form coherent packets
+  const Vec3 cameraOrigin = cameraRayOrigin(settings.view);
+  std::vector<Ray> primaryRays;
+  primaryRays.reserve(size_t(width) * height);
+  for (uint32_t blockY = 0; blockY < height; blockY += 2) {
+    for (uint32_t blockX = 0; blockX < width; blockX += 4) {
+      for (uint32_t y = blockY; y < std::min(blockY + 2, height); y++) {
+        for (uint32_t x = blockX; x < std::min(blockX + 4, width); x++) {
+          const Vec2 pixelCenter{float(x) + 0.5f, float(y) + 0.5f};
+          primaryRays.push_back(
+              {cameraOrigin, cameraRayDirection(settings.view, pixelCenter)});
+        }
+      }
+    }
+  }
+
+  // One diffuse bounce off every primary hit, sampled like pt.comp
+  std::vector<Ray> bounceRays;
+  bounceRays.reserve(primaryRays.size());
+  for (size_t i = 0; i < primaryRays.size(); i++) {
+    const Ray& ray = primaryRays[i];
+    BvhHit hit;
+    if (!bvh.intersect(ray.origin, ray.direction, 0.0f, 10000.0f, hit)) {
+      continue;
+    }
+    const float* v0 = vertices.data() + 3 * indices[3 * hit.primitiveID + 0];
+    const float* v1 = vertices.data() + 3 * indices[3 * hit.primitiveID + 1];
+    const float* v2 = vertices.data() + 3 * indices[3 * hit.primitiveID + 2];
+    const Vec3 p0(v0[0], v0[1], v0[2]);
+    const Vec3 p1(v1[0], v1[1], v1[2]);
+    const Vec3 p2(v2[0], v2[1], v2[2]);
+    Vec3 normal = normalize(cross(p1 - p0, p2 - p0));
+    normal = faceforward(normal, ray.direction, normal);
+    const Vec3 position =
+        p0 * (1.0f - hit.u - hit.v) + p1 * hit.u + p2 * hit.v;
+
+    uint32_t rngState = static_cast<uint32_t>(i);
+    const float theta = 6.2831853f * stepAndOutputRNGFloat(rngState);
+    const float u = 2.0f * stepAndOutputRNGFloat(rngState) - 1.0f;
+    const float r = std::sqrt(1.0f - u * u);
+    Vec3 direction =
+        normalize(normal + Vec3(r * std::cos(theta), r * std::sin(theta), u));
+    bounceRays.push_back({position + 0.0001f * normal, direction});
+  }
+
+  auto binarySingle = [&](const Ray& ray, BvhHit& hit) {
+    return bvh.intersect(ray.origin, ray.direction, 0.0f, 10000.0f, hit);
+  };
+  auto wideSingle = [&](const Ray& ray, BvhHit& hit) {
+    return bvh8.intersect(ray.origin, ray.direction, 0.0f, 10000.0f, hit);
+  };
+
+  auto measure = [&](const char* name, const std::vector<Ray>& rays,
+                     const std::function<void(std::atomic<uint64_t>&)>& run) {
+    std::atomic<uint64_t> hitCount{0};
+    double seconds = timeKernel(settings.repetitions, [&]() {
+      hitCount = 0;
+      run(hitCount);
+    });
+    double mrays = rays.empty() ? 0.0 : double(rays.size()) / seconds * 1e-6;
+    report << "  " << std::left << std::setw(30) << name << std::right
+           << std::setw(10) << std::fixed << std::setprecision(2) << mrays
+           << " Mrays/s  (" << rays.size() << " rays, " << hitCount.load()
+           << " hits)\n";
+    report.unsetf(std::ios::fixed);
+  };
+
+  measure("primary  binary single", primaryRays,
+          [&](std::atomic<uint64_t>& hits) {
+            traceSingle(primaryRays, threadCount, binarySingle, hits);
+          });
+  measure("primary  bvh8 single", primaryRays,
+          [&](std::atomic<uint64_t>& hits) {
+            traceSingle(primaryRays, threadCount, wideSingle, hits);
+          });
+  measure("primary  bvh8 packet8", primaryRays,
+          [&](std::atomic<uint64_t>& hits) {
+            tracePackets(primaryRays, threadCount, bvh8, hits);
+          });
+  measure("diffuse  binary single", bounceRays,
+          [&](std::atomic<uint64_t>& hits) {
+            traceSingle(bounceRays, threadCount, binarySingle, hits);
+          });
+  measure("diffuse  bvh8 single", bounceRays,
+          [&](std::atomic<uint64_t>& hits) {
+            traceSingle(bounceRays, threadCount, wideSingle, hits);
+          });
+  measure("diffuse  bvh8 packet8", bounceRays,
+          [&](std::atomic<uint64_t>& hits) {
+            tracePackets(bounceRays, threadCount, bvh8, hits);
+          });
+
+  return report.str();
+}
+}  // namespace core_internal::rendering::cpu
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <span>
+
+#include "../Core/Rendering/RenderParameters.hpp"
+
+namespace core_internal::rendering::cpu {
+struct BvhBenchmarkSettings {
+  // Primary rays use this camera and resolution, one ray per pixel center
+  RenderParameters view = makeDefaultRenderParameters(800, 600);
+  // Best of this many runs is reported for every kernel
+  uint32_t repetitions = 3;
+  // 0 uses every hardware thread
+  uint32_t threadCount = 0;
+};
+
+// Builds the binary BVH and BVH8 over the mesh and measures Mrays/s of every
+// host traversal kernel for primary camera rays (coherent, traced as 4x2
+// pixel packets) and one diffuse bounce off the primary hits (incoherent).
+// Returns a printable report.
+std::string runBvhBenchmark(std::span<const float> vertices,
+                            std::span<const uint32_t> indices,
+                            const BvhBenchmarkSettings& settings = {});
+}  // namespace core_internal::rendering::cpu
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Minimal GLSL-like vector math used by the CPU backend. Functions follow the
+// GLSL built-ins they mirror so shader code can be ported line by line.
+namespace core_internal::rendering::cpu {
+struct Vec2 {
+  float x = 0.0f;
+  float y = 0.0f;
+};
+
+struct Vec3 {
+  float x = 0.0f;
+  float y = 0.0f;
+  float z = 0.0f;
+
+  Vec3() = default;
+  constexpr Vec3(float s) : x(s), y(s), z(s) {}
+  constexpr Vec3(float x, float y, float z) : x(x), y(y), z(z) {}
+
+  float operator[](int i) const { return i == 0 ? x : (i == 1 ? y : z); }
+  float& operator[](int i) { return i == 0 ? x : (i == 1 ? y : z); }
+
+  Vec3& operator+=(const Vec3& o) {
+    x += o.x;
+    y += o.y;
+    z += o.z;
+    return *this;
+  }
+  Vec3& operator*=(const Vec3& o) {
+    x *= o.x;
+    y *= o.y;
+    z *= o.z;
+    return *this;
+  }
+};
+
+inline Vec3 operator+(const Vec3& a, const Vec3& b) {
+  return {a.x + b.x, a.y + b.y, a.z + b.z};
+}
+inline Vec3 operator-(const Vec3& a, const Vec3& b) {
+  return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+inline Vec3 operator-(const Vec3& a) { return {-a.x, -a.y, -a.z}; }
+inline Vec3 operator*(const Vec3& a, const Vec3& b) {
+  return {a.x * b.x, a.y * b.y, a.z * b.z};
+}
+inline Vec3 operator*(const Vec3& a, float s) {
+  return {a.x * s, a.y * s, a.z * s};
+}
+inline Vec3 operator*(float s, const Vec3& a) { return a * s; }
+inline Vec3 operator/(const Vec3& a, float s) {
+  return {a.x / s, a.y / s, a.z / s};
+}
+
+inline float dot(const Vec3& a, const Vec3& b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+inline Vec3 cross(const Vec3& a, const Vec3& b) {
+  return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
+          a.x * b.y - a.y * b.x};
+}
+
+inline float length(const Vec3& a) { return std::sqrt(dot(a, a)); }
+
+inline Vec3 normalize(const Vec3& a) { return a / length(a); }
+
+inline Vec3 mix(const Vec3& a, const Vec3& b, float t) {
+  return a * (1.0f - t) + b * t;
+}
+
+inline Vec3 faceforward(const Vec3& n, const Vec3& i, const Vec3& nRef) {
+  return dot(nRef, i) < 0.0f ? n : -n;
+}
+
+inline Vec3 min(const Vec3& a, const Vec3& b) {
+  return {std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)};
+}
+
+inline Vec3 max(const Vec3& a, const Vec3& b) {
+  return {std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)};
+}
+}  // namespace core_internal::rendering::cpu
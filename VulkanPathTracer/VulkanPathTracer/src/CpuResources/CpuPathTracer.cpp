@@ -0,0 +1,342 @@
+#include "CpuPathTracer.hpp"
+
+#include "../Core/Rendering/Sampler.hpp"
+#include "ParallelFor.hpp"
+
+namespace core_internal::rendering::cpu {
+namespace {
+constexpr float InvPi = 0.31830988618f;
+}  // namespace
+
+Vec3 skyColor(const Vec3& direction) {
+  // +y in world space is up, so:
+  if (direction.y > 0.0f) {
+    return mix(Vec3(1.0f), Vec3(0.25f, 0.5f, 1.0f), direction.y);
+  } else {
+    return Vec3(0.03f);
+  }
+}
+
+float getLightPdf(float lightArea, float lightDistance, float cosLight) {
+  return lightDistance * lightDistance /
+         (lightArea * std::max(cosLight, 1e-8f));
+}
+
+float powerHeuristic(float pdf, float otherPdf) {
+  const float pdf2 = pdf * pdf;
+  return pdf2 > 0.0f ? pdf2 / (pdf2 + otherPdf * otherPdf) : 0.0f;
+}
+
+bool survivesRoulette(const RenderParameters& params, Vec3& throughput,
+                      uint32_t bounce, CpuSampler& sampler) {
+  if (bounce <= params.rouletteMinBounces) {
+    return true;
+  }
+  const float survival =
+      std::min(std::max(throughput.x, std::max(throughput.y, throughput.z)),
+               0.95f);
+  if (sampler.next1D() >= survival) {
+    return false;
+  }
+  throughput = throughput / survival;
+  return true;
+}
+
+CpuPathTracer::CpuPathTracer(const Mesh& mesh,
+                             const BvhBuildSettings& bvhSettings)
+    : vertices(mesh.vertices),
+      indices(mesh.indices),
+      sobolMatrices(makeSobolMatrices()),
+      materials(mesh.materials),
+      triangleMaterials(mesh.getTriangleCount(), 0),
+      lightTable(buildLightTable(mesh)) {
+  for (const MeshShape& shape : mesh.shapes) {
+    std::fill_n(triangleMaterials.begin() + shape.firstIndex / 3,
+                shape.indexCount / 3, shape.material);
+  }
+  bvh.build(vertices, indices, bvhSettings);
+  bvh8.build(bvh);
+}
+
+CpuPathTracer::~CpuPathTracer() {}
+
+Vec3 cameraRayOrigin(const RenderParameters& params) {
+  const float* m = params.cameraToWorld;
+  return Vec3(m[12], m[13], m[14]);
+}
+
+Vec3 cameraRayDirection(const RenderParameters& params,
+                        const Vec2& pixelPosition) {
+  const float resolutionX = float(params.resolution[0]);
+  const float resolutionY = float(params.resolution[1]);
+  const Vec2 screenUV{(2.0f * pixelPosition.x - resolutionX) / resolutionY,
+                      -(2.0f * pixelPosition.y - resolutionY) / resolutionY};
+  const Vec3 direction(params.fovVerticalSlope * screenUV.x,
+                       params.fovVerticalSlope * screenUV.y, -1.0f);
+  // Rotate into world space with the upper 3x3 of the column-major matrix
+  const float* m = params.cameraToWorld;
+  return normalize(
+      Vec3(m[0] * direction.x + m[4] * direction.y + m[8] * direction.z,
+           m[1] * direction.x + m[5] * direction.y + m[9] * direction.z,
+           m[2] * direction.x + m[6] * direction.y + m[10] * direction.z));
+}
+
+void CpuPathTracer::render(const RenderParameters& params, uint32_t numSamples,
+                           const CpuRenderSettings& settings,
+                           float* imageData) const {
+  std::vector<float> accumulation(
+      size_t(params.resolution[0]) * params.resolution[1] * 4);
+  RenderParameters imageParams = params;
+  imageParams.log2SamplesPerPixel = getLog2SampleCount(numSamples);
+  renderSampleRange(imageParams, 0, numSamples, settings, accumulation.data(),
+                    imageData);
+}
+
+void CpuPathTracer::renderSampleRange(const RenderParameters& params,
+                                      uint32_t firstSample,
+                                      uint32_t lastSample,
+                                      const CpuRenderSettings& settings,
+                                      float* accumulation,
+                                      float* imageData) const {
+  RenderParameters dispatchParams = params;
+  dispatchParams.firstSample = firstSample;
+  const uint32_t samplesPerDispatch = params.samplesPerDispatch > 0
+                                          ? params.samplesPerDispatch
+                                          : lastSample - firstSample;
+  for (uint32_t sampleOffset = firstSample; sampleOffset < lastSample;
+       sampleOffset += samplesPerDispatch) {
+    dispatchParams.sampleOffset = sampleOffset;
+    dispatchParams.samplesPerDispatch =
+        std::min(samplesPerDispatch, lastSample - sampleOffset);
+    dispatch(dispatchParams, settings, accumulation, imageData);
+  }
+}
+
+void CpuPathTracer::dispatch(const RenderParameters& params,
+                             const CpuRenderSettings& settings,
+                             float* accumulation, float* imageData) const {
+  const uint32_t tilesX =
+      (params.resolution[0] + settings.tileWidth - 1) / settings.tileWidth;
+  const uint32_t tilesY =
+      (params.resolution[1] + settings.tileHeight - 1) / settings.tileHeight;
+
+  // Tiles are handed out dynamically since paths that keep bouncing make some
+  // tiles far more expensive than others
+  parallelFor(tilesX * tilesY, settings.threadCount, [&](uint32_t tile) {
+    renderTile(params, settings, tile % tilesX, tile / tilesX, accumulation,
+               imageData);
+  });
+}
+
+void CpuPathTracer::renderTile(const RenderParameters& params,
+                               const CpuRenderSettings& settings,
+                               uint32_t tileX, uint32_t tileY,
+                               float* accumulation, float* imageData) const {
+  const uint32_t width = params.resolution[0];
+  const uint32_t beginX = tileX * settings.tileWidth;
+  const uint32_t beginY = tileY * settings.tileHeight;
+  const uint32_t endX = std::min(beginX + settings.tileWidth, width);
+  const uint32_t endY =
+      std::min(beginY + settings.tileHeight, params.resolution[1]);
+
+  for (uint32_t y = beginY; y < endY; y++) {
+    for (uint32_t x = beginX; x < endX; x++) {
+      Vec3 summedPixelColor = tracePixel(params, x, y);
+      // Get the index of this pixel in the buffer:
+      size_t linearIndex = size_t(width) * y + x;
+
+      // Add this dispatch's samples to the running sum and output the average
+      float* accumulated = accumulation + 4 * linearIndex;
+      if (params.sampleOffset == params.firstSample) {
+        accumulated[0] = accumulated[1] = accumulated[2] = accumulated[3] =
+            0.0f;
+      }
+      accumulated[0] += summedPixelColor.x;
+      accumulated[1] += summedPixelColor.y;
+      accumulated[2] += summedPixelColor.z;
+      accumulated[3] += float(params.samplesPerDispatch);
+      imageData[3 * linearIndex + 0] = accumulated[0] / accumulated[3];
+      imageData[3 * linearIndex + 1] = accumulated[1] / accumulated[3];
+      imageData[3 * linearIndex + 2] = accumulated[2] / accumulated[3];
+    }
+  }
+}
+
+Vec3 CpuPathTracer::tracePixel(const RenderParameters& params,
+                               uint32_t pixelX, uint32_t pixelY) const {
+  // The sum of the colors of this dispatch's samples
+  Vec3 summedPixelColor(0.0f);
+
+  for (uint32_t sampleIdx = 0; sampleIdx < params.samplesPerDispatch;
+       sampleIdx++) {
+    CpuSampler sampler(params, sobolMatrices, pixelX, pixelY,
+                       params.sampleOffset + sampleIdx);
+    Vec3 rayOrigin = cameraRayOrigin(params);
+    const Vec2 jitter = sampler.next2D();
+    const Vec2 randomPixelCenter{float(pixelX) + jitter.x,
+                                 float(pixelY) + jitter.y};
+    Vec3 rayDirection = cameraRayDirection(params, randomPixelCenter);
+
+    Vec3 accumulatedRayColor(1.0f);
+    float bsdfPdf = 0.0f;
+
+    for (uint32_t tracedSegments = 0; tracedSegments < params.maxSegments;
+         tracedSegments++) {
+      CpuHitInfo hitInfo;
+      if (intersect(rayOrigin, rayDirection, 0.0f, 10000.0f, hitInfo)) {
+        // Add the light of emissive surfaces the ray found by chance
+        if (hitInfo.emission.x > 0.0f || hitInfo.emission.y > 0.0f ||
+            hitInfo.emission.z > 0.0f) {
+          summedPixelColor += accumulatedRayColor * hitInfo.emission *
+                              getHitEmissionWeight(params, tracedSegments,
+                                                   bsdfPdf, hitInfo.t,
+                                                   hitInfo.worldNormal,
+                                                   rayDirection);
+        }
+
+        // Flip the normal so it points against the ray direction:
+        hitInfo.worldNormal = faceforward(hitInfo.worldNormal, rayDirection,
+                                          hitInfo.worldNormal);
+
+        // Start a new ray at the hit position, but offset it slightly along
+        // the normal:
+        rayOrigin = hitInfo.worldPosition + 0.0001f * hitInfo.worldNormal;
+
+        // Random point on the unit sphere centered at the normal
+        sampler.startBounce(tracedSegments + 1);
+        const Vec2 xi = sampler.next2D();
+        const float theta = 6.2831853f * xi.x;
+        const float u = 2.0f * xi.y - 1.0f;
+        const float r = std::sqrt(1.0f - u * u);
+        rayDirection = hitInfo.worldNormal +
+                       Vec3(r * std::cos(theta), r * std::sin(theta), u);
+        rayDirection = normalize(rayDirection);
+        bsdfPdf = std::max(dot(hitInfo.worldNormal, rayDirection), 0.0f) *
+                  InvPi;
+
+        // Sample the lights directly, unless the path can't trace the
+        // segment that would find them by chance
+        if (tracedSegments + 1 < params.maxSegments) {
+          summedPixelColor += accumulatedRayColor * hitInfo.color *
+                              sampleDirectLight(params, rayOrigin,
+                                                hitInfo.worldNormal, sampler);
+        }
+
+        // Apply color absorption
+        accumulatedRayColor *= hitInfo.color;
+
+        // Dim paths may end here, adding nothing
+        if (!survivesRoulette(params, accumulatedRayColor, tracedSegments + 1,
+                              sampler)) {
+          break;
+        }
+      } else {
+        // Ray hit the sky
+        accumulatedRayColor *= skyColor(rayDirection);
+        summedPixelColor += accumulatedRayColor;
+        break;
+      }
+    }
+  }
+
+  return summedPixelColor;
+}
+
+bool CpuPathTracer::intersect(const Vec3& rayOrigin, const Vec3& rayDirection,
+                              float tMin, float tMax,
+                              CpuHitInfo& hitInfo) const {
+  BvhHit hit;
+  if (!bvh8.intersect(rayOrigin, rayDirection, tMin, tMax, hit)) {
+    return false;
+  }
+
+  auto vertex = [&](uint32_t index) {
+    return Vec3(vertices[3 * index + 0], vertices[3 * index + 1],
+                vertices[3 * index + 2]);
+  };
+
+  const uint32_t primitiveID = hit.primitiveID;
+  const Vec3 v0 = vertex(indices[3 * primitiveID + 0]);
+  const Vec3 v1 = vertex(indices[3 * primitiveID + 1]);
+  const Vec3 v2 = vertex(indices[3 * primitiveID + 2]);
+
+  // Same reconstruction as getObjectHitInfo in pt.comp
+  const float w = 1.0f - hit.u - hit.v;
+  hitInfo.worldPosition = v0 * w + v1 * hit.u + v2 * hit.v;
+  hitInfo.worldNormal = normalize(cross(v1 - v0, v2 - v0));
+  hitInfo.color = Vec3(0.7f);
+  const float* emission = materials[triangleMaterials[primitiveID]].emission;
+  hitInfo.emission = Vec3(emission[0], emission[1], emission[2]);
+  hitInfo.t = hit.t;
+  return true;
+}
+
+float CpuPathTracer::getHitEmissionWeight(const RenderParameters& params,
+                                          uint32_t segment, float bsdfPdf,
+                                          float lightDistance,
+                                          const Vec3& worldNormal,
+                                          const Vec3& rayDirection) const {
+  if (segment == 0 || params.lightSampling == 0) {
+    return 1.0f;
+  }
+  const float cosLight = std::abs(dot(worldNormal, rayDirection));
+  return powerHeuristic(
+      bsdfPdf, getLightPdf(lightTable.totalArea, lightDistance, cosLight));
+}
+
+Vec3 CpuPathTracer::sampleDirectLight(const RenderParameters& params,
+                                      const Vec3& origin,
+                                      const Vec3& worldNormal,
+                                      CpuSampler& sampler) const {
+  const uint32_t lightCount =
+      static_cast<uint32_t>(lightTable.triangles.size());
+  if (params.lightSampling == 0 || lightCount == 0) {
+    return Vec3(0.0f);
+  }
+  const Vec2 xi = sampler.next2D();
+  const float scaled = sampler.next1D() * float(lightCount);
+
+  // The integer part selects an entry, the fraction keeps it or its alias
+  uint32_t entry = std::min(uint32_t(scaled), lightCount - 1);
+  if (scaled - float(entry) >= lightTable.triangles[entry].aliasProbability) {
+    entry = lightTable.triangles[entry].alias;
+  }
+  const LightTriangle& light = lightTable.triangles[entry];
+  auto vertex = [&](uint32_t index) {
+    return Vec3(vertices[3 * index + 0], vertices[3 * index + 1],
+                vertices[3 * index + 2]);
+  };
+  const Vec3 v0 = vertex(indices[light.firstIndex + 0]);
+  const Vec3 v1 = vertex(indices[light.firstIndex + 1]);
+  const Vec3 v2 = vertex(indices[light.firstIndex + 2]);
+
+  // Uniform point on the triangle by the square root warp
+  const float su = std::sqrt(xi.x);
+  const Vec3 lightPoint =
+      v0 * (1.0f - su) + v1 * (su * (1.0f - xi.y)) + v2 * (su * xi.y);
+  const Vec3 lightNormal = normalize(cross(v1 - v0, v2 - v0));
+
+  Vec3 toLight = lightPoint - origin;
+  const float lightDistance = length(toLight);
+  toLight = toLight / lightDistance;
+  const float cosSurface = dot(worldNormal, toLight);
+  const float cosLight = std::abs(dot(lightNormal, toLight));
+  if (cosSurface <= 0.0f || cosLight <= 0.0f) {
+    return Vec3(0.0f);
+  }
+
+  // Stop just short of the light, so it doesn't shadow itself
+  BvhHit hit;
+  if (bvh8.intersect(origin, toLight, 0.0f, 0.999f * lightDistance, hit,
+                     true)) {
+    return Vec3(0.0f);
+  }
+
+  const float lightPdf =
+      getLightPdf(lightTable.totalArea, lightDistance, cosLight);
+  const float weight = powerHeuristic(lightPdf, cosSurface * InvPi);
+  const float* emission = materials[light.material].emission;
+  return Vec3(emission[0], emission[1], emission[2]) *
+         (cosSurface * InvPi * weight / lightPdf);
+}
+}  // namespace core_internal::rendering::cpu
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "../Core/Rendering/LightTable.hpp"
+#include "../Core/Rendering/Mesh.hpp"
+#include "../Core/Rendering/RenderParameters.hpp"
+#include "Bvh.hpp"
+#include "Bvh8.hpp"
+#include "CpuMath.hpp"
+#include "CpuSampler.hpp"
+
+namespace core_internal::rendering::cpu {
+// How the host splits the work; what is rendered comes from RenderParameters
+struct CpuRenderSettings {
+  // Tiles match the compute workgroup size so the work split mirrors pt.comp
+  uint32_t tileWidth = 16;
+  uint32_t tileHeight = 8;
+  // 0 uses every hardware thread
+  uint32_t threadCount = 0;
+};
+
+struct CpuHitInfo {
+  Vec3 color;
+  Vec3 emission;
+  Vec3 worldPosition;
+  Vec3 worldNormal;
+  float t;  // Distance along the ray
+};
+
+// Reference implementation of shaders/pt.comp on the host. Each worker thread
+// pulls tiles from a shared counter and traces them with the same camera,
+// sampler and bounce logic as the compute kernel, writing the same RGB float
+// layout. Rays are traced against a host BVH built over the uploaded mesh
+// arrays and collapsed to a BVH8 for SIMD traversal.
+class CpuPathTracer {
+ private:
+  std::span<const float> vertices;
+  std::span<const uint32_t> indices;
+  Bvh bvh;
+  Bvh8 bvh8;
+  std::vector<uint32_t> sobolMatrices;
+  std::vector<MeshMaterial> materials;
+  // Material of every triangle, as the BVH knows triangles but not shapes
+  std::vector<uint32_t> triangleMaterials;
+  LightTable lightTable;
+
+  void renderTile(const RenderParameters& params,
+                  const CpuRenderSettings& settings, uint32_t tileX,
+                  uint32_t tileY, float* accumulation, float* imageData) const;
+  Vec3 tracePixel(const RenderParameters& params, uint32_t pixelX,
+                  uint32_t pixelY) const;
+  bool intersect(const Vec3& rayOrigin, const Vec3& rayDirection, float tMin,
+                 float tMax, CpuHitInfo& hitInfo) const;
+  // sampleDirectLight of shaders/pt_common.glsl
+  Vec3 sampleDirectLight(const RenderParameters& params, const Vec3& origin,
+                         const Vec3& worldNormal, CpuSampler& sampler) const;
+  float getHitEmissionWeight(const RenderParameters& params, uint32_t segment,
+                             float bsdfPdf, float lightDistance,
+                             const Vec3& worldNormal,
+                             const Vec3& rayDirection) const;
+
+ public:
+  // The mesh's arrays must outlive the tracer
+  explicit CpuPathTracer(const Mesh& mesh,
+                         const BvhBuildSettings& bvhSettings = {});
+  ~CpuPathTracer();
+
+  const Bvh& getBvh() const { return bvh; }
+  const Bvh8& getBvh8() const { return bvh8; }
+
+  // Host equivalent of one pt.comp dispatch: traces the samples selected by
+  // params.sampleOffset and params.samplesPerDispatch, adds them to
+  // accumulation (rgb sum and sample count, 4 floats per pixel, restarted
+  // when sampleOffset is params.firstSample) and writes the average to
+  // imageData (3 floats per pixel)
+  void dispatch(const RenderParameters& params,
+                const CpuRenderSettings& settings, float* accumulation,
+                float* imageData) const;
+  // Dispatches params.samplesPerDispatch samples at a time, like the GPU
+  // loop, until numSamples are accumulated. imageData must hold
+  // resolution.x * resolution.y * 3 floats
+  void render(const RenderParameters& params, uint32_t numSamples,
+              const CpuRenderSettings& settings, float* imageData) const;
+  // Traces only samples [firstSample, lastSample) of the image, dispatching
+  // like render(), into a restarted accumulation. The sums are those of the
+  // GPU render of the same range. params.log2SamplesPerPixel must be set
+  // for the whole image, see getLog2SampleCount.
+  void renderSampleRange(const RenderParameters& params, uint32_t firstSample,
+                         uint32_t lastSample,
+                         const CpuRenderSettings& settings,
+                         float* accumulation, float* imageData) const;
+};
+
+// World space direction of the camera ray through a point of the image, in
+// pixels, exactly as pt.comp generates it
+Vec3 cameraRayDirection(const RenderParameters& params,
+                        const Vec2& pixelPosition);
+Vec3 cameraRayOrigin(const RenderParameters& params);
+Vec3 skyColor(const Vec3& direction);
+// Density over solid angle of a light sample at the given distance and
+// cosine to the light's normal, as getLightPdf in shaders/pt_common.glsl
+float getLightPdf(float lightArea, float lightDistance, float cosLight);
+// Veach's power heuristic, as in shaders/pt_common.glsl
+float powerHeuristic(float pdf, float otherPdf);
+// Russian roulette after a bounce, as survivesRoulette in
+// shaders/pt_common.glsl. Returns false if the path ends.
+bool survivesRoulette(const RenderParameters& params, Vec3& throughput,
+                      uint32_t bounce, CpuSampler& sampler);
+}  // namespace core_internal::rendering::cpu
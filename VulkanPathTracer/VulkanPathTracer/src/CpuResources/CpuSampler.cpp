@@ -0,0 +1,203 @@
+#include "CpuSampler.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#include "../Core/Rendering/Sampler.hpp"
+
+namespace core_internal::rendering::cpu {
+namespace {
+// The 24 permutations of a base 4 digit, two bits per digit
+constexpr uint32_t Base4Permutations[24] = {
+    0xE4u, 0xB4u, 0xD8u, 0x78u, 0x9Cu, 0x6Cu, 0xE1u, 0xB1u,
+    0xC9u, 0x39u, 0x8Du, 0x2Du, 0xD2u, 0x72u, 0xC6u, 0x36u,
+    0x4Eu, 0x1Eu, 0x93u, 0x63u, 0x87u, 0x27u, 0x4Bu, 0x1Bu};
+
+// GLSL's bitfieldReverse
+uint32_t reverseBits(uint32_t v) {
+  v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);
+  v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);
+  v = ((v >> 4) & 0x0F0F0F0Fu) | ((v & 0x0F0F0F0Fu) << 4);
+  v = ((v >> 8) & 0x00FF00FFu) | ((v & 0x00FF00FFu) << 8);
+  return (v >> 16) | (v << 16);
+}
+
+uint32_t lowBitMask(uint32_t bits) {
+  return bits >= 32 ? 0xFFFFFFFFu : (1u << bits) - 1u;
+}
+
+// Spreads the low 16 bits of v to its even bits
+uint32_t spreadEvenBits(uint32_t v) {
+  v &= 0x0000FFFFu;
+  v = (v | (v << 8)) & 0x00FF00FFu;
+  v = (v | (v << 4)) & 0x0F0F0F0Fu;
+  v = (v | (v << 2)) & 0x33333333u;
+  v = (v | (v << 1)) & 0x55555555u;
+  return v;
+}
+
+// [0, 1) from the 24 high bits, exactly representable as a float
+float toUnitFloat(uint32_t x) { return float(x >> 8) * (1.0f / 16777216.0f); }
+}  // namespace
+
+float stepAndOutputRNGFloat(uint32_t& rngState) {
+  // Condensed version of pcg_output_rxs_m_xs_32_32, with simple conversion to
+  // floating-point [0,1]. Unsigned overflow matches GLSL uint arithmetic.
+  rngState = rngState * 747796405u + 1u;
+  uint32_t word =
+      ((rngState >> ((rngState >> 28) + 4)) ^ rngState) * 277803737u;
+  word = (word >> 22) ^ word;
+  return float(word) / 4294967295.0f;
+}
+
+uint32_t hashUint(uint32_t x) {
+  const uint32_t state = x * 747796405u + 2891336453u;
+  const uint32_t word =
+      ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+  return (word >> 22u) ^ word;
+}
+
+void pcg4d(uint32_t v[4]) {
+  for (int i = 0; i < 4; i++) {
+    v[i] = v[i] * 1664525u + 1013904223u;
+  }
+  auto mix = [&]() {
+    v[0] += v[1] * v[3];
+    v[1] += v[2] * v[0];
+    v[2] += v[0] * v[1];
+    v[3] += v[1] * v[2];
+  };
+  mix();
+  for (int i = 0; i < 4; i++) {
+    v[i] ^= v[i] >> 16u;
+  }
+  mix();
+}
+
+uint32_t hashCombine(uint32_t seed, uint32_t value) {
+  return seed ^ (hashUint(value) + 0x9e3779b9u + (seed << 6u) + (seed >> 2u));
+}
+
+uint32_t nestedUniformScramble(uint32_t x, uint32_t seed) {
+  x = reverseBits(x);
+  x += seed;
+  x ^= x * 0x6c50b47cu;
+  x ^= x * 0xb82f1e52u;
+  x ^= x * 0xc7afe638u;
+  x ^= x * 0x8d22f6e6u;
+  return reverseBits(x);
+}
+
+CpuSampler::CpuSampler(const RenderParameters& params,
+                       std::span<const uint32_t> sobolMatrices,
+                       uint32_t pixelX, uint32_t pixelY, uint32_t sampleIndex)
+    : params(params),
+      sobolMatrices(sobolMatrices),
+      pixelX(pixelX),
+      pixelY(pixelY),
+      sampleIndex(sampleIndex) {}
+
+float CpuSampler::getRandomSample(uint32_t sampleDimension) const {
+  uint32_t key[4] = {pixelX, pixelY, sampleIndex, sampleDimension};
+  pcg4d(key);
+  return toUnitFloat(key[0]);
+}
+
+uint32_t CpuSampler::sobolSample(uint32_t index,
+                                 uint32_t sobolDimension) const {
+  uint32_t result = 0;
+  for (uint32_t column = sobolDimension * SobolMatrixColumns; index != 0;
+       column++, index >>= 1) {
+    if (index & 1u) {
+      result ^= sobolMatrices[column];
+    }
+  }
+  return result;
+}
+
+float CpuSampler::getSobolSample(uint32_t sampleDimension) const {
+  const uint32_t blockSeed =
+      hashCombine(hashCombine(hashUint(pixelX), pixelY),
+                  sampleDimension / SobolDimensions);
+  const uint32_t index = nestedUniformScramble(sampleIndex, blockSeed);
+  const uint32_t component = sampleDimension % SobolDimensions;
+  return toUnitFloat(nestedUniformScramble(
+      sobolSample(index, component), hashCombine(blockSeed, component + 1)));
+}
+
+uint32_t CpuSampler::getZSobolIndex(uint32_t sampleDimension,
+                                    uint32_t& tileSeed) const {
+  const uint32_t sampleBits = std::min(params.log2SamplesPerPixel, 30u);
+  const uint32_t side = std::max(params.resolution[0], params.resolution[1]);
+  const uint32_t imageBits =
+      side > 1 ? 2 * static_cast<uint32_t>(std::bit_width(side - 1)) : 0;
+  const uint32_t mortonBits = std::min(imageBits, (32 - sampleBits) & ~1u);
+  const uint32_t indexBits = mortonBits + sampleBits;
+
+  const uint32_t morton =
+      spreadEvenBits(pixelX) | (spreadEvenBits(pixelY) << 1);
+  tileSeed = mortonBits < 32 ? morton >> mortonBits : 0;
+  const uint32_t mortonIndex =
+      ((morton & lowBitMask(mortonBits)) << sampleBits) |
+      (sampleIndex & lowBitMask(sampleBits));
+
+  const uint32_t dimensionSalt = 0x55555555u * sampleDimension;
+  uint32_t index = 0;
+  for (int shift = int(indexBits) - 2; shift >= int(indexBits & 1u);
+       shift -= 2) {
+    const uint32_t digit = (mortonIndex >> shift) & 3u;
+    const uint32_t higherDigits =
+        shift + 2 < 32 ? mortonIndex >> (shift + 2) : 0;
+    const uint32_t permutation =
+        (hashUint(higherDigits ^ dimensionSalt) >> 24) % 24;
+    index |= ((Base4Permutations[permutation] >> (2 * digit)) & 3u) << shift;
+  }
+  if (indexBits & 1u) {
+    index |= (mortonIndex & 1u) ^
+             (hashUint((mortonIndex >> 1) ^ dimensionSalt) & 1u);
+  }
+  return index;
+}
+
+void CpuSampler::startBounce(uint32_t bounce) {
+  dimension = bounce * SobolDimensions;
+}
+
+float CpuSampler::next1D() {
+  float result;
+  const auto type = static_cast<SamplerType>(params.samplerType);
+  if (type == SamplerType::Sobol) {
+    result = getSobolSample(dimension);
+  } else if (type == SamplerType::ZSobol) {
+    uint32_t tileSeed;
+    const uint32_t index = getZSobolIndex(dimension, tileSeed);
+    const uint32_t seed = hashCombine(tileSeed, dimension);
+    result = toUnitFloat(
+        nestedUniformScramble(sobolSample(index, 0), hashCombine(seed, 0)));
+  } else {
+    result = getRandomSample(dimension);
+  }
+  dimension++;
+  return result;
+}
+
+Vec2 CpuSampler::next2D() {
+  Vec2 result;
+  const auto type = static_cast<SamplerType>(params.samplerType);
+  if (type == SamplerType::Sobol) {
+    result = {getSobolSample(dimension), getSobolSample(dimension + 1)};
+  } else if (type == SamplerType::ZSobol) {
+    uint32_t tileSeed;
+    const uint32_t index = getZSobolIndex(dimension, tileSeed);
+    const uint32_t seed = hashCombine(tileSeed, dimension);
+    result = {toUnitFloat(nestedUniformScramble(sobolSample(index, 0),
+                                                hashCombine(seed, 0))),
+              toUnitFloat(nestedUniformScramble(sobolSample(index, 1),
+                                                hashCombine(seed, 1)))};
+  } else {
+    result = {getRandomSample(dimension), getRandomSample(dimension + 1)};
+  }
+  dimension += 2;
+  return result;
+}
+}  // namespace core_internal::rendering::cpu
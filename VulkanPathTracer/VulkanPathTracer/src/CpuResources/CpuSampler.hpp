@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+#include "../Core/Rendering/RenderParameters.hpp"
+#include "CpuMath.hpp"
+
+namespace core_internal::rendering::cpu {
+// A step of the PCG stream the samplers used to draw from, for the random
+// rays of the benchmarks
+float stepAndOutputRNGFloat(uint32_t& rngState);
+uint32_t hashUint(uint32_t x);
+// pcg4d of shaders/sampler.glsl, hashing v in place
+void pcg4d(uint32_t v[4]);
+uint32_t hashCombine(uint32_t seed, uint32_t value);
+// Owen scrambling of the bits of x, as nestedUniformScramble in
+// shaders/sampler.glsl
+uint32_t nestedUniformScramble(uint32_t x, uint32_t seed);
+
+// Host equivalent of PathSampler in shaders/sampler.glsl: draws the same
+// numbers for the same pixel, sample index and dimension, with the sampler
+// selected by params.samplerType. sobolMatrices is laid out as
+// makeSobolMatrices returns it and must outlive the sampler.
+class CpuSampler {
+ private:
+  const RenderParameters& params;
+  std::span<const uint32_t> sobolMatrices;
+  uint32_t pixelX, pixelY;
+  uint32_t sampleIndex;
+  uint32_t dimension = 0;
+
+  float getRandomSample(uint32_t sampleDimension) const;
+  uint32_t sobolSample(uint32_t index, uint32_t sobolDimension) const;
+  float getSobolSample(uint32_t sampleDimension) const;
+  uint32_t getZSobolIndex(uint32_t sampleDimension, uint32_t& tileSeed) const;
+
+ public:
+  CpuSampler(const RenderParameters& params,
+             std::span<const uint32_t> sobolMatrices, uint32_t pixelX,
+             uint32_t pixelY, uint32_t sampleIndex);
+
+  // Moves on to the block of dimensions of a bounce, like startBounce
+  void startBounce(uint32_t bounce);
+  float next1D();
+  Vec2 next2D();
+};
+}  // namespace core_internal::rendering::cpu
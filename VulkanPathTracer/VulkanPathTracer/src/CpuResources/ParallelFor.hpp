@@ -0,0 +1,47 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace core_internal::rendering::cpu {
+// 0 resolves to every hardware thread
+inline uint32_t resolveThreadCount(uint32_t requested) {
+  if (requested == 0) {
+    return std::max(1u, std::thread::hardware_concurrency());
+  }
+  return requested;
+}
+
+// Calls fn(index) for every index in [0, count). Work items are handed out
+// dynamically from a shared counter so uneven items balance across threads.
+template <class Fn>
+void parallelFor(uint32_t count, uint32_t threadCount, const Fn& fn) {
+  threadCount = std::min(resolveThreadCount(threadCount), count);
+  if (threadCount <= 1) {
+    for (uint32_t i = 0; i < count; i++) {
+      fn(i);
+    }
+    return;
+  }
+
+  std::atomic<uint32_t> next{0};
+  auto worker = [&]() {
+    for (uint32_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+      fn(i);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  workers.reserve(threadCount - 1);
+  for (uint32_t i = 1; i < threadCount; i++) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : workers) {
+    thread.join();
+  }
+}
+}  // namespace core_internal::rendering::cpu
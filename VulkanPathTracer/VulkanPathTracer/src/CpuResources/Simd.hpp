@@ -0,0 +1,261 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__AVX2__)
+#define CPU_SIMD_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CPU_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+// 8-wide float vector used by the BVH8 kernels. Compiled to a single AVX2
+// register when the target enables AVX2 (see VPT_ENABLE_AVX2), otherwise
+// emulated with two SSE2 registers or, on other architectures, plain arrays.
+namespace core_internal::rendering::cpu {
+#if defined(CPU_SIMD_AVX2)
+inline const char* simdIsaName() { return "AVX2"; }
+
+struct vbool8 {
+  __m256 m;
+};
+
+struct vfloat8 {
+  __m256 v;
+
+  static vfloat8 load(const float* p) { return {_mm256_loadu_ps(p)}; }
+  static vfloat8 broadcast(float s) { return {_mm256_set1_ps(s)}; }
+  static vfloat8 fromBytes(const uint8_t* p) {
+    __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+    return {_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes))};
+  }
+  void store(float* p) const { _mm256_storeu_ps(p, v); }
+};
+
+inline vfloat8 operator+(vfloat8 a, vfloat8 b) {
+  return {_mm256_add_ps(a.v, b.v)};
+}
+inline vfloat8 operator-(vfloat8 a, vfloat8 b) {
+  return {_mm256_sub_ps(a.v, b.v)};
+}
+inline vfloat8 operator*(vfloat8 a, vfloat8 b) {
+  return {_mm256_mul_ps(a.v, b.v)};
+}
+inline vfloat8 fmadd(vfloat8 a, vfloat8 b, vfloat8 c) {
+#if defined(__FMA__)
+  return {_mm256_fmadd_ps(a.v, b.v, c.v)};
+#else
+  return a * b + c;
+#endif
+}
+inline vfloat8 min(vfloat8 a, vfloat8 b) { return {_mm256_min_ps(a.v, b.v)}; }
+inline vfloat8 max(vfloat8 a, vfloat8 b) { return {_mm256_max_ps(a.v, b.v)}; }
+inline vfloat8 abs(vfloat8 a) {
+  return {_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)};
+}
+inline vfloat8 rcp(vfloat8 a) {
+  return {_mm256_div_ps(_mm256_set1_ps(1.0f), a.v)};
+}
+
+inline vbool8 operator<(vfloat8 a, vfloat8 b) {
+  return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)};
+}
+inline vbool8 operator<=(vfloat8 a, vfloat8 b) {
+  return {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)};
+}
+inline vbool8 operator>(vfloat8 a, vfloat8 b) { return b < a; }
+inline vbool8 operator>=(vfloat8 a, vfloat8 b) { return b <= a; }
+inline vbool8 operator&(vbool8 a, vbool8 b) {
+  return {_mm256_and_ps(a.m, b.m)};
+}
+inline vbool8 operator|(vbool8 a, vbool8 b) { return {_mm256_or_ps(a.m, b.m)}; }
+inline uint32_t movemask(vbool8 a) {
+  return static_cast<uint32_t>(_mm256_movemask_ps(a.m));
+}
+inline vfloat8 select(vbool8 m, vfloat8 a, vfloat8 b) {
+  return {_mm256_blendv_ps(b.v, a.v, m.m)};
+}
+#elif defined(CPU_SIMD_SSE2)
+inline const char* simdIsaName() { return "SSE2"; }
+
+struct vbool8 {
+  __m128 lo, hi;
+};
+
+struct vfloat8 {
+  __m128 lo, hi;
+
+  static vfloat8 load(const float* p) {
+    return {_mm_loadu_ps(p), _mm_loadu_ps(p + 4)};
+  }
+  static vfloat8 broadcast(float s) {
+    return {_mm_set1_ps(s), _mm_set1_ps(s)};
+  }
+  static vfloat8 fromBytes(const uint8_t* p) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+    __m128i words = _mm_unpacklo_epi8(bytes, zero);
+    return {_mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero)),
+            _mm_cvtepi32_ps(_mm_unpackhi_epi16(words, zero))};
+  }
+  void store(float* p) const {
+    _mm_storeu_ps(p, lo);
+    _mm_storeu_ps(p + 4, hi);
+  }
+};
+
+inline vfloat8 operator+(vfloat8 a, vfloat8 b) {
+  return {_mm_add_ps(a.lo, b.lo), _mm_add_ps(a.hi, b.hi)};
+}
+inline vfloat8 operator-(vfloat8 a, vfloat8 b) {
+  return {_mm_sub_ps(a.lo, b.lo), _mm_sub_ps(a.hi, b.hi)};
+}
+inline vfloat8 operator*(vfloat8 a, vfloat8 b) {
+  return {_mm_mul_ps(a.lo, b.lo), _mm_mul_ps(a.hi, b.hi)};
+}
+inline vfloat8 fmadd(vfloat8 a, vfloat8 b, vfloat8 c) { return a * b + c; }
+inline vfloat8 min(vfloat8 a, vfloat8 b) {
+  return {_mm_min_ps(a.lo, b.lo), _mm_min_ps(a.hi, b.hi)};
+}
+inline vfloat8 max(vfloat8 a, vfloat8 b) {
+  return {_mm_max_ps(a.lo, b.lo), _mm_max_ps(a.hi, b.hi)};
+}
+inline vfloat8 abs(vfloat8 a) {
+  __m128 sign = _mm_set1_ps(-0.0f);
+  return {_mm_andnot_ps(sign, a.lo), _mm_andnot_ps(sign, a.hi)};
+}
+inline vfloat8 rcp(vfloat8 a) {
+  __m128 one = _mm_set1_ps(1.0f);
+  return {_mm_div_ps(one, a.lo), _mm_div_ps(one, a.hi)};
+}
+
+inline vbool8 operator<(vfloat8 a, vfloat8 b) {
+  return {_mm_cmplt_ps(a.lo, b.lo), _mm_cmplt_ps(a.hi, b.hi)};
+}
+inline vbool8 operator<=(vfloat8 a, vfloat8 b) {
+  return {_mm_cmple_ps(a.lo, b.lo), _mm_cmple_ps(a.hi, b.hi)};
+}
+inline vbool8 operator>(vfloat8 a, vfloat8 b) { return b < a; }
+inline vbool8 operator>=(vfloat8 a, vfloat8 b) { return b <= a; }
+inline vbool8 operator&(vbool8 a, vbool8 b) {
+  return {_mm_and_ps(a.lo, b.lo), _mm_and_ps(a.hi, b.hi)};
+}
+inline vbool8 operator|(vbool8 a, vbool8 b) {
+  return {_mm_or_ps(a.lo, b.lo), _mm_or_ps(a.hi, b.hi)};
+}
+inline uint32_t movemask(vbool8 a) {
+  return static_cast<uint32_t>(_mm_movemask_ps(a.lo) |
+                               (_mm_movemask_ps(a.hi) << 4));
+}
+inline vfloat8 select(vbool8 m, vfloat8 a, vfloat8 b) {
+  return {_mm_or_ps(_mm_and_ps(m.lo, a.lo), _mm_andnot_ps(m.lo, b.lo)),
+          _mm_or_ps(_mm_and_ps(m.hi, a.hi), _mm_andnot_ps(m.hi, b.hi))};
+}
+#else
+inline const char* simdIsaName() { return "scalar"; }
+
+struct vbool8 {
+  bool m[8];
+};
+
+struct vfloat8 {
+  float v[8];
+
+  static vfloat8 load(const float* p) {
+    vfloat8 r;
+    for (int i = 0; i < 8; i++) r.v[i] = p[i];
+    return r;
+  }
+  static vfloat8 broadcast(float s) {
+    vfloat8 r;
+    for (int i = 0; i < 8; i++) r.v[i] = s;
+    return r;
+  }
+  static vfloat8 fromBytes(const uint8_t* p) {
+    vfloat8 r;
+    for (int i = 0; i < 8; i++) r.v[i] = float(p[i]);
+    return r;
+  }
+  void store(float* p) const {
+    for (int i = 0; i < 8; i++) p[i] = v[i];
+  }
+};
+
+#define CPU_SIMD_LANEWISE(expr) \
+  for (int i = 0; i < 8; i++) r.expr;
+
+inline vfloat8 operator+(vfloat8 a, vfloat8 b) {
+  vfloat8 r;
+  CPU_SIMD_LANEWISE(v[i] = a.v[i] + b.v[i])
+  return r;
+}
+inline vfloat8 operator-(vfloat8 a, vfloat8 b) {
+  vfloat8 r;
+  CPU_SIMD_LANEWISE(v[i] = a.v[i] - b.v[i])
+  return r;
+}
+inline vfloat8 operator*(vfloat8 a, vfloat8 b) {
+  vfloat8 r;
+  CPU_SIMD_LANEWISE(v[i] = a.v[i] * b.v[i])
+  return r;
+}
+inline vfloat8 fmadd(vfloat8 a, vfloat8 b, vfloat8 c) { return a * b + c; }
+inline vfloat8 min(vfloat8 a, vfloat8 b) {
+  vfloat8 r;
+  CPU_SIMD_LANEWISE(v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i])
+  return r;
+}
+inline vfloat8 max(vfloat8 a, vfloat8 b) {
+  vfloat8 r;
+  CPU_SIMD_LANEWISE(v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i])
+  return r;
+}
+inline vfloat8 abs(vfloat8 a) {
+  vfloat8 r;
+  CPU_SIMD_LANEWISE(v[i] = a.v[i] < 0.0f ? -a.v[i] : a.v[i])
+  return r;
+}
+inline vfloat8 rcp(vfloat8 a) {
+  vfloat8 r;
+  CPU_SIMD_LANEWISE(v[i] = 1.0f / a.v[i])
+  return r;
+}
+
+inline vbool8 operator<(vfloat8 a, vfloat8 b) {
+  vbool8 r;
+  CPU_SIMD_LANEWISE(m[i] = a.v[i] < b.v[i])
+  return r;
+}
+inline vbool8 operator<=(vfloat8 a, vfloat8 b) {
+  vbool8 r;
+  CPU_SIMD_LANEWISE(m[i] = a.v[i] <= b.v[i])
+  return r;
+}
+inline vbool8 operator>(vfloat8 a, vfloat8 b) { return b < a; }
+inline vbool8 operator>=(vfloat8 a, vfloat8 b) { return b <= a; }
+inline vbool8 operator&(vbool8 a, vbool8 b) {
+  vbool8 r;
+  CPU_SIMD_LANEWISE(m[i] = a.m[i] && b.m[i])
+  return r;
+}
+inline vbool8 operator|(vbool8 a, vbool8 b) {
+  vbool8 r;
+  CPU_SIMD_LANEWISE(m[i] = a.m[i] || b.m[i])
+  return r;
+}
+inline uint32_t movemask(vbool8 a) {
+  uint32_t mask = 0;
+  for (int i = 0; i < 8; i++) mask |= uint32_t(a.m[i]) << i;
+  return mask;
+}
+inline vfloat8 select(vbool8 m, vfloat8 a, vfloat8 b) {
+  vfloat8 r;
+  CPU_SIMD_LANEWISE(v[i] = m.m[i] ? a.v[i] : b.v[i])
+  return r;
+}
+
+#undef CPU_SIMD_LANEWISE
+#endif
+}  // namespace core_internal::rendering::cpu
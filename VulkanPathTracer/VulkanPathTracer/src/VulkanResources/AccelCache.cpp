@@ -0,0 +1,124 @@
+#include "AccelCache.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "../Core/Tools/HelperMacros.hpp"
+
+namespace core_internal::rendering::raytracing {
+namespace {
+constexpr char AccelCacheMagic[8] = "VPTACCL";
+}  // namespace
+
+uint64_t AccelCache::getDeserializedSize(size_t entry) const {
+  uint64_t size;
+  std::memcpy(&size, data.data() + entries[entry].offset + 2 * VK_UUID_SIZE + 8,
+              sizeof(size));
+  return size;
+}
+
+std::string getAccelCachePath(const std::string& sourcePath) {
+  return sourcePath + ".vptaccel";
+}
+
+bool mapAccelCache(const std::string& sourcePath, uint64_t contentHash,
+                   VkBuildAccelerationStructureFlagsKHR buildFlags,
+                   AccelCache& cache) {
+  const std::string cachePath = getAccelCachePath(sourcePath);
+  if (!cache.mapping.open(cachePath) ||
+      cache.mapping.getSize() < sizeof(AccelCacheHeader)) {
+    return false;
+  }
+
+  AccelCacheHeader header;
+  std::memcpy(&header, cache.mapping.getData(), sizeof(header));
+  if (std::memcmp(header.magic, AccelCacheMagic, sizeof(header.magic)) != 0 ||
+      header.version != AccelCacheVersion ||
+      header.headerSize != sizeof(AccelCacheHeader) ||
+      header.contentHash != contentHash || header.buildFlags != buildFlags) {
+    cache.mapping.close();
+    return false;
+  }
+
+  // Everything below comes from disk, check it before forming the views
+  const uint64_t fileSize = cache.mapping.getSize();
+  const uint64_t entryBytes = header.entryCount * sizeof(AccelCacheEntry);
+  bool valid = header.entryCount <= fileSize / sizeof(AccelCacheEntry) &&
+               entryBytes <= fileSize - sizeof(header) &&
+               isAligned(header.dataOffset, AccelCacheAlignment) &&
+               header.dataOffset >= sizeof(header) + entryBytes &&
+               header.dataOffset <= fileSize &&
+               header.dataSize <= fileSize - header.dataOffset;
+  if (valid) {
+    const uint8_t* data = cache.mapping.getData();
+    cache.entries = std::span<const AccelCacheEntry>(
+        reinterpret_cast<const AccelCacheEntry*>(data + sizeof(header)),
+        header.entryCount);
+    cache.data = std::span<const uint8_t>(data + header.dataOffset,
+                                          header.dataSize);
+    for (const AccelCacheEntry& entry : cache.entries) {
+      valid = valid && isAligned(entry.offset, AccelCacheAlignment) &&
+              entry.size >= SerializedAccelHeaderSize &&
+              entry.offset <= header.dataSize &&
+              entry.size <= header.dataSize - entry.offset;
+    }
+  }
+  if (!valid) {
+    DEBUG_WARNING("Ignoring malformed acceleration structure cache \"" +
+                  cachePath + "\"");
+    cache.entries = {};
+    cache.data = {};
+    cache.mapping.close();
+    return false;
+  }
+  return true;
+}
+
+bool writeAccelCache(const std::string& sourcePath, uint64_t contentHash,
+                     VkBuildAccelerationStructureFlagsKHR buildFlags,
+                     std::span<const AccelCacheEntry> entries,
+                     std::span<const uint8_t> data) {
+  AccelCacheHeader header{};
+  std::memcpy(header.magic, AccelCacheMagic, sizeof(header.magic));
+  header.version = AccelCacheVersion;
+  header.headerSize = sizeof(AccelCacheHeader);
+  header.contentHash = contentHash;
+  header.buildFlags = buildFlags;
+  header.entryCount = entries.size();
+  header.dataOffset = alignUp(uint64_t(sizeof(header)) + entries.size_bytes(),
+                              AccelCacheAlignment);
+  header.dataSize = data.size();
+
+  const std::string cachePath = getAccelCachePath(sourcePath);
+  const std::string tempPath = cachePath + ".tmp";
+  {
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      return false;
+    }
+    const char padding[AccelCacheAlignment] = {};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(entries.data()),
+               static_cast<std::streamsize>(entries.size_bytes()));
+    const uint64_t position = static_cast<uint64_t>(file.tellp());
+    file.write(padding,
+               static_cast<std::streamsize>(header.dataOffset - position));
+    file.write(reinterpret_cast<const char*>(data.data()),
+               static_cast<std::streamsize>(data.size()));
+    if (!file.good()) {
+      file.close();
+      std::filesystem::remove(tempPath);
+      return false;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(tempPath, cachePath, error);
+  if (error) {
+    std::filesystem::remove(tempPath, error);
+    return false;
+  }
+  return true;
+}
+}  // namespace core_internal::rendering::raytracing
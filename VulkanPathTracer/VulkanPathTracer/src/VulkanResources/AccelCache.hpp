@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+#include "../Core/Tools/MappedFile.hpp"
+
+namespace core_internal::rendering::raytracing {
+// Serialized BLAS of a scene, written next to it as "<scene>.vptaccel". The
+// header is followed by one AccelCacheEntry per BLAS and the structures in
+// the driver's serialized format (vkCmdCopyAccelerationStructureToMemoryKHR)
+// at AccelCacheAlignment aligned offsets into the data section, which is
+// uploaded to the GPU as is. Caches are keyed by the mesh content hash and
+// the build flags; whether the driver can read them is checked on load.
+constexpr uint32_t AccelCacheVersion = 1;
+// Required alignment of serialized acceleration structure addresses
+constexpr uint64_t AccelCacheAlignment = 256;
+// Serialized structures start with the driver and compatibility UUIDs,
+// followed by the serialized size, the deserialized size and the number of
+// referenced handles
+constexpr uint64_t SerializedAccelHeaderSize = 2 * VK_UUID_SIZE + 3 * 8;
+
+struct AccelCacheHeader {
+  char magic[8];  // "VPTACCL\0"
+  uint32_t version;
+  uint32_t headerSize;
+  uint64_t contentHash;
+  uint64_t buildFlags;
+  uint64_t entryCount;
+  uint64_t dataOffset;
+  uint64_t dataSize;
+};
+static_assert(sizeof(AccelCacheHeader) == 56);
+
+struct AccelCacheEntry {
+  // Relative to the data section
+  uint64_t offset;
+  uint64_t size;
+};
+
+// A mapped cache file, valid while it stays open
+struct AccelCache {
+  core_internal::rendering::tools::MappedFile mapping;
+  std::span<const AccelCacheEntry> entries;
+  std::span<const uint8_t> data;
+
+  // Size of the structure entry deserializes to
+  uint64_t getDeserializedSize(size_t entry) const;
+};
+
+std::string getAccelCachePath(const std::string& sourcePath);
+
+// Maps the cache of sourcePath. Returns false if there is none, it is
+// malformed, or it was written for a different mesh or build flags.
+bool mapAccelCache(const std::string& sourcePath, uint64_t contentHash,
+                   VkBuildAccelerationStructureFlagsKHR buildFlags,
+                   AccelCache& cache);
+
+// Writes the cache of sourcePath under a temporary name and renames it, so
+// concurrent readers never see a partial cache
+bool writeAccelCache(const std::string& sourcePath, uint64_t contentHash,
+                     VkBuildAccelerationStructureFlagsKHR buildFlags,
+                     std::span<const AccelCacheEntry> entries,
+                     std::span<const uint8_t> data);
+}  // namespace core_internal::rendering::raytracing
@@ -0,0 +1,142 @@
+#include "AccelMemoryPool.hpp"
+
+#include "../Core/Tools/HelperMacros.hpp"
+
+namespace core_internal::rendering::raytracing {
+static constexpr VkBufferUsageFlags AccelBufferUsage =
+    VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR |
+    VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+AccelMemoryPool::AccelMemoryPool(VulkanDevice* device, bool packed,
+                                 bool hostAccess, VkDeviceSize blockSize)
+    : device(device), blockSize(blockSize) {
+  // Any size works to pick the memory type, it only depends on the usage
+  VkBufferCreateInfo sampleBufCI{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = AccelAlignment,
+      .usage = AccelBufferUsage,
+  };
+  VmaAllocationCreateInfo sampleAllocCI{
+      .usage = hostAccess ? VMA_MEMORY_USAGE_AUTO
+                          : VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+      .requiredFlags = hostAccess ? VkMemoryPropertyFlags(
+                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+                                  : VkMemoryPropertyFlags(
+                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+  };
+  if (hostAccess) {
+    sampleAllocCI.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT;
+  }
+  uint32_t memoryTypeIndex = 0;
+  VK_CHECK_RESULT(vmaFindMemoryTypeIndexForBufferInfo(
+      device->operator VmaAllocator(), &sampleBufCI, &sampleAllocCI,
+      &memoryTypeIndex));
+
+  VmaPoolCreateInfo poolCI{
+      .memoryTypeIndex = memoryTypeIndex,
+      .flags = packed ? VmaPoolCreateFlags(VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT)
+                      : VmaPoolCreateFlags(0),
+      .blockSize = blockSize,
+  };
+  VK_CHECK_RESULT(
+      vmaCreatePool(device->operator VmaAllocator(), &poolCI, &pool));
+}
+
+AccelMemoryPool::~AccelMemoryPool() {
+  clear();
+  vmaDestroyPool(device->operator VmaAllocator(), pool);
+}
+
+tools::AccelData AccelMemoryPool::create(
+    const VkAccelerationStructureCreateInfoKHR& createInfo) {
+  tools::AccelData result;
+
+  VkBufferCreateInfo bufCI{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = createInfo.size,
+      .usage = AccelBufferUsage,
+  };
+  const bool dedicated = createInfo.size > blockSize / 2;
+  VmaAllocationCreateInfo allocCI{
+      .flags = dedicated ? VmaAllocationCreateFlags(
+                               VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT)
+                         : VmaAllocationCreateFlags(0),
+      .pool = pool,
+  };
+  VK_CHECK_RESULT(vmaCreateBufferWithAlignment(
+      device->operator VmaAllocator(), &bufCI, &allocCI, AccelAlignment,
+      &result.buf.buffer, &result.buf.alloc, nullptr));
+  result.buf.size = createInfo.size;
+
+  VkBufferDeviceAddressInfo addressInfo{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+      .buffer = result.buf.buffer,
+  };
+  result.buf.deviceAddress =
+      vkGetBufferDeviceAddress(device->operator VkDevice(), &addressInfo);
+
+  VkAccelerationStructureCreateInfoKHR accelCI = createInfo;
+  accelCI.buffer = result.buf.buffer;
+  accelCI.offset = 0;
+  VK_CHECK_RESULT(device->getExt().pfnCreateAccelerationStructureKHR(
+      device->operator VkDevice(), &accelCI, nullptr, &result.accel));
+
+  liveAccels.push_back(result.accel);
+  liveBuffers.push_back(result.buf);
+  usedBytes += createInfo.size;
+  return result;
+}
+
+void AccelMemoryPool::destroy(tools::AccelData& accel) {
+  if (accel.accel == VK_NULL_HANDLE) {
+    return;
+  }
+  for (size_t i = 0; i < liveAccels.size(); i++) {
+    if (liveAccels[i] != accel.accel) {
+      continue;
+    }
+    usedBytes -= liveBuffers[i].size;
+    // Swap with the last entry, the order of the structures doesn't matter
+    liveAccels[i] = liveAccels.back();
+    liveBuffers[i] = liveBuffers.back();
+    liveAccels.pop_back();
+    liveBuffers.pop_back();
+    break;
+  }
+  device->getExt().pfnDestroyAccelerationStructureKHR(
+      device->operator VkDevice(), accel.accel, nullptr);
+  device->destroy(&accel.buf);
+  accel = {};
+}
+
+void AccelMemoryPool::destroy(std::vector<tools::AccelData>& accels) {
+  for (auto& accel : accels) {
+    destroy(accel);
+  }
+  accels.clear();
+}
+
+void AccelMemoryPool::clear() {
+  for (size_t i = 0; i < liveAccels.size(); i++) {
+    device->getExt().pfnDestroyAccelerationStructureKHR(
+        device->operator VkDevice(), liveAccels[i], nullptr);
+    device->destroy(&liveBuffers[i]);
+  }
+  liveAccels.clear();
+  liveBuffers.clear();
+  usedBytes = 0;
+}
+
+AccelMemoryPool::Stats AccelMemoryPool::getStats() const {
+  VmaStatistics poolStats{};
+  vmaGetPoolStatistics(device->operator VmaAllocator(), pool, &poolStats);
+
+  Stats stats;
+  stats.usedBytes = usedBytes;
+  // VMA counts the pool's dedicated allocations as blocks of their own
+  stats.reservedBytes = poolStats.blockBytes;
+  stats.accelCount = static_cast<uint32_t>(liveAccels.size());
+  return stats;
+}
+}  // namespace core_internal::rendering::raytracing
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <vector>
+
+#include "../Core/Vulkan/VulkanDevice.h"
+
+namespace core_internal::rendering::raytracing {
+namespace tools {
+struct AccelData {
+  VkAccelerationStructureKHR accel = VK_NULL_HANDLE;
+  core_internal::rendering::Buffer buf{};
+};
+}  // namespace tools
+
+// Arena for acceleration structure storage, built on a VMA pool of device
+// local blocks. Every structure gets its own buffer suballocated from the
+// pool at AccelAlignment, so many small BLAS share a few memory blocks instead
+// of one allocation each. Structures larger than half a block get a dedicated
+// allocation of the pool's memory type. Destroying the pool releases every
+// structure still in it at once.
+class AccelMemoryPool {
+ public:
+  // Required alignment of acceleration structure offsets
+  static constexpr VkDeviceSize AccelAlignment = 256;
+  static constexpr VkDeviceSize DefaultBlockSize = VkDeviceSize(64) << 20;
+
+  struct Stats {
+    // Sum of the structure sizes
+    VkDeviceSize usedBytes = 0;
+    // Device memory held by the pool, including dedicated allocations
+    VkDeviceSize reservedBytes = 0;
+    uint32_t accelCount = 0;
+  };
+
+  // With packed set, allocations are placed back to back (VMA's linear
+  // algorithm), which suits structures that are freed all at once. With
+  // hostAccess set the blocks are host visible and coherent, as host builds
+  // (vkBuildAccelerationStructuresKHR) require.
+  AccelMemoryPool(VulkanDevice* device, bool packed, bool hostAccess = false,
+                  VkDeviceSize blockSize = DefaultBlockSize);
+  ~AccelMemoryPool();
+  AccelMemoryPool(const AccelMemoryPool&) = delete;
+  AccelMemoryPool& operator=(const AccelMemoryPool&) = delete;
+
+  // Creates the structure described by createInfo (size and type) with
+  // storage from the pool
+  tools::AccelData create(
+      const VkAccelerationStructureCreateInfoKHR& createInfo);
+  void destroy(tools::AccelData& accel);
+  void destroy(std::vector<tools::AccelData>& accels);
+  // Destroys every structure created from the pool
+  void clear();
+
+  Stats getStats() const;
+
+ private:
+  VulkanDevice* device;
+  VmaPool pool = VK_NULL_HANDLE;
+  VkDeviceSize blockSize;
+  // Structures alive in the pool, for clear()
+  std::vector<VkAccelerationStructureKHR> liveAccels;
+  std::vector<Buffer> liveBuffers;
+  VkDeviceSize usedBytes = 0;
+};
+}  // namespace core_internal::rendering::raytracing
@@ -0,0 +1,156 @@
+#include "KernelAutotuner.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace core_internal::rendering::raytracing {
+namespace {
+// Identifies the device and driver a tuned shape was measured on, as the
+// first three fields of a tuning file line
+std::string getDeviceKey(const VulkanDevice& device) {
+  const VkPhysicalDeviceProperties properties =
+      device.operator VkPhysicalDeviceProperties();
+  return std::to_string(properties.vendorID) + " " +
+         std::to_string(properties.deviceID) + " " +
+         std::to_string(properties.driverVersion);
+}
+
+std::vector<KernelShape> getCandidateShapes(
+    const PathTraceRenderer& renderer, const KernelAutotuneSettings& settings) {
+  std::vector<KernelShape> shapes;
+  for (uint32_t height = 1; height <= settings.maxWorkgroupSide; height *= 2) {
+    for (uint32_t width = 1; width <= settings.maxWorkgroupSide; width *= 2) {
+      const uint32_t invocations = width * height;
+      if (invocations < settings.minInvocations ||
+          invocations > settings.maxInvocations) {
+        continue;
+      }
+      for (PixelMapping mapping :
+           {PixelMapping::RowMajor, PixelMapping::Morton,
+            PixelMapping::TiledSwizzle}) {
+        KernelShape shape{width, height, mapping};
+        if (renderer.isSupported(shape)) {
+          shapes.push_back(shape);
+        }
+      }
+    }
+  }
+  return shapes;
+}
+}  // namespace
+
+KernelAutotuneResult runKernelAutotune(
+    PathTraceRenderer& renderer, const RenderJob& job,
+    const KernelAutotuneSettings& settings) {
+  KernelAutotuneResult result;
+  const std::vector<KernelShape> shapes =
+      getCandidateShapes(renderer, settings);
+
+  std::stringstream report;
+  report << "Kernel autotune: \"" << job.scenePath << "\", "
+         << job.params.resolution[0] << "x" << job.params.resolution[1]
+         << ", " << job.params.maxSegments - 1 << " bounces, "
+         << std::max(1u, job.params.samplesPerDispatch)
+         << " samples per dispatch, " << shapes.size() << " shapes\n";
+
+  for (const KernelShape& shape : shapes) {
+    double best = -1.0;
+    for (uint32_t i = 0; i < std::max(1u, settings.repetitions); i++) {
+      double milliseconds =
+          renderer.timeKernel(job, shape, settings.dispatchCount);
+      if (milliseconds >= 0.0 && (best < 0.0 || milliseconds < best)) {
+        best = milliseconds;
+      }
+    }
+
+    report << "  " << std::left << std::setw(24) << shape.toString()
+           << std::right;
+    if (best < 0.0) {
+      report << "    failed\n";
+      continue;
+    }
+    report << std::setw(10) << std::fixed << std::setprecision(3) << best
+           << " ms\n";
+    report.unsetf(std::ios::fixed);
+
+    if (result.bestMilliseconds < 0.0 || best < result.bestMilliseconds) {
+      result.best = shape;
+      result.bestMilliseconds = best;
+    }
+  }
+
+  if (result.bestMilliseconds >= 0.0) {
+    report << "  Best: " << result.best.toString() << "\n";
+  }
+  result.report = report.str();
+  return result;
+}
+
+bool loadKernelShape(const std::string& path, const VulkanDevice& device,
+                     KernelShape& shape) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    return false;
+  }
+
+  const std::string deviceKey = getDeviceKey(device);
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.rfind(deviceKey + " ", 0) != 0) {
+      continue;
+    }
+    std::stringstream fields(line.substr(deviceKey.size()));
+    KernelShape tuned;
+    std::string mapping;
+    if (fields >> tuned.workgroupWidth >> tuned.workgroupHeight >> mapping &&
+        parsePixelMapping(mapping, tuned.pixelMapping)) {
+      shape = tuned;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool saveKernelShape(const std::string& path, const VulkanDevice& device,
+                     const KernelShape& shape) {
+  const std::string deviceKey = getDeviceKey(device);
+
+  // Keep every other device's line
+  std::vector<std::string> lines;
+  {
+    std::ifstream file(path);
+    for (std::string line; std::getline(file, line);) {
+      if (!line.empty() && line.rfind(deviceKey + " ", 0) != 0) {
+        lines.push_back(line);
+      }
+    }
+  }
+  lines.push_back(deviceKey + " " + std::to_string(shape.workgroupWidth) +
+                  " " + std::to_string(shape.workgroupHeight) + " " +
+                  toString(shape.pixelMapping) + " # " +
+                  device.operator VkPhysicalDeviceProperties().deviceName);
+
+  const std::string tempPath = path + ".tmp";
+  {
+    std::ofstream file(tempPath, std::ios::trunc);
+    for (const std::string& line : lines) {
+      file << line << "\n";
+    }
+    if (!file.good()) {
+      file.close();
+      std::filesystem::remove(tempPath);
+      return false;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(tempPath, path, error);
+  if (error) {
+    std::filesystem::remove(tempPath, error);
+    return false;
+  }
+  return true;
+}
+}  // namespace core_internal::rendering::raytracing
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../Core/Rendering/RenderJob.hpp"
+#include "KernelVariants.hpp"
+#include "PathTraceRenderer.hpp"
+
+namespace core_internal::rendering::raytracing {
+struct KernelAutotuneSettings {
+  // Every power of two workgroup up to maxWorkgroupSide per axis whose
+  // invocation count lies in [minInvocations, maxInvocations] is tried with
+  // every pixel mapping it supports
+  uint32_t minInvocations = 32;
+  uint32_t maxInvocations = 256;
+  uint32_t maxWorkgroupSide = 64;
+  // Timed dispatches per measurement, the best of repetitions is kept
+  uint32_t dispatchCount = 4;
+  uint32_t repetitions = 3;
+};
+
+struct KernelAutotuneResult {
+  KernelShape best;
+  // Time per dispatch of the best shape, negative if nothing could be timed
+  double bestMilliseconds = -1.0;
+  // Printable table of every shape tried
+  std::string report;
+};
+
+// Times the job's scene at its resolution and bounce count with every
+// candidate kernel shape. Divergence in the bounce loop makes the best shape
+// depend on both the device and the scene, so tune on a representative job.
+KernelAutotuneResult runKernelAutotune(
+    PathTraceRenderer& renderer, const RenderJob& job,
+    const KernelAutotuneSettings& settings = {});
+
+// The tuning file holds one line per device and driver version:
+//   <vendorID> <deviceID> <driverVersion> <width> <height> <mapping> # <name>
+// Loads the shape tuned for this device, returns false if there is none.
+bool loadKernelShape(const std::string& path, const VulkanDevice& device,
+                     KernelShape& shape);
+// Stores the shape for this device, keeping the lines of other devices
+bool saveKernelShape(const std::string& path, const VulkanDevice& device,
+                     const KernelShape& shape);
+}  // namespace core_internal::rendering::raytracing
@@ -0,0 +1,138 @@
+#include "KernelVariants.hpp"
+
+#include <array>
+
+#include "../Core/Tools/Hash.hpp"
+#include "../Core/Tools/HelperMacros.hpp"
+
+namespace core_internal::rendering::raytracing {
+const char* toString(PixelMapping mapping) {
+  switch (mapping) {
+    case PixelMapping::RowMajor:
+      return "row-major";
+    case PixelMapping::Morton:
+      return "morton";
+    case PixelMapping::TiledSwizzle:
+      return "tiled-swizzle";
+  }
+  return "unknown";
+}
+
+bool parsePixelMapping(const std::string& name, PixelMapping& mapping) {
+  for (PixelMapping candidate :
+       {PixelMapping::RowMajor, PixelMapping::Morton,
+        PixelMapping::TiledSwizzle}) {
+    if (name == toString(candidate)) {
+      mapping = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string KernelShape::toString() const {
+  return std::to_string(workgroupWidth) + "x" +
+         std::to_string(workgroupHeight) + " " +
+         raytracing::toString(pixelMapping);
+}
+
+KernelVariantRegistry::KernelVariantRegistry(VulkanDevice* device,
+                                             VkPipelineLayout layout)
+    : device(device), layout(layout) {}
+
+KernelVariantRegistry::~KernelVariantRegistry() {
+  for (auto& [hash, pipeline] : pipelines) {
+    vkDestroyPipeline(device->operator VkDevice(), pipeline, nullptr);
+  }
+}
+
+bool KernelVariantRegistry::isSupported(const KernelShape& shape) const {
+  const VkPhysicalDeviceLimits limits =
+      device->operator VkPhysicalDeviceProperties().limits;
+  const uint32_t width = shape.workgroupWidth;
+  const uint32_t height = shape.workgroupHeight;
+  if (width == 0 || height == 0 || width > limits.maxComputeWorkGroupSize[0] ||
+      height > limits.maxComputeWorkGroupSize[1] ||
+      width * height > limits.maxComputeWorkGroupInvocations) {
+    return false;
+  }
+  if (shape.pixelMapping == PixelMapping::Morton) {
+    // The local index is split into even (x) and odd (y) bits
+    auto isPowerOfTwo = [](uint32_t v) { return (v & (v - 1)) == 0; };
+    return isPowerOfTwo(width) && isPowerOfTwo(height) &&
+           (width == height || width == 2 * height);
+  }
+  return true;
+}
+
+VkPipeline KernelVariantRegistry::getPipeline(const std::string& shaderPath,
+                                              const KernelVariant& variant) {
+  auto shaderIt = shaders.find(shaderPath);
+  if (shaderIt == shaders.end()) {
+    // Only read and hashed on first use, the module is owned by the device
+    Shader shader;
+    shader.module = device->loadShaderModule(shaderPath.c_str(), &shader.hash);
+    if (shader.module == VK_NULL_HANDLE) {
+      DEBUG_ERROR("Could not open shader file \"" + shaderPath + "\"");
+    }
+    shaderIt = shaders.emplace(shaderPath, shader).first;
+  }
+  const Shader& shader = shaderIt->second;
+
+  const KernelShape& shape = variant.shape;
+  const std::array<uint32_t, 6> constants = {
+      shape.workgroupWidth,
+      shape.workgroupHeight,
+      static_cast<uint32_t>(shape.pixelMapping),
+      variant.maxSegments,
+      variant.samplesPerDispatch,
+      static_cast<uint32_t>(variant.wavefrontStage)};
+  const uint64_t key = tools::hashCombine(
+      shader.hash, tools::hashBytes(constants.data(), sizeof(constants)));
+  auto pipelineIt = pipelines.find(key);
+  if (pipelineIt != pipelines.end()) {
+    return pipelineIt->second;
+  }
+
+  if (!isSupported(shape)) {
+    DEBUG_ERROR("Kernel shape " + shape.toString() +
+                " is not supported by the device");
+  }
+
+  std::array<VkSpecializationMapEntry, constants.size()> mapEntries;
+  for (uint32_t i = 0; i < mapEntries.size(); i++) {
+    mapEntries[i] = {
+        .constantID = i,
+        .offset = static_cast<uint32_t>(i * sizeof(uint32_t)),
+        .size = sizeof(uint32_t),
+    };
+  }
+  VkSpecializationInfo specializationInfo{
+      .mapEntryCount = static_cast<uint32_t>(mapEntries.size()),
+      .pMapEntries = mapEntries.data(),
+      .dataSize = sizeof(constants),
+      .pData = constants.data(),
+  };
+
+  VkComputePipelineCreateInfo pipelineCI{
+      .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+      .stage =
+          {
+              .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+              .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+              .module = shader.module,
+              .pName = "main",
+              .pSpecializationInfo = &specializationInfo,
+          },
+      .layout = layout,
+  };
+
+  VkPipeline computePipeline;
+  VK_CHECK_RESULT(vkCreateComputePipelines(
+      device->operator VkDevice(), device->operator VkPipelineCache(), 1,
+      &pipelineCI, nullptr, &computePipeline));
+
+  pipelines[key] = computePipeline;
+  return computePipeline;
+}
+}  // namespace core_internal::rendering::raytracing
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <string>
+#include <unordered_map>
+
+#include "../Core/Vulkan/VulkanDevice.h"
+
+namespace core_internal::rendering::raytracing {
+// How pt.comp assigns its invocations to pixels
+enum class PixelMapping : uint32_t {
+  // Invocation (x, y) of the dispatch shades pixel (x, y)
+  RowMajor = 0,
+  // Z-order curve inside every workgroup. Needs power of two workgroup sides
+  // with a width of once or twice the height.
+  Morton = 1,
+  // Consecutive workgroups walk down column strips SwizzleStripWidth
+  // workgroups wide instead of along whole image rows
+  TiledSwizzle = 2,
+};
+constexpr uint32_t SwizzleStripWidth = 8;  // Must match pt.comp
+
+const char* toString(PixelMapping mapping);
+// Returns false if name is not one of the toString() names
+bool parsePixelMapping(const std::string& name, PixelMapping& mapping);
+
+// Dispatch shape of pt.comp. Affects only performance, every shape renders
+// the same image.
+struct KernelShape {
+  static constexpr uint32_t DefaultWorkgroupWidth = 16;
+  static constexpr uint32_t DefaultWorkgroupHeight = 8;
+
+  uint32_t workgroupWidth = DefaultWorkgroupWidth;
+  uint32_t workgroupHeight = DefaultWorkgroupHeight;
+  PixelMapping pixelMapping = PixelMapping::RowMajor;
+
+  bool operator==(const KernelShape&) const = default;
+  // e.g. "16x8 row-major"
+  std::string toString() const;
+};
+
+// Kernel of shaders/wavefront.comp a pipeline runs. pt.comp ignores it.
+enum class WavefrontStage : uint32_t {
+  None = 0,  // The megakernel
+  Generate = 1,
+  Extend = 2,
+  Shade = 3,
+  Resolve = 4,
+};
+
+// Compile-time configuration of pt.comp and wavefront.comp, passed through
+// their specialization constants. The ids must match the layout(constant_id)
+// and local_size_*_id declarations in both shaders.
+struct KernelVariant {
+  // Workgroup width and height are constant_id 0 and 1, the pixel mapping
+  // constant_id 2
+  KernelShape shape;
+  // Loop bounds baked into the kernel so the compiler can unroll and drop the
+  // push constant loads. 0 leaves the bound dynamic, read from
+  // RenderParameters at dispatch time.
+  uint32_t maxSegments = 0;         // constant_id 3
+  uint32_t samplesPerDispatch = 0;  // constant_id 4
+  // Selects the kernel of the wavefront shader, constant_id 5
+  WavefrontStage wavefrontStage = WavefrontStage::None;
+
+  bool operator==(const KernelVariant&) const = default;
+};
+
+// Creates and caches one compute pipeline per shader and KernelVariant. The
+// shader modules are shared through VulkanDevice::loadShaderModule, so paths
+// holding the same SPIR-V also share their pipelines.
+class KernelVariantRegistry {
+ public:
+  KernelVariantRegistry(VulkanDevice* device, VkPipelineLayout layout);
+  ~KernelVariantRegistry();
+  KernelVariantRegistry(const KernelVariantRegistry&) = delete;
+  KernelVariantRegistry& operator=(const KernelVariantRegistry&) = delete;
+
+  // Whether the workgroup fits the device's compute limits and the pixel
+  // mapping can cover it
+  bool isSupported(const KernelShape& shape) const;
+
+  // Returns the pipeline for the variant, compiling it on first use through
+  // the device's pipeline cache
+  VkPipeline getPipeline(const std::string& shaderPath,
+                         const KernelVariant& variant);
+
+  size_t getPipelineCount() const { return pipelines.size(); }
+
+ private:
+  struct Shader {
+    uint64_t hash = 0;
+    VkShaderModule module = VK_NULL_HANDLE;
+  };
+
+  VulkanDevice* device;
+  VkPipelineLayout layout;
+  std::unordered_map<std::string, Shader> shaders;
+  // Keyed by the combined shader and variant hash
+  std::unordered_map<uint64_t, VkPipeline> pipelines;
+};
+}  // namespace core_internal::rendering::raytracing
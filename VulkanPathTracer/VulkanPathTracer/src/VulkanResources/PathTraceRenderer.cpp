@@ -0,0 +1,1096 @@
+#include "PathTraceRenderer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+
+#include "../Core/Rendering/LightTable.hpp"
+#include "../Core/Rendering/Sampler.hpp"
+#include "../Core/Tools/HelperMacros.hpp"
+#include "../Core/Vulkan/StagingUploader.hpp"
+
+namespace core_internal::rendering::raytracing {
+namespace {
+// Sizes of QueuedRay and QueuedHit in shaders/wavefront.comp
+constexpr VkDeviceSize WavefrontRaySize = 44;
+constexpr VkDeviceSize WavefrontHitSize = 64;
+// Queue counters, each an entry count followed by the workgroup counts of an
+// indirect dispatch, like QueueCounter in shaders/wavefront.comp
+constexpr uint32_t WavefrontCounterCount = 3;
+constexpr uint32_t WavefrontHitQueue = 2;
+constexpr VkDeviceSize WavefrontCounterSize = 4 * sizeof(uint32_t);
+}  // namespace
+
+PathTraceRenderer::PathTraceRenderer(VulkanDevice* device,
+                                     bool hostAccelBuilds)
+    : device(device), hostAccelBuilds(hostAccelBuilds) {
+  descriptorSet = new VulkanDescriptorSet(device);
+
+  descriptorSet->addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                            VK_SHADER_STAGE_COMPUTE_BIT);
+  descriptorSet->addBinding(1, VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1,
+                            VK_SHADER_STAGE_COMPUTE_BIT);
+  descriptorSet->addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                            VK_SHADER_STAGE_COMPUTE_BIT);
+  descriptorSet->addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                            VK_SHADER_STAGE_COMPUTE_BIT);
+  descriptorSet->addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                            VK_SHADER_STAGE_COMPUTE_BIT);
+  descriptorSet->addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                            VK_SHADER_STAGE_COMPUTE_BIT);
+  // Wavefront queues, only written once a wavefront job needs them. pt.comp
+  // doesn't use these bindings, so they may stay empty. Binding 9 is unused.
+  for (uint32_t binding = 6; binding <= 8; binding++) {
+    descriptorSet->addBinding(binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                              VK_SHADER_STAGE_COMPUTE_BIT);
+  }
+  descriptorSet->addBinding(10, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                            VK_SHADER_STAGE_COMPUTE_BIT);
+  descriptorSet->addBinding(11, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                            VK_SHADER_STAGE_COMPUTE_BIT);
+  // Materials and lights of the bound scene
+  descriptorSet->addBinding(12, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                            VK_SHADER_STAGE_COMPUTE_BIT);
+  descriptorSet->addBinding(13, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                            VK_SHADER_STAGE_COMPUTE_BIT);
+  descriptorSet->initLayout();
+  descriptorSet->initPool(1);
+
+  VkPushConstantRange pushConstantRange{
+      .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+      .offset = 0,
+      .size = sizeof(RenderParameters) + sizeof(WavefrontParameters),
+  };
+  descriptorSet->initPipelineLayout(1, &pushConstantRange);
+  kernels = new KernelVariantRegistry(
+      device, descriptorSet->operator VkPipelineLayout());
+
+  // Never reallocated, so it is bound once
+  VkBufferCreateInfo statisticsCI{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = 4 * sizeof(uint32_t),
+      .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+               VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+  };
+  device->createBuffer(&statisticsBuffer, statisticsCI,
+                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                       VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT |
+                           VMA_ALLOCATION_CREATE_MAPPED_BIT,
+                       true);
+  VkDescriptorBufferInfo statisticsDescriptorBufferInfo{
+      .buffer = statisticsBuffer.buffer,
+      .range = statisticsBuffer.size,
+  };
+
+  // The same for every job, so uploaded and bound once. The dispatches are
+  // queued behind the upload on the device.
+  const std::vector<uint32_t> sobolMatrices = makeSobolMatrices();
+  VkBufferCreateInfo sobolMatrixCI{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = sobolMatrices.size() * sizeof(uint32_t),
+      .usage =
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+  };
+  device->createBuffer(&sobolMatrixBuffer, sobolMatrixCI,
+                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  StagingUploader& uploader = device->getUploader();
+  uploader.upload(sobolMatrixBuffer, sobolMatrices.data(), sobolMatrixCI.size);
+  uploader.flush();
+  VkDescriptorBufferInfo sobolMatrixDescriptorBufferInfo{
+      .buffer = sobolMatrixBuffer.buffer,
+      .range = sobolMatrixBuffer.size,
+  };
+
+  std::array<VkWriteDescriptorSet, 2> constantWrites = {
+      descriptorSet->makeWrite(descriptorSet->getSet(0), 10,
+                               &statisticsDescriptorBufferInfo),
+      descriptorSet->makeWrite(descriptorSet->getSet(0), 11,
+                               &sobolMatrixDescriptorBufferInfo),
+  };
+  vkUpdateDescriptorSets(device->operator VkDevice(),
+                         static_cast<uint32_t>(constantWrites.size()),
+                         constantWrites.data(), 0, nullptr);
+
+  VkFenceCreateInfo fenceCI{.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+  for (ReadbackSlot& slot : readbackSlots) {
+    VK_CHECK_RESULT(vkCreateFence(device->operator VkDevice(), &fenceCI,
+                                  nullptr, &slot.fence));
+  }
+  readbackThread = std::thread(&PathTraceRenderer::readbackLoop, this);
+}
+
+PathTraceRenderer::~PathTraceRenderer() {
+  waitForReadbacks();
+  {
+    std::lock_guard<std::mutex> lock(readbackMutex);
+    stopReadbacks = true;
+  }
+  readbackChanged.notify_all();
+  readbackThread.join();
+  device->waitIdle();
+
+  for (ReadbackSlot& slot : readbackSlots) {
+    if (slot.capacity > 0) {
+      device->destroy(&slot.staging);
+    }
+    vkDestroyFence(device->operator VkDevice(), slot.fence, nullptr);
+  }
+
+  delete kernels;
+  for (auto& [hash, scene] : scenes) {
+    delete scene.rtBuilder;
+    device->destroy(&scene.vertexBuffer);
+    device->destroy(&scene.indexBuffer);
+    device->destroy(&scene.shapeBuffer);
+    device->destroy(&scene.materialBuffer);
+    device->destroy(&scene.lightBuffer);
+  }
+  if (targetPixelCapacity > 0) {
+    device->destroy(&imageBuffer);
+    device->destroy(&accumulationBuffer);
+  }
+  if (wavefrontPixelCapacity > 0) {
+    device->destroy(&wavefrontRays);
+    device->destroy(&wavefrontHits);
+    device->destroy(&wavefrontCounters);
+  }
+  device->destroy(&statisticsBuffer);
+  device->destroy(&sobolMatrixBuffer);
+  delete descriptorSet;
+}
+
+std::shared_ptr<const Mesh> PathTraceRenderer::getMesh(
+    const std::string& scenePath) {
+  auto it = meshes.find(scenePath);
+  if (it != meshes.end()) {
+    return it->second;
+  }
+
+  auto mesh = std::make_shared<Mesh>();
+  if (!loadMesh(scenePath, *mesh)) {
+    return nullptr;
+  }
+  meshes[scenePath] = mesh;
+  return mesh;
+}
+
+bool PathTraceRenderer::setShapeTransforms(
+    const std::string& scenePath,
+    const std::vector<VkTransformMatrixKHR>& transforms) {
+  std::shared_ptr<const Mesh> mesh = getMesh(scenePath);
+  if (!mesh) {
+    return false;
+  }
+  if (transforms.size() != mesh->shapes.size()) {
+    DEBUG_WARNING("\"" + scenePath + "\" has " +
+                  std::to_string(mesh->shapes.size()) + " shapes, got " +
+                  std::to_string(transforms.size()) + " transforms");
+    return false;
+  }
+
+  // Render waits for its last dispatch, so no dispatch reads the TLAS here.
+  // The refit keeps the TLAS handle, so the descriptor set stays valid.
+  const SceneResources& scene = getScene(scenePath, *mesh);
+  scene.rtBuilder->updateTlasTransforms(transforms);
+  return true;
+}
+
+const PathTraceRenderer::SceneResources& PathTraceRenderer::getScene(
+    const std::string& scenePath, const Mesh& mesh) {
+  auto it = scenes.find(mesh.contentHash);
+  if (it != scenes.end()) {
+    return it->second;
+  }
+
+  SceneResources& scene = scenes[mesh.contentHash];
+
+  const VkBufferUsageFlags inputUsage =
+      VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+      VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+
+  VkBufferCreateInfo vertBufCI{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = mesh.vertices.size_bytes(),
+      .usage = inputUsage,
+  };
+
+  VkBufferCreateInfo indBufCI{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = mesh.indices.size_bytes(),
+      .usage = inputUsage,
+  };
+
+  // Index range and material of every shape, looked up by pt.comp through
+  // the instance custom index
+  VkBufferCreateInfo shapeBufCI{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = mesh.shapes.size_bytes(),
+      .usage =
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+  };
+
+  VkBufferCreateInfo materialBufCI{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = mesh.materials.size() * sizeof(MeshMaterial),
+      .usage =
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+  };
+
+  // The Lights buffer of pt_common.glsl: the light count and total area,
+  // followed by the alias table
+  const LightTable lightTable = buildLightTable(mesh);
+  const uint32_t lightCount =
+      static_cast<uint32_t>(lightTable.triangles.size());
+  std::vector<uint8_t> lightData(2 * sizeof(uint32_t) +
+                                 lightCount * sizeof(LightTriangle));
+  std::memcpy(lightData.data(), &lightCount, sizeof(uint32_t));
+  std::memcpy(lightData.data() + sizeof(uint32_t), &lightTable.totalArea,
+              sizeof(float));
+  std::memcpy(lightData.data() + 2 * sizeof(uint32_t),
+              lightTable.triangles.data(), lightCount * sizeof(LightTriangle));
+  VkBufferCreateInfo lightBufCI{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = lightData.size(),
+      .usage =
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+  };
+
+  // Device local and filled through the staging ring on the transfer queue.
+  // The copies are not waited on: the BLAS builds and dispatches are queued
+  // behind them on the device, and the host builds its BLAS from the mesh.
+  device->createBuffer(&scene.vertexBuffer, vertBufCI,
+                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  device->createBuffer(&scene.indexBuffer, indBufCI,
+                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  device->createBuffer(&scene.shapeBuffer, shapeBufCI,
+                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  device->createBuffer(&scene.materialBuffer, materialBufCI,
+                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  device->createBuffer(&scene.lightBuffer, lightBufCI,
+                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  StagingUploader& uploader = device->getUploader();
+  uploader.upload(scene.vertexBuffer, mesh.vertices.data(), vertBufCI.size);
+  uploader.upload(scene.indexBuffer, mesh.indices.data(), indBufCI.size);
+  uploader.upload(scene.shapeBuffer, mesh.shapes.data(), shapeBufCI.size);
+  uploader.upload(scene.materialBuffer, mesh.materials.data(),
+                  materialBufCI.size);
+  uploader.upload(scene.lightBuffer, lightData.data(), lightBufCI.size);
+  uploader.flush();
+
+  // One BLAS per shape over the shared vertex buffer, so shapes can be built
+  // in parallel batches and later reused or moved independently
+  scene.rtBuilder = new RayTraceBuilder(device, hostAccelBuilds);
+  const bool hostBuild = scene.rtBuilder->usesHostBuilds();
+
+  std::vector<RayTraceBuilder::BlasInput> blasInputs(mesh.shapes.size());
+  for (size_t i = 0; i < mesh.shapes.size(); i++) {
+    const MeshShape& shape = mesh.shapes[i];
+    VkAccelerationStructureGeometryTrianglesDataKHR triangles{
+        .sType =
+            VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR,
+        .vertexFormat = VK_FORMAT_R32G32B32_SFLOAT,
+        .vertexData{.deviceAddress = scene.vertexBuffer.deviceAddress},
+        .vertexStride = 3 * sizeof(float),
+        .maxVertex = static_cast<uint32_t>(mesh.vertices.size() / 3 - 1),
+        .indexType = VK_INDEX_TYPE_UINT32,
+        // Point at the shape's indices directly instead of using
+        // primitiveOffset, which is limited to 32 bits of bytes
+        .indexData{.deviceAddress = scene.indexBuffer.deviceAddress +
+                                    VkDeviceAddress(shape.firstIndex) *
+                                        sizeof(uint32_t)},
+        .transformData{.deviceAddress = 0},  // No transform
+    };
+    if (hostBuild) {
+      // Host builds read the mesh where it was loaded
+      triangles.vertexData.hostAddress = mesh.vertices.data();
+      triangles.indexData.hostAddress = mesh.indices.data() + shape.firstIndex;
+      triangles.transformData.hostAddress = nullptr;
+    }
+
+    VkAccelerationStructureGeometryKHR geometry{
+        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR,
+        .geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR,
+        .geometry{
+            .triangles = triangles,
+        },
+        .flags = VK_GEOMETRY_OPAQUE_BIT_KHR,
+    };
+    blasInputs[i].asGeometry.push_back(geometry);
+
+    VkAccelerationStructureBuildRangeInfoKHR offsetInfo{
+        .primitiveCount = shape.indexCount / 3,
+        .primitiveOffset = 0,
+        .firstVertex = 0,
+        .transformOffset = 0,
+    };
+    blasInputs[i].asBuildRangeInfo.push_back(offsetInfo);
+  }
+
+  // Builds Static BLAS, compacted since they are never rebuilt. They are
+  // serialized next to the scene after the first build, later runs on the
+  // same driver only upload them.
+  const VkBuildAccelerationStructureFlagsKHR blasFlags =
+      VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR |
+      VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
+  if (!scene.rtBuilder->loadBlas(scenePath, mesh.contentHash, blasFlags,
+                                 static_cast<uint32_t>(blasInputs.size()))) {
+    scene.rtBuilder->buildBlas(blasInputs, blasFlags);
+    if (!scene.rtBuilder->saveBlas(scenePath, mesh.contentHash, blasFlags)) {
+      DEBUG_WARNING("Could not write acceleration structure cache for \"" +
+                    scenePath + "\"");
+    }
+  }
+
+  std::vector<VkAccelerationStructureInstanceKHR> instances(
+      mesh.shapes.size());
+  for (size_t i = 0; i < mesh.shapes.size(); i++) {
+    VkAccelerationStructureInstanceKHR& instance = instances[i];
+    instance.accelerationStructureReference =
+        scene.rtBuilder->getBlasDeviceAddress(static_cast<uint32_t>(i));
+    // Set the instance transform to the identity matrix:
+    instance.transform.matrix[0][0] = instance.transform.matrix[1][1] =
+        instance.transform.matrix[2][2] = 1.0f;
+    // Selects the shape's entry in the shape buffer
+    instance.instanceCustomIndex = static_cast<uint32_t>(i);
+    instance.instanceShaderBindingTableRecordOffset = 0;
+    instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+    instance.mask = 0xFF;
+  }
+
+  scene.rtBuilder->buildTlas(
+      instances, VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR,
+      false);
+
+  DEBUG_LOG("Built acceleration structures for " +
+            std::to_string(mesh.getTriangleCount()) + " triangles in " +
+            std::to_string(mesh.shapes.size()) + " shapes, " +
+            std::to_string(lightCount) + " emissive\n");
+  return scene;
+}
+
+bool PathTraceRenderer::setKernelShape(const KernelShape& shape) {
+  if (!kernels->isSupported(shape)) {
+    return false;
+  }
+  kernelShape = shape;
+  return true;
+}
+
+bool PathTraceRenderer::isSupported(const KernelShape& shape) const {
+  return kernels->isSupported(shape);
+}
+
+void PathTraceRenderer::reserveTargets(uint32_t width, uint32_t height) {
+  const VkDeviceSize pixelCount = VkDeviceSize(width) * height;
+  if (pixelCount <= targetPixelCapacity) {
+    return;
+  }
+
+  if (targetPixelCapacity > 0) {
+    // The previous job's dispatches have all been waited on, its image may
+    // still be copied out
+    waitForReadbacks();
+    device->destroy(&imageBuffer);
+    device->destroy(&accumulationBuffer);
+  }
+
+  VkBufferCreateInfo bufferInfo{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = pixelCount * 3 * sizeof(float),
+      .usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+               VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+  };
+  // Written by every dispatch, so it lives in device memory and only the
+  // finished image is copied to a readback slot
+  device->createBuffer(&imageBuffer, bufferInfo,
+                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  // Running per-pixel sum (rgb) and sample count (w), only copied out by
+  // renderSampleRange
+  VkBufferCreateInfo accumulationBufferInfo{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = pixelCount * 4 * sizeof(float),
+      .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+               VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+  };
+  device->createBuffer(&accumulationBuffer, accumulationBufferInfo,
+                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  targetPixelCapacity = pixelCount;
+  targetsChanged = true;
+}
+
+void PathTraceRenderer::reserveWavefrontQueues(uint32_t width,
+                                               uint32_t height) {
+  const VkDeviceSize pixelCount = VkDeviceSize(width) * height;
+  if (pixelCount <= wavefrontPixelCapacity) {
+    return;
+  }
+
+  if (wavefrontPixelCapacity > 0) {
+    // The previous job's dispatches have all been waited on
+    device->destroy(&wavefrontRays);
+    device->destroy(&wavefrontHits);
+    device->destroy(&wavefrontCounters);
+  }
+
+  // Every pixel has at most one path in flight, so each queue holds one
+  // entry per pixel. There are two ray queues, one read while the shade
+  // kernel fills the other.
+  VkBufferCreateInfo raysCI{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = 2 * pixelCount * WavefrontRaySize,
+      .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+  };
+  device->createBuffer(&wavefrontRays, raysCI,
+                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  VkBufferCreateInfo hitsCI{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = pixelCount * WavefrontHitSize,
+      .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+  };
+  device->createBuffer(&wavefrontHits, hitsCI,
+                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  // Reset with transfers and read by the indirect dispatches
+  VkBufferCreateInfo countersCI{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = WavefrontCounterCount * WavefrontCounterSize,
+      .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+               VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+               VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+  };
+  device->createBuffer(&wavefrontCounters, countersCI,
+                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  VkDescriptorSet set = descriptorSet->getSet(0);
+  const std::array<const Buffer*, 3> queues = {
+      &wavefrontRays, &wavefrontHits, &wavefrontCounters};
+  std::array<VkDescriptorBufferInfo, queues.size()> bufferInfos;
+  std::array<VkWriteDescriptorSet, queues.size()> writeDescriptorSets;
+  for (uint32_t i = 0; i < queues.size(); i++) {
+    bufferInfos[i] = {
+        .buffer = queues[i]->buffer,
+        .range = queues[i]->size,
+    };
+    writeDescriptorSets[i] =
+        descriptorSet->makeWrite(set, 6 + i, &bufferInfos[i]);
+  }
+  // Only called between jobs, when no dispatch is reading the set
+  vkUpdateDescriptorSets(device->operator VkDevice(),
+                         static_cast<uint32_t>(writeDescriptorSets.size()),
+                         writeDescriptorSets.data(), 0, nullptr);
+
+  wavefrontPixelCapacity = pixelCount;
+}
+
+void PathTraceRenderer::bindScene(const SceneResources& scene) {
+  if (&scene == boundScene && !targetsChanged) {
+    return;
+  }
+
+  VkDescriptorSet set = descriptorSet->getSet(0);
+  std::array<VkWriteDescriptorSet, 8> writeDescriptorSets;
+
+  VkDescriptorBufferInfo descriptorBufferInfo{
+      .buffer = imageBuffer.buffer,
+      .range = imageBuffer.size,
+  };
+  writeDescriptorSets[0] =
+      descriptorSet->makeWrite(set, 0, &descriptorBufferInfo);
+
+  VkAccelerationStructureKHR tlasCopy =
+      scene.rtBuilder->getAccelerationStructure();
+  VkWriteDescriptorSetAccelerationStructureKHR descriptorAS{
+      .sType =
+          VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR,
+      .accelerationStructureCount = 1,
+      .pAccelerationStructures = &tlasCopy,
+  };
+  writeDescriptorSets[1] = descriptorSet->makeWrite(set, 1, &descriptorAS);
+
+  VkDescriptorBufferInfo vertexDescriptorBufferInfo{
+      .buffer = scene.vertexBuffer.buffer,
+      .range = scene.vertexBuffer.size,
+  };
+  writeDescriptorSets[2] =
+      descriptorSet->makeWrite(set, 2, &vertexDescriptorBufferInfo);
+
+  VkDescriptorBufferInfo indexDescriptorBufferInfo{
+      .buffer = scene.indexBuffer.buffer,
+      .range = scene.indexBuffer.size,
+  };
+  writeDescriptorSets[3] =
+      descriptorSet->makeWrite(set, 3, &indexDescriptorBufferInfo);
+
+  VkDescriptorBufferInfo accumulationDescriptorBufferInfo{
+      .buffer = accumulationBuffer.buffer,
+      .range = accumulationBuffer.size,
+  };
+  writeDescriptorSets[4] =
+      descriptorSet->makeWrite(set, 4, &accumulationDescriptorBufferInfo);
+
+  VkDescriptorBufferInfo shapeDescriptorBufferInfo{
+      .buffer = scene.shapeBuffer.buffer,
+      .range = scene.shapeBuffer.size,
+  };
+  writeDescriptorSets[5] =
+      descriptorSet->makeWrite(set, 5, &shapeDescriptorBufferInfo);
+
+  VkDescriptorBufferInfo materialDescriptorBufferInfo{
+      .buffer = scene.materialBuffer.buffer,
+      .range = scene.materialBuffer.size,
+  };
+  writeDescriptorSets[6] =
+      descriptorSet->makeWrite(set, 12, &materialDescriptorBufferInfo);
+
+  VkDescriptorBufferInfo lightDescriptorBufferInfo{
+      .buffer = scene.lightBuffer.buffer,
+      .range = scene.lightBuffer.size,
+  };
+  writeDescriptorSets[7] =
+      descriptorSet->makeWrite(set, 13, &lightDescriptorBufferInfo);
+
+  // Only called between jobs, when no dispatch is reading the set
+  vkUpdateDescriptorSets(device->operator VkDevice(),
+                         static_cast<uint32_t>(writeDescriptorSets.size()),
+                         writeDescriptorSets.data(), 0, nullptr);
+
+  boundScene = &scene;
+  targetsChanged = false;
+}
+
+const PathTraceRenderer::SceneResources* PathTraceRenderer::prepareJob(
+    const RenderJob& job) {
+  std::shared_ptr<const Mesh> mesh = getMesh(job.scenePath);
+  if (!mesh) {
+    return nullptr;
+  }
+
+  const SceneResources& scene = getScene(job.scenePath, *mesh);
+  reserveTargets(job.params.resolution[0], job.params.resolution[1]);
+  if (job.wavefront) {
+    reserveWavefrontQueues(job.params.resolution[0],
+                           job.params.resolution[1]);
+  }
+  bindScene(scene);
+  return &scene;
+}
+
+KernelVariant PathTraceRenderer::getVariant(const RenderJob& job,
+                                            const RenderParameters& params,
+                                            const KernelShape& shape) const {
+  KernelVariant variant;
+  variant.shape = shape;
+  if (job.specializeKernel) {
+    variant.maxSegments = params.maxSegments;
+    variant.samplesPerDispatch = params.samplesPerDispatch;
+  }
+  return variant;
+}
+
+void PathTraceRenderer::cmdDispatch(VkCommandBuffer cmdBuffer,
+                                    VkPipeline pipeline,
+                                    const RenderParameters& params,
+                                    const KernelShape& shape) {
+  VkDescriptorSet ds = descriptorSet->getSet(0);
+  vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+  vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          descriptorSet->operator VkPipelineLayout(), 0, 1, &ds,
+                          0, nullptr);
+  vkCmdPushConstants(cmdBuffer, descriptorSet->operator VkPipelineLayout(),
+                     VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+
+  // Every pixel mapping covers the same grid of workgroups
+  const uint32_t renderWidth = params.resolution[0];
+  const uint32_t renderHeight = params.resolution[1];
+  vkCmdDispatch(
+      cmdBuffer,
+      (renderWidth + shape.workgroupWidth - 1) / shape.workgroupWidth,
+      (renderHeight + shape.workgroupHeight - 1) / shape.workgroupHeight, 1);
+
+  // The next dispatch reads the accumulation buffer back and the readback
+  // copies the averaged image once the loop ends
+  VkMemoryBarrier memoryBarrier{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT |
+                       VK_ACCESS_TRANSFER_READ_BIT,
+  };
+
+  vkCmdPipelineBarrier(
+      cmdBuffer,                             // The command buffer
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,  // From the compute shader
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+          VK_PIPELINE_STAGE_TRANSFER_BIT,  // To the next dispatch or the copy
+      0,                                   // No special flags
+      1, &memoryBarrier,                   // An array of memory barriers
+      0, nullptr, 0, nullptr);             // No other barriers
+}
+
+void PathTraceRenderer::cmdWavefrontDispatch(VkCommandBuffer cmdBuffer,
+                                             const RenderParameters& params) {
+  // One dimensional workgroups of as many invocations as the tuned shape.
+  // isSupported checked the invocation count, but the x limit of the device
+  // can be lower than that.
+  const VkPhysicalDeviceLimits limits =
+      device->operator VkPhysicalDeviceProperties().limits;
+  KernelVariant variant;
+  variant.shape.workgroupWidth =
+      std::min(kernelShape.workgroupWidth * kernelShape.workgroupHeight,
+               limits.maxComputeWorkGroupSize[0]);
+  variant.shape.workgroupHeight = 1;
+  auto getPipeline = [&](WavefrontStage stage) {
+    variant.wavefrontStage = stage;
+    return kernels->getPipeline(WavefrontShaderPath, variant);
+  };
+  const VkPipeline generatePipeline = getPipeline(WavefrontStage::Generate);
+  const VkPipeline extendPipeline = getPipeline(WavefrontStage::Extend);
+  const VkPipeline shadePipeline = getPipeline(WavefrontStage::Shade);
+  const VkPipeline resolvePipeline = getPipeline(WavefrontStage::Resolve);
+
+  const VkPipelineLayout layout = descriptorSet->operator VkPipelineLayout();
+  VkDescriptorSet ds = descriptorSet->getSet(0);
+  vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout,
+                          0, 1, &ds, 0, nullptr);
+  vkCmdPushConstants(cmdBuffer, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                     sizeof(params), &params);
+
+  // Every step reads what the previous one wrote, the queue counters also as
+  // indirect dispatch arguments, and the resets are transfers
+  auto barrier = [&]() {
+    VkMemoryBarrier memoryBarrier{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask =
+            VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT |
+                         VK_ACCESS_SHADER_WRITE_BIT |
+                         VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+                         VK_ACCESS_TRANSFER_READ_BIT |
+                         VK_ACCESS_TRANSFER_WRITE_BIT,
+    };
+    vkCmdPipelineBarrier(
+        cmdBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+  };
+  // Empties a queue: zero entries and zero workgroups in x
+  auto resetQueue = [&](uint32_t queue) {
+    vkCmdFillBuffer(cmdBuffer, wavefrontCounters.buffer,
+                    queue * WavefrontCounterSize, 2 * sizeof(uint32_t), 0);
+  };
+  auto pushStep = [&](uint32_t segment, uint32_t queue, uint32_t sample) {
+    WavefrontParameters step{segment, queue, sample};
+    vkCmdPushConstants(cmdBuffer, layout, VK_SHADER_STAGE_COMPUTE_BIT,
+                       sizeof(params), sizeof(step), &step);
+  };
+
+  // The y and z workgroup counts of every queue stay 1
+  std::array<uint32_t, WavefrontCounterCount * 4> counters{};
+  for (uint32_t queue = 0; queue < WavefrontCounterCount; queue++) {
+    counters[queue * 4 + 2] = counters[queue * 4 + 3] = 1;
+  }
+  vkCmdUpdateBuffer(cmdBuffer, wavefrontCounters.buffer, 0,
+                    sizeof(counters), counters.data());
+
+  const uint32_t groupSize = variant.shape.workgroupWidth;
+  const VkDeviceSize pixelCount =
+      VkDeviceSize(params.resolution[0]) * params.resolution[1];
+  const uint32_t pixelGroups =
+      static_cast<uint32_t>((pixelCount + groupSize - 1) / groupSize);
+  auto indirectOffset = [](uint32_t queue) {
+    return queue * WavefrontCounterSize + sizeof(uint32_t);
+  };
+
+  for (uint32_t sample = 0; sample < params.samplesPerDispatch; sample++) {
+    // The update above already emptied the queues for the first sample, a
+    // fill of the same words before the barrier would race with it
+    if (sample > 0) {
+      resetQueue(0);
+    }
+    barrier();
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      generatePipeline);
+    pushStep(0, 0, sample);
+    vkCmdDispatch(cmdBuffer, pixelGroups, 1, 1);
+    barrier();
+
+    // The host doesn't know when every path has ended, so it records every
+    // segment. Once the queues run dry the indirect dispatches are empty.
+    for (uint32_t segment = 0; segment < params.maxSegments; segment++) {
+      const uint32_t queue = segment % 2;
+      resetQueue(1 - queue);
+      resetQueue(WavefrontHitQueue);
+      barrier();
+
+      vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                        extendPipeline);
+      pushStep(segment, queue, sample);
+      vkCmdDispatchIndirect(cmdBuffer, wavefrontCounters.buffer,
+                            indirectOffset(queue));
+      barrier();
+
+      vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                        shadePipeline);
+      vkCmdDispatchIndirect(cmdBuffer, wavefrontCounters.buffer,
+                            indirectOffset(WavefrontHitQueue));
+      barrier();
+    }
+  }
+
+  // The last barrier also makes the image readable by the readback copy
+  vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    resolvePipeline);
+  vkCmdDispatch(cmdBuffer, pixelGroups, 1, 1);
+  barrier();
+}
+
+void PathTraceRenderer::queueReadback(const RenderJob& job,
+                                      uint32_t accumulatedSamples,
+                                      ImageCallback onImage) {
+  // Slots are used in turn, so images reach their callbacks in job order
+  const uint32_t slotIndex = nextReadbackSlot;
+  nextReadbackSlot = (nextReadbackSlot + 1) % std::size(readbackSlots);
+  ReadbackSlot& slot = readbackSlots[slotIndex];
+  {
+    std::unique_lock<std::mutex> lock(readbackMutex);
+    readbackChanged.wait(lock, [&] { return !slot.busy; });
+    slot.busy = true;
+  }
+
+  // The image buffer may be larger than this job, only copy its pixels
+  const VkDeviceSize imageSize = VkDeviceSize(job.params.resolution[0]) *
+                                 job.params.resolution[1] * 3 * sizeof(float);
+  if (imageSize > slot.capacity) {
+    if (slot.capacity > 0) {
+      device->destroy(&slot.staging);
+    }
+    VkBufferCreateInfo stagingCI{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = imageSize,
+        .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    };
+    device->createBuffer(&slot.staging, stagingCI,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                             VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                         VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT |
+                             VMA_ALLOCATION_CREATE_MAPPED_BIT,
+                         true);
+    slot.capacity = imageSize;
+  }
+
+  // The last dispatch's barrier already makes the image readable by
+  // transfers
+  slot.cmd = device->createCommandBuffer();
+  VkBufferCopy region{.srcOffset = 0, .dstOffset = 0, .size = imageSize};
+  vkCmdCopyBuffer(slot.cmd, imageBuffer.buffer, slot.staging.buffer, 1,
+                  &region);
+
+  // The host reads the copy once the fence signaled, and the next job's
+  // dispatches must not overwrite the image before it was read
+  VkMemoryBarrier hostBarrier{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+  };
+  vkCmdPipelineBarrier(slot.cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0,
+                       nullptr, 0, nullptr);
+  vkCmdPipelineBarrier(slot.cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 0, nullptr);
+  VK_CHECK_RESULT(vkEndCommandBuffer(slot.cmd));
+  device->submitCommandBuffer(slot.cmd, slot.fence);
+
+  {
+    std::lock_guard<std::mutex> lock(readbackMutex);
+    readbackTasks.push_back(
+        {slotIndex, job, accumulatedSamples, std::move(onImage)});
+  }
+  readbackChanged.notify_all();
+}
+
+void PathTraceRenderer::readbackLoop() {
+  for (;;) {
+    ReadbackTask task;
+    {
+      std::unique_lock<std::mutex> lock(readbackMutex);
+      readbackChanged.wait(
+          lock, [&] { return stopReadbacks || !readbackTasks.empty(); });
+      if (readbackTasks.empty()) {
+        return;
+      }
+      task = std::move(readbackTasks.front());
+      readbackTasks.pop_front();
+    }
+
+    ReadbackSlot& slot = readbackSlots[task.slot];
+    VK_CHECK_RESULT(vkWaitForFences(device->operator VkDevice(), 1,
+                                    &slot.fence, VK_TRUE, UINT64_MAX));
+    VK_CHECK_RESULT(
+        vkResetFences(device->operator VkDevice(), 1, &slot.fence));
+    device->freeCommandBuffer(slot.cmd);
+
+    // Host cached memory need not be coherent
+    const VkDeviceSize imageSize =
+        VkDeviceSize(task.job.params.resolution[0]) *
+        task.job.params.resolution[1] * 3 * sizeof(float);
+    VK_CHECK_RESULT(vmaInvalidateAllocation(device->operator VmaAllocator(),
+                                            slot.staging.alloc, 0, imageSize));
+    task.onImage(task.job, static_cast<const float*>(slot.staging.mappedData),
+                 task.accumulatedSamples);
+
+    {
+      std::lock_guard<std::mutex> lock(readbackMutex);
+      slot.busy = false;
+    }
+    readbackChanged.notify_all();
+  }
+}
+
+void PathTraceRenderer::waitForReadbacks() {
+  std::unique_lock<std::mutex> lock(readbackMutex);
+  readbackChanged.wait(lock, [&] {
+    return readbackTasks.empty() &&
+           std::none_of(std::begin(readbackSlots), std::end(readbackSlots),
+                        [](const ReadbackSlot& slot) { return slot.busy; });
+  });
+}
+
+uint32_t PathTraceRenderer::render(const RenderJob& job,
+                                   std::vector<float>& imageData,
+                                   const std::string& shaderPath) {
+  const uint32_t accumulatedSamples = renderAsync(
+      job,
+      [&](const RenderJob& finished, const float* rgb, uint32_t) {
+        imageData.assign(rgb, rgb + size_t(finished.params.resolution[0]) *
+                                        finished.params.resolution[1] * 3);
+      },
+      shaderPath);
+  waitForReadbacks();
+  return accumulatedSamples;
+}
+
+uint32_t PathTraceRenderer::renderAsync(const RenderJob& job,
+                                        ImageCallback onImage,
+                                        const std::string& shaderPath) {
+  // Nothing would be accumulated, and the readback would copy whatever the
+  // image buffer held before
+  if (job.firstSample >= job.getLastSample()) {
+    DEBUG_WARNING("\"" + job.scenePath + "\": the job traces no samples");
+    return 0;
+  }
+  if (!prepareJob(job)) {
+    return 0;
+  }
+
+  RenderParameters renderParams = job.params;
+  renderParams.log2SamplesPerPixel = getLog2SampleCount(job.targetSamples);
+  renderParams.firstSample = job.firstSample;
+  const uint32_t lastSample = job.getLastSample();
+  const uint32_t samplesPerDispatch =
+      std::max(1u, job.params.samplesPerDispatch);
+
+  // Progressive rendering: every submission traces a few samples per pixel
+  // and adds them to the accumulation buffer, which keeps each submission
+  // short and lets the render stop at a sample target or time budget.
+  auto renderStart = std::chrono::steady_clock::now();
+  uint32_t accumulatedSamples = 0;
+  lastStatistics = {};
+  while (job.firstSample + accumulatedSamples < lastSample) {
+    renderParams.sampleOffset = job.firstSample + accumulatedSamples;
+    renderParams.samplesPerDispatch = std::min(
+        samplesPerDispatch, lastSample - renderParams.sampleOffset);
+
+    VkCommandBuffer cmdBuffer = device->createCommandBuffer();
+    vkCmdFillBuffer(cmdBuffer, statisticsBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+    VkMemoryBarrier resetBarrier{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask =
+            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+    };
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &resetBarrier, 0, nullptr, 0, nullptr);
+
+    if (job.wavefront) {
+      cmdWavefrontDispatch(cmdBuffer, renderParams);
+    } else {
+      // Bake the loop bounds of this dispatch into the kernel. A job with a
+      // partial last dispatch compiles one more variant for it, every later
+      // job with the same settings reuses both.
+      VkPipeline computePipeline = kernels->getPipeline(
+          shaderPath, getVariant(job, renderParams, kernelShape));
+      cmdDispatch(cmdBuffer, computePipeline, renderParams, kernelShape);
+    }
+
+    // The host reads the ray counts once the submission completed
+    VkMemoryBarrier statisticsBarrier{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+    };
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &statisticsBarrier,
+                         0, nullptr, 0, nullptr);
+    device->submitAndWait(cmdBuffer);
+
+    VK_CHECK_RESULT(vmaInvalidateAllocation(device->operator VmaAllocator(),
+                                            statisticsBuffer.alloc, 0,
+                                            VK_WHOLE_SIZE));
+    const uint32_t* statisticWords =
+        static_cast<const uint32_t*>(statisticsBuffer.mappedData);
+    lastStatistics.segments +=
+        statisticWords[0] | (uint64_t(statisticWords[1]) << 32);
+    lastStatistics.shadowRays +=
+        statisticWords[2] | (uint64_t(statisticWords[3]) << 32);
+    lastStatistics.paths += uint64_t(renderParams.resolution[0]) *
+                            renderParams.resolution[1] *
+                            renderParams.samplesPerDispatch;
+    accumulatedSamples += renderParams.samplesPerDispatch;
+
+    double elapsedSeconds = std::chrono::duration<double>(
+                                std::chrono::steady_clock::now() - renderStart)
+                                .count();
+    if (job.timeBudgetSeconds > 0.0 &&
+        elapsedSeconds >= job.timeBudgetSeconds) {
+      break;
+    }
+  }
+
+  if (onImage) {
+    queueReadback(job, accumulatedSamples, std::move(onImage));
+  }
+  return accumulatedSamples;
+}
+
+uint32_t PathTraceRenderer::renderSampleRange(const RenderJob& job,
+                                              PartialAccumulation& partial,
+                                              const std::string& shaderPath) {
+  const uint32_t accumulatedSamples = renderAsync(job, {}, shaderPath);
+  if (accumulatedSamples == 0) {
+    return 0;
+  }
+
+  // The render waited for its dispatches, and the last one's barrier makes
+  // the accumulation readable by transfers
+  const uint32_t width = job.params.resolution[0];
+  const uint32_t height = job.params.resolution[1];
+  VkBufferCreateInfo stagingCI{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = VkDeviceSize(width) * height * 4 * sizeof(float),
+      .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+  };
+  Buffer staging{};
+  device->createBuffer(&staging, stagingCI,
+                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                           VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                       VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT |
+                           VMA_ALLOCATION_CREATE_MAPPED_BIT,
+                       true);
+
+  VkCommandBuffer cmdBuffer = device->createCommandBuffer();
+  VkBufferCopy region{.srcOffset = 0, .dstOffset = 0, .size = stagingCI.size};
+  vkCmdCopyBuffer(cmdBuffer, accumulationBuffer.buffer, staging.buffer, 1,
+                  &region);
+  VkMemoryBarrier hostBarrier{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+  };
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0,
+                       nullptr, 0, nullptr);
+  device->submitAndWait(cmdBuffer);
+
+  VK_CHECK_RESULT(vmaInvalidateAllocation(device->operator VmaAllocator(),
+                                          staging.alloc, 0, VK_WHOLE_SIZE));
+  partial.assign(width, height, job.firstSample,
+                 job.firstSample + accumulatedSamples,
+                 static_cast<const float*>(staging.mappedData));
+  device->destroy(&staging);
+  return accumulatedSamples;
+}
+
+double PathTraceRenderer::timeKernel(const RenderJob& job,
+                                     const KernelShape& shape,
+                                     uint32_t dispatchCount,
+                                     const std::string& shaderPath) {
+  if (!prepareJob(job) || !kernels->isSupported(shape)) {
+    return -1.0;
+  }
+
+  RenderParameters params = job.params;
+  params.samplesPerDispatch = std::max(1u, params.samplesPerDispatch);
+  params.sampleOffset = 0;
+  params.log2SamplesPerPixel = getLog2SampleCount(job.targetSamples);
+  VkPipeline pipeline =
+      kernels->getPipeline(shaderPath, getVariant(job, params, shape));
+
+  // Untimed warm-up, so lazy driver work and cold caches don't count
+  VkCommandBuffer cmdBuffer = device->createCommandBuffer();
+  cmdDispatch(cmdBuffer, pipeline, params, shape);
+  device->submitAndWait(cmdBuffer);
+
+  const uint32_t timestampBits = device->getTimestampValidBits();
+  VkQueryPool queryPool = VK_NULL_HANDLE;
+  if (timestampBits > 0) {
+    VkQueryPoolCreateInfo queryPoolCI{
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = 2,
+    };
+    VK_CHECK_RESULT(vkCreateQueryPool(device->operator VkDevice(),
+                                      &queryPoolCI, nullptr, &queryPool));
+  }
+
+  cmdBuffer = device->createCommandBuffer();
+  if (queryPool != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(cmdBuffer, queryPool, 0, 2);
+    vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        queryPool, 0);
+  }
+  for (uint32_t i = 0; i < dispatchCount; i++) {
+    params.sampleOffset = (i + 1) * params.samplesPerDispatch;
+    cmdDispatch(cmdBuffer, pipeline, params, shape);
+  }
+  if (queryPool != VK_NULL_HANDLE) {
+    vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        queryPool, 1);
+  }
+  auto submitStart = std::chrono::steady_clock::now();
+  device->submitAndWait(cmdBuffer);
+  double milliseconds = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - submitStart)
+                            .count();
+
+  if (queryPool != VK_NULL_HANDLE) {
+    std::array<uint64_t, 2> timestamps;
+    VK_CHECK_RESULT(vkGetQueryPoolResults(
+        device->operator VkDevice(), queryPool, 0, 2, sizeof(timestamps),
+        timestamps.data(), sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+    vkDestroyQueryPool(device->operator VkDevice(), queryPool, nullptr);
+
+    // Timestamps wrap at timestampBits, their ticks last timestampPeriod ns
+    const uint64_t mask =
+        timestampBits >= 64 ? ~0ull : (1ull << timestampBits) - 1;
+    const uint64_t ticks = (timestamps[1] - timestamps[0]) & mask;
+    milliseconds =
+        double(ticks) *
+        device->operator VkPhysicalDeviceProperties().limits.timestampPeriod *
+        1e-6;
+  }
+  return milliseconds / std::max(1u, dispatchCount);
+}
+}  // namespace core_internal::rendering::raytracing
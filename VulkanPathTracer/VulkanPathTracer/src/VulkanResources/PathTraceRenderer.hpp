@@ -0,0 +1,220 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../Core/Rendering/Mesh.hpp"
+#include "../Core/Rendering/PartialAccumulation.hpp"
+#include "../Core/Rendering/RenderJob.hpp"
+#include "../Core/Vulkan/VulkanDescriptorSet.hpp"
+#include "../Core/Vulkan/VulkanDevice.h"
+#include "KernelVariants.hpp"
+#include "RayTraceHelper.hpp"
+
+namespace core_internal::rendering::raytracing {
+// Renders RenderJobs with pt.comp or the wavefront kernels while keeping
+// everything that does not depend on the view alive between jobs. Meshes are
+// cached by path, their buffers and acceleration structures by mesh content,
+// and compute pipelines by SPIR-V content and kernel variant, so a batch only
+// pays setup once per distinct input.
+class PathTraceRenderer {
+ public:
+  // Path lengths of a render, for judging how much Russian roulette and the
+  // segment cap save
+  struct PathStatistics {
+    uint64_t paths = 0;     // One per sample of every pixel
+    uint64_t segments = 0;  // Camera and bounce rays traced over all paths
+    // Shadow rays of light sampling, traced on top of the segments
+    uint64_t shadowRays = 0;
+    double getAverageLength() const {
+      return paths > 0 ? double(segments) / double(paths) : 0.0;
+    }
+    double getShadowRaysPerPath() const {
+      return paths > 0 ? double(shadowRays) / double(paths) : 0.0;
+    }
+  };
+
+  // Receives a finished image on the readback thread: resolution[0] *
+  // resolution[1] averaged RGB pixels, valid until the callback returns
+  using ImageCallback = std::function<void(
+      const RenderJob& job, const float* rgb, uint32_t accumulatedSamples)>;
+
+ private:
+  struct SceneResources {
+    Buffer vertexBuffer{};
+    Buffer indexBuffer{};
+    Buffer shapeBuffer{};
+    Buffer materialBuffer{};
+    // Emissive triangles and their alias table, see LightTable
+    Buffer lightBuffer{};
+    RayTraceBuilder* rtBuilder = nullptr;
+  };
+
+  VulkanDevice* device;
+  bool hostAccelBuilds;
+  VulkanDescriptorSet* descriptorSet;
+  KernelVariantRegistry* kernels;
+
+  // Output image and accumulation buffers, grown to the largest job so far.
+  // Both are device local, finished images are copied to a readback slot.
+  Buffer imageBuffer{};
+  Buffer accumulationBuffer{};
+  VkDeviceSize targetPixelCapacity = 0;
+
+  // Ray, hit and counter queues of the wavefront kernels, allocated by the
+  // first wavefront job and grown with it
+  Buffer wavefrontRays{};
+  Buffer wavefrontHits{};
+  Buffer wavefrontCounters{};
+  VkDeviceSize wavefrontPixelCapacity = 0;
+
+  // Traced segment and shadow ray counters the kernels add to, reset and
+  // read back around every dispatch. Two words each, low then high, as a
+  // dispatch of many samples over a large image can trace more than 2^32
+  // rays.
+  Buffer statisticsBuffer{};
+  PathStatistics lastStatistics;
+
+  // Sobol generator matrices of the samplers, see makeSobolMatrices
+  Buffer sobolMatrixBuffer{};
+
+  // Two host readback buffers, so one job's image can be copied while the
+  // previous one is still handed to its callback
+  struct ReadbackSlot {
+    Buffer staging{};
+    VkDeviceSize capacity = 0;
+    VkFence fence = VK_NULL_HANDLE;
+    VkCommandBuffer cmd = VK_NULL_HANDLE;
+    bool busy = false;  // Guarded by readbackMutex
+  };
+  struct ReadbackTask {
+    uint32_t slot = 0;
+    RenderJob job;
+    uint32_t accumulatedSamples = 0;
+    ImageCallback onImage;
+  };
+  ReadbackSlot readbackSlots[2];
+  uint32_t nextReadbackSlot = 0;
+  // Waits for the copies and runs the callbacks in submission order
+  std::thread readbackThread;
+  std::mutex readbackMutex;
+  std::condition_variable readbackChanged;
+  std::deque<ReadbackTask> readbackTasks;
+  bool stopReadbacks = false;
+
+  std::unordered_map<std::string, std::shared_ptr<const Mesh>> meshes;
+  std::unordered_map<uint64_t, SceneResources> scenes;
+  // Dispatch shape every render is specialized for
+  KernelShape kernelShape;
+
+  // What the descriptor set currently points at
+  const SceneResources* boundScene = nullptr;
+  bool targetsChanged = true;
+
+  // Scenes are cached by mesh content, scenePath locates the on-disk
+  // acceleration structure cache
+  const SceneResources& getScene(const std::string& scenePath,
+                                 const Mesh& mesh);
+  void reserveTargets(uint32_t width, uint32_t height);
+  // Grows the wavefront queues and points bindings 6-8 at them
+  void reserveWavefrontQueues(uint32_t width, uint32_t height);
+  // Records the copy of the finished image to a free readback slot, submits
+  // it and queues the callback. Waits while both slots are in use.
+  void queueReadback(const RenderJob& job, uint32_t accumulatedSamples,
+                     ImageCallback onImage);
+  void readbackLoop();
+  void bindScene(const SceneResources& scene);
+  // Loads the job's scene and binds it with large enough targets. Returns
+  // nullptr if the scene can't be loaded.
+  const SceneResources* prepareJob(const RenderJob& job);
+  KernelVariant getVariant(const RenderJob& job,
+                           const RenderParameters& params,
+                           const KernelShape& shape) const;
+  // Records one dispatch of params followed by the accumulation barrier
+  void cmdDispatch(VkCommandBuffer cmdBuffer, VkPipeline pipeline,
+                   const RenderParameters& params, const KernelShape& shape);
+  // Records the wavefront kernels tracing the samples of params, with
+  // workgroups of as many invocations as the kernel shape, fewer if the
+  // device's maxComputeWorkGroupSize[0] is lower
+  void cmdWavefrontDispatch(VkCommandBuffer cmdBuffer,
+                            const RenderParameters& params);
+
+ public:
+  // hostAccelBuilds builds the BLAS on host threads where the device
+  // supports it, see RayTraceBuilder
+  explicit PathTraceRenderer(VulkanDevice* device,
+                             bool hostAccelBuilds = false);
+  ~PathTraceRenderer();
+
+  // Returns the cached mesh for a scene file, loading it on first use.
+  // Returns nullptr if the file can't be loaded.
+  std::shared_ptr<const Mesh> getMesh(const std::string& scenePath);
+
+  // Moves the shapes of a scene, one object to world transform per shape,
+  // by refitting its TLAS rather than rebuilding it. Scenes with identical
+  // content share acceleration structures and so also share the transforms.
+  // Light sampling still picks points where the mesh put the emissive
+  // triangles, so shapes with emissive materials should not be moved.
+  // Returns false if the scene can't be loaded or the count doesn't match.
+  bool setShapeTransforms(const std::string& scenePath,
+                          const std::vector<VkTransformMatrixKHR>& transforms);
+
+  // Changes the dispatch shape of later renders. Returns false and keeps the
+  // current shape if the device can't run it.
+  bool setKernelShape(const KernelShape& shape);
+  const KernelShape& getKernelShape() const { return kernelShape; }
+  bool isSupported(const KernelShape& shape) const;
+
+  static constexpr const char* WavefrontShaderPath =
+      "shaders/wavefront.comp.spv";
+
+  // Renders the job progressively and copies the averaged RGB image to
+  // imageData. Returns the number of samples accumulated per pixel, 0 if the
+  // scene could not be loaded or the job's sample range is empty, in which
+  // case imageData is left as it was. shaderPath is the megakernel, wavefront jobs
+  // always run WavefrontShaderPath. Both are relative to the working
+  // directory, where the build compiles them to.
+  uint32_t render(const RenderJob& job, std::vector<float>& imageData,
+                  const std::string& shaderPath = "shaders/pt.comp.spv");
+  // Renders the job like render() but returns once its last dispatch is
+  // done, without waiting for the image. onImage runs on the readback thread
+  // once the image reached the host, so encoding and writing it overlaps
+  // with the next job. Returns the number of samples accumulated per pixel,
+  // 0 if the scene could not be loaded or the job's sample range is empty,
+  // in which case onImage is not called.
+  // An empty onImage skips the readback.
+  uint32_t renderAsync(const RenderJob& job, ImageCallback onImage,
+                       const std::string& shaderPath = "shaders/pt.comp.spv");
+  // Renders the job's share of samples like render() and copies their sums
+  // rather than the image to partial, to be merged with the other shards of
+  // the image. Returns the number of samples accumulated per pixel, fewer
+  // than the share if the time budget ran out, 0 if the scene could not be
+  // loaded or the share is empty.
+  uint32_t renderSampleRange(
+      const RenderJob& job, PartialAccumulation& partial,
+      const std::string& shaderPath = "shaders/pt.comp.spv");
+  // Returns once every queued image has been passed to its callback
+  void waitForReadbacks();
+  // Path statistics of the last render
+  const PathStatistics& getLastStatistics() const { return lastStatistics; }
+
+  // Times dispatchCount dispatches of the job's samplesPerDispatch samples
+  // with the given shape, after one untimed warm-up dispatch. Returns the
+  // time per dispatch in milliseconds, from timestamp queries or, on queues
+  // without timestamps, measured on the host around the submission. Returns
+  // a negative value if the scene can't be loaded or the shape is not
+  // supported.
+  double timeKernel(const RenderJob& job, const KernelShape& shape,
+                    uint32_t dispatchCount,
+                    const std::string& shaderPath = "shaders/pt.comp.spv");
+};
+}  // namespace core_internal::rendering::raytracing
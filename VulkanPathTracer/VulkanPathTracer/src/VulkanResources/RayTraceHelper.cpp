@@ -1,14 +1,45 @@
 #include "RayTraceHelper.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "../CpuResources/ParallelFor.hpp"
+#include "AccelCache.hpp"
 
 namespace core_internal::rendering::raytracing {
+static bool supportsHostBuilds(VulkanDevice* device) {
+  return device->operator VkPhysicalDeviceAccelerationStructureFeaturesKHR()
+             .accelerationStructureHostCommands == VK_TRUE;
+}
+
 RayTraceBuilder::RayTraceBuilder(
-    core_internal::rendering::VulkanDevice* vulkanDevice) {
-  this->vulkanDevice = vulkanDevice;
+    core_internal::rendering::VulkanDevice* vulkanDevice, bool hostBuild)
+    : vulkanDevice(vulkanDevice),
+      hostBuild(hostBuild && supportsHostBuilds(vulkanDevice)),
+      blasPool(vulkanDevice, true, this->hostBuild) {
+  if (hostBuild && !this->hostBuild) {
+    DEBUG_WARNING(
+        "accelerationStructureHostCommands is not supported, building "
+        "acceleration structures on the device");
+  }
 }
 
-RayTraceBuilder::~RayTraceBuilder() {}
+RayTraceBuilder::~RayTraceBuilder() {
+  if (tlas.accel != VK_NULL_HANDLE) {
+    vulkanDevice->getExt().pfnDestroyAccelerationStructureKHR(
+        vulkanDevice->operator VkDevice(), tlas.accel, nullptr);
+    vulkanDevice->destroy(&tlas.buf);
+  }
+  if (instanceBuffer.size > 0) {
+    vulkanDevice->destroy(&instanceBuffer);
+  }
+  if (tlasScratchBuffer.size > 0) {
+    vulkanDevice->destroy(&tlasScratchBuffer);
+  }
+}
 
 void RayTraceBuilder::buildBlas(const std::vector<BlasInput>& input,
                                 VkBuildAccelerationStructureFlagsKHR flags) {
@@ -17,93 +48,592 @@ void RayTraceBuilder::buildBlas(const std::vector<BlasInput>& input,
   VkDeviceSize maxScratchSize{0};
 
   std::vector<tools::AccelerationStructureBuildData> blasBuildData(numBlas);
-  blas.resize(numBlas);
+  // A rebuild replaces every BLAS
+  blasPool.clear();
+  blas.assign(numBlas, {});
 
   for (uint32_t i = 0; i < numBlas; i++) {
     blasBuildData[i].asType = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
     blasBuildData[i].asGeometry = input[i].asGeometry;
     blasBuildData[i].asBuildRangeInfo = input[i].asBuildRangeInfo;
 
-    auto sizeInfo = blasBuildData[i].finalizeGeometry(vulkanDevice,
-                                                      input[i].asFlags | flags);
+    auto sizeInfo = blasBuildData[i].finalizeGeometry(
+        vulkanDevice, input[i].asFlags | flags,
+        hostBuild ? VK_ACCELERATION_STRUCTURE_BUILD_TYPE_HOST_KHR
+                  : VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR);
     maxScratchSize = std::max(maxScratchSize, sizeInfo.buildScratchSize);
   }
 
+  if (hostBuild) {
+    buildBlasOnHost(blasBuildData);
+    return;
+  }
+
   VkDeviceSize hintMaxBudget{256000000};  // 256 MB
 
   bool hasCompaction =
       flags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
 
-  auto blasBuilder = new tools::BlasBuilder(vulkanDevice);
+  // With compaction the builds go to a pool of their own, which is released
+  // as a whole once every BLAS has been copied into blasPool
+  std::unique_ptr<AccelMemoryPool> buildPool;
+  if (hasCompaction) {
+    buildPool = std::make_unique<AccelMemoryPool>(vulkanDevice, false);
+  }
+  tools::BlasBuilder blasBuilder(
+      vulkanDevice, hasCompaction ? buildPool.get() : &blasPool, &blasPool);
   uint32_t minAlignment =
       vulkanDevice->
       operator VkPhysicalDeviceAccelerationStructurePropertiesKHR()
           .minAccelerationStructureScratchOffsetAlignment;
 
-  VkDeviceSize scratchSize =
-      blasBuilder->getScratchSize(hintMaxBudget, blasBuildData, minAlignment);
-
-  Buffer* blasScratchBuf = new Buffer();
+  // Two batches are in flight at once, so each gets half of the budget and
+  // its own scratch region. When every BLAS fits into the budget each one
+  // has a scratch slot of its own and a single region is shared.
+  const VkDeviceSize batchBudget = hintMaxBudget / 2;
+  const VkDeviceSize regionSize =
+      blasBuilder.getScratchSize(batchBudget, blasBuildData, minAlignment);
+  std::vector<VkDeviceAddress> scratchAddresses[2];
+  const bool sharedScratch =
+      blasBuilder
+          .calculateScratchAlignedSizes(blasBuildData, minAlignment)
+          .totalScratch < batchBudget;
 
+  Buffer blasScratchBuf{};
   VkBufferCreateInfo blasScratchBufCI{
       .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-      .size = scratchSize,
+      .size = sharedScratch ? regionSize : 2 * regionSize,
       .usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
   };
-
-  vulkanDevice->createBuffer(blasScratchBuf, blasScratchBufCI,
+  vulkanDevice->createBuffer(&blasScratchBuf, blasScratchBufCI,
                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-  std::vector<VkDeviceAddress> scratchAddresses;
-  blasBuilder->getScratchAddresses(hintMaxBudget, blasBuildData,
-                                   blasScratchBuf->deviceAddress,
-                                   scratchAddresses, minAlignment);
-
-  bool isFinished = false;
-  do {
-    {
-      VkCommandBuffer cmd = vulkanDevice->createCommandBuffer();
-      isFinished = blasBuilder->cmdCreateParallelBlas(
-          cmd, blasBuildData, blas, scratchAddresses, hintMaxBudget);
-      vkEndCommandBuffer(cmd);
-      vulkanDevice->submitCommandBuffer(cmd);
-      vulkanDevice->waitIdle();
+  for (uint32_t r = 0; r < 2; r++) {
+    VkDeviceAddress regionAddress =
+        blasScratchBuf.deviceAddress + (sharedScratch ? 0 : r * regionSize);
+    blasBuilder.getScratchAddresses(batchBudget, blasBuildData, regionAddress,
+                                    scratchAddresses[r], minAlignment);
+  }
+
+  // Batch k builds in slot k % 2. Instead of idling the device after every
+  // step, batch k is submitted before the host waits for batch k - 1, whose
+  // compacted sizes are then read back and its compaction submitted while
+  // batch k still builds. Originals are destroyed once their copy finished.
+  struct BatchSlot {
+    VkFence buildFence = VK_NULL_HANDLE;
+    VkFence compactFence = VK_NULL_HANDLE;
+    VkCommandBuffer buildCmd = VK_NULL_HANDLE;
+    VkCommandBuffer compactCmd = VK_NULL_HANDLE;
+    uint32_t firstBlas = 0;
+    uint32_t endBlas = 0;
+    std::vector<tools::AccelData> originals;
+  } slots[2];
+
+  const VkDevice device = vulkanDevice->operator VkDevice();
+  VkFenceCreateInfo fenceCI{.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+  for (auto& slot : slots) {
+    VK_CHECK_RESULT(
+        vkCreateFence(device, &fenceCI, nullptr, &slot.buildFence));
+    VK_CHECK_RESULT(
+        vkCreateFence(device, &fenceCI, nullptr, &slot.compactFence));
+  }
+
+  auto waitAndReset = [&](VkFence fence, VkCommandBuffer& cmd) {
+    if (cmd == VK_NULL_HANDLE) {
+      return;
     }
+    VK_CHECK_RESULT(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
+    VK_CHECK_RESULT(vkResetFences(device, 1, &fence));
+    vulkanDevice->freeCommandBuffer(cmd);
+    cmd = VK_NULL_HANDLE;
+  };
+  // Waits for the build of the batch in slot and submits its compaction
+  auto finishBuild = [&](BatchSlot& slot) {
+    if (slot.buildCmd == VK_NULL_HANDLE) {
+      return;
+    }
+    waitAndReset(slot.buildFence, slot.buildCmd);
     if (hasCompaction) {
-      VkCommandBuffer cmd = vulkanDevice->createCommandBuffer();
-      blasBuilder->cmdCompactBlas(cmd, blasBuildData, blas);
-      vkEndCommandBuffer(cmd);
-      vulkanDevice->submitCommandBuffer(cmd);
-      vulkanDevice->waitIdle();
-      blasBuilder->destroyNonCompactedBlas();
+      slot.compactCmd = vulkanDevice->createCommandBuffer();
+      blasBuilder.cmdCompactBlas(slot.compactCmd, blasBuildData, blas,
+                                 slot.firstBlas, slot.endBlas,
+                                 slot.originals);
+      vkEndCommandBuffer(slot.compactCmd);
+      vulkanDevice->submitCommandBuffer(slot.compactCmd, slot.compactFence);
+    }
+  };
+  auto finishCompaction = [&](BatchSlot& slot) {
+    waitAndReset(slot.compactFence, slot.compactCmd);
+    blasBuilder.destroyAccel(slot.originals);
+  };
+
+  uint32_t nextBlas = 0;
+  for (uint32_t batch = 0; nextBlas < numBlas; batch++) {
+    BatchSlot& slot = slots[batch % 2];
+    // The slot's previous batch finished building in the last iteration,
+    // its compaction still has to complete before the slot is reused
+    finishCompaction(slot);
+
+    slot.firstBlas = nextBlas;
+    slot.buildCmd = vulkanDevice->createCommandBuffer();
+    nextBlas = blasBuilder.cmdCreateParallelBlas(
+        slot.buildCmd, blasBuildData, blas, scratchAddresses[batch % 2],
+        batchBudget, nextBlas);
+    slot.endBlas = nextBlas;
+    vkEndCommandBuffer(slot.buildCmd);
+    vulkanDevice->submitCommandBuffer(slot.buildCmd, slot.buildFence);
+
+    finishBuild(slots[(batch + 1) % 2]);
+  }
+  // Drain the last batch and the compactions still in flight
+  for (auto& slot : slots) {
+    finishBuild(slot);
+  }
+  for (auto& slot : slots) {
+    finishCompaction(slot);
+    vkDestroyFence(device, slot.buildFence, nullptr);
+    vkDestroyFence(device, slot.compactFence, nullptr);
+  }
+
+  blasOriginalSize = blasBuilder.getOriginalSize();
+  DEBUG_LOG(blasBuilder.getStatistics());
+
+  // Clean up, buildPool releases its blocks on destruction
+  vulkanDevice->destroy(&blasScratchBuf);
+}
+void RayTraceBuilder::buildBlasOnHost(
+    std::vector<tools::AccelerationStructureBuildData>& buildData) {
+  const VkDevice device = vulkanDevice->operator VkDevice();
+  const tools::VulkanExtentions ext = vulkanDevice->getExt();
+  const auto numBlas = static_cast<uint32_t>(buildData.size());
+  auto buildStart = std::chrono::steady_clock::now();
+
+  // Structures are created up front, the pool is not thread safe
+  std::vector<VkDeferredOperationKHR> operations(numBlas);
+  for (uint32_t i = 0; i < numBlas; i++) {
+    blas[i] = blasPool.create(buildData[i].makeCreateInfo());
+    VK_CHECK_RESULT(
+        ext.pfnCreateDeferredOperationKHR(device, nullptr, &operations[i]));
+  }
+  blasOriginalSize = blasPool.getStats().usedBytes;
+
+  enum : uint8_t { NotStarted, Running, Finished };
+  std::vector<std::atomic<uint8_t>> states(numBlas);
+  std::vector<std::vector<uint8_t>> scratch(numBlas);
+  std::atomic<uint32_t> nextBlas{0};
+
+  // The thread finishing a build releases its scratch memory
+  auto finish = [&](uint32_t i) {
+    uint8_t running = Running;
+    if (states[i].compare_exchange_strong(running, Finished)) {
+      std::vector<uint8_t>().swap(scratch[i]);
     }
-  } while (!isFinished);
+  };
+  // Helps with the build until it is done or has no work left for this
+  // thread. Returns true once the build has finished.
+  auto join = [&](uint32_t i) {
+    for (;;) {
+      VkResult result = ext.pfnDeferredOperationJoinKHR(device, operations[i]);
+      if (result == VK_SUCCESS) {
+        finish(i);
+        return true;
+      }
+      if (result == VK_THREAD_DONE_KHR) {
+        return states[i] == Finished;
+      }
+      assert(result == VK_THREAD_IDLE_KHR);
+      std::this_thread::yield();
+    }
+  };
+
+  // Each worker starts the next BLAS and joins it. Once every build has been
+  // started, workers join the builds still running, so a few large BLAS at
+  // the end use every thread.
+  const uint32_t threadCount = cpu::resolveThreadCount(0);
+  cpu::parallelFor(threadCount, threadCount, [&](uint32_t) {
+    for (uint32_t i = nextBlas++; i < numBlas; i = nextBlas++) {
+      auto& data = buildData[i];
+      scratch[i].resize(data.sizeInfo.buildScratchSize);
+      data.buildInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+      data.buildInfo.srcAccelerationStructure = VK_NULL_HANDLE;
+      data.buildInfo.dstAccelerationStructure = blas[i].accel;
+      data.buildInfo.scratchData.hostAddress = scratch[i].data();
+      data.buildInfo.pGeometries = data.asGeometry.data();
+      const VkAccelerationStructureBuildRangeInfoKHR* pRangeInfo =
+          data.asBuildRangeInfo.data();
 
-  DEBUG_LOG(blasBuilder->getStatistics());
+      VkResult result = ext.pfnBuildAccelerationStructuresKHR(
+          device, operations[i], 1, &data.buildInfo, &pRangeInfo);
+      if (result == VK_OPERATION_DEFERRED_KHR) {
+        // Only now other workers may join it
+        states[i] = Running;
+        join(i);
+      } else {
+        // Completed on this thread, or failed
+        if (result != VK_OPERATION_NOT_DEFERRED_KHR) {
+          VK_CHECK_RESULT(result);
+        }
+        states[i] = Finished;
+        std::vector<uint8_t>().swap(scratch[i]);
+      }
+    }
+
+    bool running = true;
+    while (running) {
+      running = false;
+      for (uint32_t i = 0; i < numBlas; i++) {
+        if (states[i] == Running && !join(i)) {
+          running = true;
+        }
+      }
+      if (running) {
+        std::this_thread::yield();
+      }
+    }
+  });
 
-  // Clean up
-  vulkanDevice->destroy(blasScratchBuf);
+  for (uint32_t i = 0; i < numBlas; i++) {
+    VK_CHECK_RESULT(
+        ext.pfnGetDeferredOperationResultKHR(device, operations[i]));
+    ext.pfnDestroyDeferredOperationKHR(device, operations[i], nullptr);
+  }
+
+  double buildSeconds = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - buildStart)
+                            .count();
+  DEBUG_LOG("Built " + std::to_string(numBlas) + " BLAS on " +
+            std::to_string(threadCount) + " host threads in " +
+            std::to_string(buildSeconds) + " s\n");
 }
+
 void RayTraceBuilder::buildTlas(
     const std::vector<VkAccelerationStructureInstanceKHR>& instances,
     VkBuildAccelerationStructureFlagsKHR flags, bool update) {
-  assert(tlas.accel == VK_NULL_HANDLE || update);
-  uint32_t countInstance = static_cast<uint32_t>(instances.size());
+  flags |= VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+  // An update has to keep the instance count and flags of the source build,
+  // anything else falls back to a full rebuild
+  update = update && tlas.accel != VK_NULL_HANDLE &&
+           instances.size() == tlasInstances.size() && flags == tlasFlags;
+  tlasInstances = instances;
+  tlasFlags = flags;
+
+  const VkDeviceSize instancesSize =
+      sizeof(VkAccelerationStructureInstanceKHR) *
+      std::max<size_t>(1, instances.size());
+  if (instanceBuffer.size < instancesSize) {
+    if (instanceBuffer.size > 0) {
+      // Every build waits for completion, so the GPU no longer reads it
+      vulkanDevice->destroy(&instanceBuffer);
+    }
+    VkBufferCreateInfo bufferCI{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = instancesSize,
+        .usage =
+            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+            VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
+    };
+    // Rewritten from the host on every update
+    vulkanDevice->createBuffer(
+        &instanceBuffer, bufferCI, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+  }
+  if (!instances.empty()) {
+    vulkanDevice->copyMemoryToAlloc(
+        &instanceBuffer, (void*)instances.data(),
+        sizeof(VkAccelerationStructureInstanceKHR) * instances.size());
+  }
+
+  recordTlasBuild(update);
+}
+
+void RayTraceBuilder::updateTlasTransforms(
+    const std::vector<VkTransformMatrixKHR>& transforms) {
+  assert(tlas.accel != VK_NULL_HANDLE && "TLAS not built");
+  assert(transforms.size() == tlasInstances.size());
+  for (size_t i = 0; i < tlasInstances.size(); i++) {
+    tlasInstances[i].transform = transforms[i];
+  }
+  vulkanDevice->copyMemoryToAlloc(
+      &instanceBuffer, tlasInstances.data(),
+      sizeof(VkAccelerationStructureInstanceKHR) * tlasInstances.size());
+
+  recordTlasBuild(true);
+}
+
+VkDeviceAddress RayTraceBuilder::reserveTlasScratch(VkDeviceSize size) {
+  const VkDeviceSize alignment = std::max<VkDeviceSize>(
+      1, vulkanDevice->
+         operator VkPhysicalDeviceAccelerationStructurePropertiesKHR()
+             .minAccelerationStructureScratchOffsetAlignment);
+  // Over-allocate by the alignment so the start can be aligned up
+  if (tlasScratchBuffer.size < size + alignment) {
+    if (tlasScratchBuffer.size > 0) {
+      vulkanDevice->destroy(&tlasScratchBuffer);
+    }
+    VkBufferCreateInfo scratchCI{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size + alignment,
+        .usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+    };
+    vulkanDevice->createBuffer(&tlasScratchBuffer, scratchCI,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  }
+  return alignUp(tlasScratchBuffer.deviceAddress, alignment);
+}
+
+void RayTraceBuilder::recordTlasBuild(bool update) {
+  tools::AccelerationStructureBuildData buildData;
+  buildData.asType = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+
+  VkAccelerationStructureGeometryInstancesDataKHR instancesData{
+      .sType =
+          VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR,
+      .arrayOfPointers = VK_FALSE,
+      .data{.deviceAddress = instanceBuffer.deviceAddress},
+  };
+  VkAccelerationStructureGeometryKHR geometry{
+      .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR,
+      .geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR,
+      .geometry{
+          .instances = instancesData,
+      },
+  };
+  buildData.asGeometry.push_back(geometry);
+
+  VkAccelerationStructureBuildRangeInfoKHR rangeInfo{
+      .primitiveCount = static_cast<uint32_t>(tlasInstances.size()),
+  };
+  buildData.asBuildRangeInfo.push_back(rangeInfo);
+
+  VkAccelerationStructureBuildSizesInfoKHR sizeInfo =
+      buildData.finalizeGeometry(vulkanDevice, tlasFlags);
+
+  // Rebuilds reuse the existing TLAS whenever it is large enough
+  if (!update && tlas.buf.size < sizeInfo.accelerationStructureSize) {
+    if (tlas.accel != VK_NULL_HANDLE) {
+      vulkanDevice->getExt().pfnDestroyAccelerationStructureKHR(
+          vulkanDevice->operator VkDevice(), tlas.accel, nullptr);
+      vulkanDevice->destroy(&tlas.buf);
+    }
+    VkBufferCreateInfo tlasBufCI{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = sizeInfo.accelerationStructureSize,
+        .usage = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR |
+                 VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+    };
+    vulkanDevice->createBuffer(&tlas.buf, tlasBufCI,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    VkAccelerationStructureCreateInfoKHR createInfo =
+        buildData.makeCreateInfo();
+    createInfo.buffer = tlas.buf.buffer;
+    VK_CHECK_RESULT(vulkanDevice->getExt().pfnCreateAccelerationStructureKHR(
+        vulkanDevice->operator VkDevice(), &createInfo, nullptr,
+        &tlas.accel));
+  }
+
+  buildData.buildInfo.mode =
+      update ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR
+             : VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+  buildData.buildInfo.srcAccelerationStructure =
+      update ? tlas.accel : VK_NULL_HANDLE;
+  buildData.buildInfo.dstAccelerationStructure = tlas.accel;
+  buildData.buildInfo.scratchData.deviceAddress = reserveTlasScratch(
+      update ? sizeInfo.updateScratchSize : sizeInfo.buildScratchSize);
+
   VkCommandBuffer cmd = vulkanDevice->createCommandBuffer();
+  const VkAccelerationStructureBuildRangeInfoKHR* pRangeInfo =
+      buildData.asBuildRangeInfo.data();
+  vulkanDevice->getExt().pfnCmdBuildAccelerationStructuresKHR(
+      cmd, 1, &buildData.buildInfo, &pRangeInfo);
+
+  // The path tracer reads the TLAS from its compute shader
+  VkMemoryBarrier barrier{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
+      .dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR,
+  };
+  vkCmdPipelineBarrier(cmd,
+                       VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+
+  vulkanDevice->submitAndWait(cmd);
+}
+
+bool RayTraceBuilder::loadBlas(const std::string& sourcePath,
+                               uint64_t contentHash,
+                               VkBuildAccelerationStructureFlagsKHR flags,
+                               uint32_t blasCount) {
+  AccelCache cache;
+  if (!mapAccelCache(sourcePath, contentHash, flags, cache) ||
+      cache.entries.size() != blasCount || blasCount == 0) {
+    return false;
+  }
 
-  Buffer instancesBuffer;
+  // Every structure was serialized by the same driver, so checking the
+  // version data of the first one covers all of them
+  VkAccelerationStructureVersionInfoKHR versionInfo{
+      .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_VERSION_INFO_KHR,
+      .pVersionData = cache.data.data() + cache.entries[0].offset,
+  };
+  VkAccelerationStructureCompatibilityKHR compatibility;
+  vulkanDevice->getExt().pfnGetDeviceAccelerationStructureCompatibilityKHR(
+      vulkanDevice->operator VkDevice(), &versionInfo, &compatibility);
+  if (compatibility != VK_ACCELERATION_STRUCTURE_COMPATIBILITY_COMPATIBLE_KHR) {
+    DEBUG_LOG("Acceleration structure cache \"" +
+              getAccelCachePath(sourcePath) +
+              "\" was written by another driver, rebuilding\n");
+    return false;
+  }
 
-  VkBufferCreateInfo bufferCI{
+  // Over-allocate by the alignment so the data can start at an aligned
+  // address
+  Buffer staging{};
+  VkBufferCreateInfo stagingCI{
       .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-      .size = sizeof(VkAccelerationStructureInstanceKHR) * countInstance,
-      .usage =
-          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-          VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
+      .size = cache.data.size() + AccelCacheAlignment,
+      .usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
   };
+  vulkanDevice->createBuffer(
+      &staging, stagingCI, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+  const VkDeviceAddress dataAddress =
+      alignUp(staging.deviceAddress, AccelCacheAlignment);
+  vulkanDevice->copyMemoryToAlloc(&staging, cache.data.data(),
+                                  cache.data.size(),
+                                  dataAddress - staging.deviceAddress);
 
-  vulkanDevice->createBuffer(&instancesBuffer, bufferCI,
-                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  blasPool.clear();
+  blas.assign(blasCount, {});
+  VkCommandBuffer cmd = vulkanDevice->createCommandBuffer();
+  for (uint32_t i = 0; i < blasCount; i++) {
+    VkAccelerationStructureCreateInfoKHR createInfo{
+        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR,
+        .size = cache.getDeserializedSize(i),
+        .type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
+    };
+    blas[i] = blasPool.create(createInfo);
+
+    VkCopyMemoryToAccelerationStructureInfoKHR copyInfo{
+        .sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_ACCELERATION_STRUCTURE_INFO_KHR,
+        .src{.deviceAddress = dataAddress + cache.entries[i].offset},
+        .dst = blas[i].accel,
+        .mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_DESERIALIZE_KHR,
+    };
+    vulkanDevice->getExt().pfnCmdCopyMemoryToAccelerationStructureKHR(
+        cmd, &copyInfo);
+  }
+
+  // The TLAS build reads the BLAS
+  VkMemoryBarrier barrier{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
+      .dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR,
+  };
+  vkCmdPipelineBarrier(cmd,
+                       VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                       VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0, 1, &barrier, 0, nullptr, 0, nullptr);
+  vulkanDevice->submitAndWait(cmd);
+  vulkanDevice->destroy(&staging);
+
+  blasOriginalSize = blasPool.getStats().usedBytes;
+  return true;
+}
+
+bool RayTraceBuilder::saveBlas(const std::string& sourcePath,
+                               uint64_t contentHash,
+                               VkBuildAccelerationStructureFlagsKHR flags) {
+  if (blas.empty()) {
+    return false;
+  }
+  const VkDevice device = vulkanDevice->operator VkDevice();
+  const auto blasCount = static_cast<uint32_t>(blas.size());
+
+  std::vector<VkAccelerationStructureKHR> handles(blasCount);
+  for (uint32_t i = 0; i < blasCount; i++) {
+    handles[i] = blas[i].accel;
+  }
+
+  // Serialized sizes are only known to the device
+  VkQueryPool queryPool;
+  VkQueryPoolCreateInfo queryPoolCI{
+      .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+      .queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_SIZE_KHR,
+      .queryCount = blasCount,
+  };
+  VK_CHECK_RESULT(
+      vkCreateQueryPool(device, &queryPoolCI, nullptr, &queryPool));
+  VkCommandBuffer cmd = vulkanDevice->createCommandBuffer();
+  vkCmdResetQueryPool(cmd, queryPool, 0, blasCount);
+  vulkanDevice->getExt().pfnCmdWriteAccelerationStructuresPropertiesKHR(
+      cmd, blasCount, handles.data(),
+      VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_SIZE_KHR, queryPool,
+      0);
+  vulkanDevice->submitAndWait(cmd);
+
+  std::vector<VkDeviceSize> serializedSizes(blasCount);
+  VK_CHECK_RESULT(vkGetQueryPoolResults(
+      device, queryPool, 0, blasCount,
+      serializedSizes.size() * sizeof(VkDeviceSize), serializedSizes.data(),
+      sizeof(VkDeviceSize), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+  vkDestroyQueryPool(device, queryPool, nullptr);
+
+  std::vector<AccelCacheEntry> entries(blasCount);
+  uint64_t dataSize = 0;
+  for (uint32_t i = 0; i < blasCount; i++) {
+    entries[i].offset = alignUp(dataSize, AccelCacheAlignment);
+    entries[i].size = serializedSizes[i];
+    dataSize = entries[i].offset + entries[i].size;
+  }
+
+  Buffer readback{};
+  VkBufferCreateInfo readbackCI{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = dataSize + AccelCacheAlignment,
+      .usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+  };
+  vulkanDevice->createBuffer(&readback, readbackCI,
+                             VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                             VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT,
+                             true);
+  const VkDeviceAddress dataAddress =
+      alignUp(readback.deviceAddress, AccelCacheAlignment);
+
+  cmd = vulkanDevice->createCommandBuffer();
+  for (uint32_t i = 0; i < blasCount; i++) {
+    VkCopyAccelerationStructureToMemoryInfoKHR copyInfo{
+        .sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_TO_MEMORY_INFO_KHR,
+        .src = blas[i].accel,
+        .dst{.deviceAddress = dataAddress + entries[i].offset},
+        .mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_SERIALIZE_KHR,
+    };
+    vulkanDevice->getExt().pfnCmdCopyAccelerationStructureToMemoryKHR(
+        cmd, &copyInfo);
+  }
+  VkMemoryBarrier barrier{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+  };
+  vkCmdPipelineBarrier(cmd,
+                       VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                       VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr,
+                       0, nullptr);
+  vulkanDevice->submitAndWait(cmd);
+
+  std::vector<uint8_t> data(dataSize);
+  vulkanDevice->copyAllocToMemory(&readback, data.data(), dataSize,
+                                  dataAddress - readback.deviceAddress);
+  vulkanDevice->destroy(&readback);
+
+  return writeAccelCache(sourcePath, contentHash, flags, entries, data);
 }
 
 uint64_t RayTraceBuilder::getBlasDeviceAddress(uint32_t blasId) {
@@ -111,9 +641,18 @@ uint64_t RayTraceBuilder::getBlasDeviceAddress(uint32_t blasId) {
   VkAccelerationStructureDeviceAddressInfoKHR addressInfo{
       VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR};
   addressInfo.accelerationStructure = blas[blasId].accel;
-  return pfnGetAccelerationStructureDeviceAddressKHR(
+  return vulkanDevice->getExt().pfnGetAccelerationStructureDeviceAddressKHR(
       vulkanDevice->operator VkDevice(), &addressInfo);
 }
+RayTraceBuilder::BlasMemoryStats RayTraceBuilder::getBlasMemoryStats() const {
+  AccelMemoryPool::Stats poolStats = blasPool.getStats();
+  return {
+      .originalBytes = blasOriginalSize,
+      .compactBytes = poolStats.usedBytes,
+      .reservedBytes = poolStats.reservedBytes,
+  };
+}
+
 VkAccelerationStructureKHR RayTraceBuilder::getAccelerationStructure() {
   return tlas.accel;
 }
@@ -2,10 +2,12 @@
 
 #include <vulkan/vulkan_core.h>
 
+#include <string>
 #include <vector>
 
 #include "../Core/Tools/HelperMacros.hpp"
 #include "../Core/Vulkan/VulkanDevice.h"
+#include "AccelMemoryPool.hpp"
 
 #ifndef VULKAN_RAYTRACE
 //#warning "Missing preprocessor define VULKAN_RAYTRACE"
@@ -42,7 +44,9 @@ struct AccelerationStructureBuildData {
   }
 
   VkAccelerationStructureBuildSizesInfoKHR finalizeGeometry(
-      VulkanDevice* device, VkBuildAccelerationStructureFlagsKHR flags) {
+      VulkanDevice* device, VkBuildAccelerationStructureFlagsKHR flags,
+      VkAccelerationStructureBuildTypeKHR buildType =
+          VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR) {
     assert(asGeometry.size() > 0 && "No geometry added to Build Structure");
     assert(asType != VK_ACCELERATION_STRUCTURE_TYPE_MAX_ENUM_KHR &&
            "Acceleration Structure Type not set");
@@ -65,50 +69,56 @@ struct AccelerationStructureBuildData {
     }
 
     device->getExt().pfnGetAccelerationStructureBuildSizesKHR(
-        device->operator VkDevice(),
-        VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildInfo,
+        device->operator VkDevice(), buildType, &buildInfo,
         maxPrimCount.data(), &sizeInfo);
 
     return sizeInfo;
   }
 };
 
-struct AccelData {
-  VkAccelerationStructureKHR accel;
-  core_internal::rendering::Buffer buf;
-};
-
 struct ScratchSizeInfo {
   VkDeviceSize maxScratch;
   VkDeviceSize totalScratch;
 };
 
+// Records batched BLAS builds and their compaction. Batches are addressed by
+// BLAS index ranges so several can be in flight at once; RayTraceBuilder
+// decides when they are submitted and waited on. Builds are placed in
+// buildPool and compacted copies in compactPool.
 class BlasBuilder {
  protected:
   VulkanDevice* device;
-  VkQueryPool queryPool;
-
-  uint32_t currentBlasIdx = 0;
-  uint32_t currentQueryIdx = 0;
-
-  std::vector<AccelData> cleanupBlasAccel;
+  AccelMemoryPool* buildPool;
+  AccelMemoryPool* compactPool;
+  // One compacted size query per BLAS, indexed like the build data
+  VkQueryPool queryPool = VK_NULL_HANDLE;
 
   struct Stats {
+    // Sizes of every BLAS as built and as kept, the two are equal without
+    // compaction
     VkDeviceSize totalOriginalSize = 0;
     VkDeviceSize totalCompactSize = 0;
 
     std::string toString() const {
-      return "Total Original Size: " + totalOriginalSize +
-             *". Total Compact Size" + totalCompactSize;
+      return "Total Original Size: " + std::to_string(totalOriginalSize) +
+             ". Total Compact Size: " + std::to_string(totalCompactSize) +
+             "\n";
     }
   } stats;
 
  public:
-  BlasBuilder(core_internal::rendering::VulkanDevice* device)
-      : device(device) {}
-  ~BlasBuilder() {}
+  BlasBuilder(core_internal::rendering::VulkanDevice* device,
+              AccelMemoryPool* buildPool, AccelMemoryPool* compactPool)
+      : device(device), buildPool(buildPool), compactPool(compactPool) {}
+  ~BlasBuilder() {
+    if (queryPool) {
+      vkDestroyQueryPool(device->operator VkDevice(), queryPool, nullptr);
+    }
+  }
 
   std::string getStatistics() { return stats.toString(); }
+  VkDeviceSize getOriginalSize() const { return stats.totalOriginalSize; }
+  VkDeviceSize getCompactSize() const { return stats.totalCompactSize; }
 
   ScratchSizeInfo calculateScratchAlignedSizes(
       const std::vector<AccelerationStructureBuildData>& buildData,
@@ -180,56 +190,50 @@ class BlasBuilder {
     }
   }
 
-  bool cmdCreateParallelBlas(
+  // Records the builds of the BLAS from firstBlas on until hintMaxBudget
+  // bytes of acceleration structures are recorded, using scratchAddresses
+  // for the scratch memory. Returns the end of the recorded range.
+  uint32_t cmdCreateParallelBlas(
       VkCommandBuffer cmd,
       std::vector<AccelerationStructureBuildData>& blasBuildData,
-      std::vector<AccelData> blasAccel,
-      std::vector<VkDeviceAddress>& scratchAddresses,
-      VkDeviceSize hintMaxBudget) {
+      std::vector<AccelData>& blasAccel,
+      const std::vector<VkDeviceAddress>& scratchAddresses,
+      VkDeviceSize hintMaxBudget, uint32_t firstBlas) {
     initializeQueryPool(blasBuildData);
 
     VkDeviceSize processBudget = 0;
-    uint32_t currentQueryIdx = currentQueryIdx;
+    uint32_t blasIdx = firstBlas;
     // Process each BLAS in the data vector while staying under the memory
     // budget.
-    while (currentBlasIdx < blasBuildData.size() &&
-           processBudget < hintMaxBudget) {
+    while (blasIdx < blasBuildData.size() && processBudget < hintMaxBudget) {
       // Build acceleration structures and accumulate the total memory used.
       processBudget += buildAccelerationStructures(
           cmd, blasBuildData, blasAccel, scratchAddresses, hintMaxBudget,
-          processBudget, currentQueryIdx);
+          processBudget, blasIdx);
     }
-
-    // Check if all BLAS have been built.
-    return currentBlasIdx >= blasBuildData.size();
+    return blasIdx;
   }
 
   void initializeQueryPool(
       const std::vector<AccelerationStructureBuildData>& blasBuildData) {
-    if (!queryPool) {
-      // Iterate through each BLAS build data element to check if the compaction
-      // flag is set.
-      for (const auto& blas : blasBuildData) {
-        if (blas.buildInfo.flags &
-            VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR) {
-          VkQueryPoolCreateInfo qpCI{
-              .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
-              .queryType =
-                  VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR,
-              .queryCount = static_cast<uint32_t>(blasBuildData.size()),
-          };
-          vkCreateQueryPool(device->operator VkDevice(), &qpCI, nullptr,
-                            &queryPool);
-          break;
-        }
-      }
-    }
-
-    // If a query pool is now available (either newly created or previously
-    // existing), reset the query pool to clear any old data or states.
     if (queryPool) {
-      vkResetQueryPool(device->operator VkDevice(), queryPool, 0,
-                       static_cast<uint32_t>(blasBuildData.size()));
+      return;
+    }
+    // Iterate through each BLAS build data element to check if the compaction
+    // flag is set.
+    for (const auto& blas : blasBuildData) {
+      if (blas.buildInfo.flags &
+          VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR) {
+        VkQueryPoolCreateInfo qpCI{
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType =
+                VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR,
+            .queryCount = static_cast<uint32_t>(blasBuildData.size()),
+        };
+        VK_CHECK_RESULT(vkCreateQueryPool(device->operator VkDevice(), &qpCI,
+                                          nullptr, &queryPool));
+        break;
+      }
     }
   }
 
@@ -239,17 +243,18 @@ class BlasBuilder {
       std::vector<AccelData>& blasAccel,
       const std::vector<VkDeviceAddress>& scratchAddress,
       VkDeviceSize hintMaxBudget, VkDeviceSize currentBudget,
-      uint32_t& currentQueryIdx) {
+      uint32_t& blasIdx) {
     // Temporary vectors for storing build-related data
     std::vector<VkAccelerationStructureBuildGeometryInfoKHR> collectedBuildInfo;
     std::vector<VkAccelerationStructureKHR> collectedAccel;
     std::vector<VkAccelerationStructureBuildRangeInfoKHR*> collectedRangeInfo;
 
     // Pre-allocate memory based on the number of BLAS to be built
-    collectedBuildInfo.reserve(blasBuildData.size());
-    collectedAccel.reserve(blasBuildData.size());
-    collectedRangeInfo.reserve(blasBuildData.size());
+    collectedBuildInfo.reserve(scratchAddress.size());
+    collectedAccel.reserve(scratchAddress.size());
+    collectedRangeInfo.reserve(scratchAddress.size());
 
+    const uint32_t firstBlas = blasIdx;
     // Initialize the total budget used in this function call
     VkDeviceSize budgetUsed = 0;
 
@@ -257,27 +262,31 @@ class BlasBuilder {
     // available
     while (collectedBuildInfo.size() < scratchAddress.size() &&
            currentBudget + budgetUsed < hintMaxBudget &&
-           currentBlasIdx < blasBuildData.size()) {
-      auto& data = blasBuildData[currentBlasIdx];
+           blasIdx < blasBuildData.size()) {
+      auto& data = blasBuildData[blasIdx];
       VkAccelerationStructureCreateInfoKHR createInfo = data.makeCreateInfo();
 
       // Create and store acceleration structure
-      blasAccel[currentBlasIdx] = createAcceleration(createInfo);
-      collectedAccel.push_back(blasAccel[currentBlasIdx].accel);
+      blasAccel[blasIdx] = createAcceleration(createInfo);
+      collectedAccel.push_back(blasAccel[blasIdx].accel);
 
       // Setup build information for the current BLAS
       data.buildInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
       data.buildInfo.srcAccelerationStructure = VK_NULL_HANDLE;
-      data.buildInfo.dstAccelerationStructure = blasAccel[currentBlasIdx].accel;
+      data.buildInfo.dstAccelerationStructure = blasAccel[blasIdx].accel;
       data.buildInfo.scratchData.deviceAddress =
-          scratchAddress[currentBlasIdx % scratchAddress.size()];
+          scratchAddress[blasIdx % scratchAddress.size()];
       data.buildInfo.pGeometries = data.asGeometry.data();
       collectedBuildInfo.push_back(data.buildInfo);
       collectedRangeInfo.push_back(data.asBuildRangeInfo.data());
 
       // Update the used budget with the size of the current structure
       budgetUsed += data.sizeInfo.accelerationStructureSize;
-      currentBlasIdx++;
+      stats.totalOriginalSize += data.sizeInfo.accelerationStructureSize;
+      if (queryPool == VK_NULL_HANDLE) {
+        stats.totalCompactSize += data.sizeInfo.accelerationStructureSize;
+      }
+      blasIdx++;
     }
 
     // Command to build the acceleration structures on the GPU
@@ -285,20 +294,24 @@ class BlasBuilder {
         cmd, static_cast<uint32_t>(collectedBuildInfo.size()),
         collectedBuildInfo.data(), collectedRangeInfo.data());
 
-    // Barrier to ensure proper synchronization after building
-    accelerationStructureBarrier(cmd,
-                                 VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
-                                 VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR);
+    // Barrier to ensure proper synchronization after building, the next
+    // builds reuse the scratch memory
+    accelerationStructureBarrier(
+        cmd, VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
+        VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR |
+            VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR);
 
     // If a query pool is available, record the properties of the built
-    // acceleration structures
+    // acceleration structures. Queries are indexed like the BLAS, so only
+    // this range is reset and batches in flight keep their results.
     if (queryPool) {
+      vkCmdResetQueryPool(cmd, queryPool, firstBlas,
+                          static_cast<uint32_t>(collectedAccel.size()));
       device->getExt().pfnCmdWriteAccelerationStructuresPropertiesKHR(
           cmd, static_cast<uint32_t>(collectedAccel.size()),
           collectedAccel.data(),
           VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, queryPool,
-          currentQueryIdx);
-      currentQueryIdx += static_cast<uint32_t>(collectedAccel.size());
+          firstBlas);
     }
 
     // Return the total budget used in this operation
@@ -318,38 +331,18 @@ class BlasBuilder {
   }
 
   AccelData createAcceleration(const VkAccelerationStructureCreateInfoKHR& CI) {
-    AccelData resultAccel;
-
-    VkBufferCreateInfo bufCI{
-        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-        .size = CI.size,
-        .usage = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR |
-                 VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-    };
-
-    VkAccelerationStructureCreateInfoKHR accel = CI;
-    accel.buffer = resultAccel.buf.buffer;
-
-    device->getExt().pfnCreateAccelerationStructureKHR(
-        device->operator VkDevice(), &accel, nullptr, &resultAccel.accel);
-
-    VkAccelerationStructureDeviceAddressInfoKHR info{
-        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR};
-    info.accelerationStructure = resultAccel.accel;
-    resultAccel.buf.deviceAddress =
-        device->getExt().pfnGetAccelerationStructureDeviceAddressKHR(
-            device->operator VkDevice(), &info);
-
-    return resultAccel;
+    return buildPool->create(CI);
   }
 
+  // Records the compaction of the BLAS in [firstBlas, endBlas), whose builds
+  // must have completed. The uncompacted originals are appended to
+  // originals and have to outlive cmd.
   void cmdCompactBlas(
       VkCommandBuffer cmd,
       std::vector<tools::AccelerationStructureBuildData>& buildData,
-      std::vector<AccelData>& blas) {
-    // Compute the number of queries that have been conducted between the
-    // current BLAS index and the query index.
-    uint32_t queryCtn = currentBlasIdx - currentQueryIdx;
+      std::vector<AccelData>& blas, uint32_t firstBlas, uint32_t endBlas,
+      std::vector<AccelData>& originals) {
+    const uint32_t queryCtn = endBlas - firstBlas;
     // Ensure there is a valid query pool and BLAS to compact;
     if (queryPool == VK_NULL_HANDLE || queryCtn == 0) {
       return;
@@ -357,57 +350,50 @@ class BlasBuilder {
 
     // Retrieve the compacted sizes from the query pool.
     std::vector<VkDeviceSize> compactSizes(queryCtn);
-    vkGetQueryPoolResults(device->operator VkDevice(), queryPool,
-                          currentQueryIdx, (uint32_t)compactSizes.size(),
-                          compactSizes.size() * sizeof(VkDeviceSize),
+    vkGetQueryPoolResults(device->operator VkDevice(), queryPool, firstBlas,
+                          queryCtn, compactSizes.size() * sizeof(VkDeviceSize),
                           compactSizes.data(), sizeof(VkDeviceSize),
-                          VK_QUERY_RESULT_WAIT_BIT);
-
-    // Iterate through each BLAS index to process compaction.
-    for (size_t i = currentQueryIdx; i < currentBlasIdx; i++) {
-      size_t idx =
-          i -
-          currentQueryIdx;  // Calculate local index for compactSizes vector.
-      VkDeviceSize compactSize = compactSizes[idx];
-      if (compactSize > 0) {
-        // Update statistical tracking of sizes before and after compaction.
-        stats.totalCompactSize += compactSize;
-        stats.totalOriginalSize +=
-            buildData[i].sizeInfo.accelerationStructureSize;
-        buildData[i].sizeInfo.accelerationStructureSize = compactSize;
-        cleanupBlasAccel.push_back(blas[i]);  // Schedule old BLAS for cleanup.
-
-        // Create a new acceleration structure for the compacted BLAS.
-        VkAccelerationStructureCreateInfoKHR asCreateInfo{
-            VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR};
-        asCreateInfo.size = compactSize;
-        asCreateInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-        blas[i] = createAcceleration(asCreateInfo);
-
-        // Command to copy the original BLAS to the newly created compacted
-        // version.
-        VkCopyAccelerationStructureInfoKHR copyInfo{
-            VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR};
-        copyInfo.src = buildData[i].buildInfo.dstAccelerationStructure;
-        copyInfo.dst = blas[i].accel;
-        copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
-        device->getExt().pfnCmdCopyAccelerationStructureKHR(cmd, &copyInfo);
-
-        // Update the build data to reflect the new destination of the BLAS.
-        buildData[i].buildInfo.dstAccelerationStructure = blas[i].accel;
+                          VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+
+    // Iterate through each BLAS index to process compaction. Every BLAS moves
+    // to the compact pool so the build pool can be released as a whole; one
+    // without a compacted size is cloned at its original size.
+    for (uint32_t i = firstBlas; i < endBlas; i++) {
+      VkDeviceSize compactSize = compactSizes[i - firstBlas];
+      const bool compact = compactSize > 0;
+      if (!compact) {
+        compactSize = buildData[i].sizeInfo.accelerationStructureSize;
       }
+      // The original size was counted when the build was recorded.
+      stats.totalCompactSize += compactSize;
+      buildData[i].sizeInfo.accelerationStructureSize = compactSize;
+      originals.push_back(blas[i]);  // Schedule old BLAS for cleanup.
+
+      // Create a new acceleration structure for the compacted BLAS.
+      VkAccelerationStructureCreateInfoKHR asCreateInfo{
+          VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR};
+      asCreateInfo.size = compactSize;
+      asCreateInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+      blas[i] = compactPool->create(asCreateInfo);
+
+      // Command to copy the original BLAS to the newly created compacted
+      // version.
+      VkCopyAccelerationStructureInfoKHR copyInfo{
+          VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR};
+      copyInfo.src = buildData[i].buildInfo.dstAccelerationStructure;
+      copyInfo.dst = blas[i].accel;
+      copyInfo.mode = compact ? VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR
+                              : VK_COPY_ACCELERATION_STRUCTURE_MODE_CLONE_KHR;
+      device->getExt().pfnCmdCopyAccelerationStructureKHR(cmd, &copyInfo);
+
+      // Update the build data to reflect the new destination of the BLAS.
+      buildData[i].buildInfo.dstAccelerationStructure = blas[i].accel;
     }
-
-    // Update the query index to the current BLAS index, marking the end of
-    // processing for these structures.
-    currentQueryIdx = currentBlasIdx;
   }
 
-  void destroyNonCompactedBlas() {
-    for (auto& blas : cleanupBlasAccel) {
-      device->destroy(&blas.buf);
-    }
-    cleanupBlasAccel.clear();
+  // Releases uncompacted originals whose copies have completed
+  void destroyAccel(std::vector<AccelData>& accels) {
+    buildPool->destroy(accels);
   }
 };
 }  // namespace tools
@@ -415,11 +401,29 @@ class BlasBuilder {
 class RayTraceBuilder {
  protected:
   VulkanDevice* vulkanDevice;
+  // BLAS are built on host threads instead of the device
+  bool hostBuild;
+  // Storage of every BLAS kept after buildBlas, tightly packed
+  AccelMemoryPool blasPool;
   std::vector<tools::AccelData> blas;
   tools::AccelData tlas;
-
-  PFN_vkGetAccelerationStructureDeviceAddressKHR
-      pfnGetAccelerationStructureDeviceAddressKHR;
+  VkDeviceSize blasOriginalSize = 0;
+
+  // TLAS inputs kept between builds so transform changes can be refit in
+  // place: the instances last built, the host visible buffer they are read
+  // from and a scratch buffer grown to the largest build or update so far
+  std::vector<VkAccelerationStructureInstanceKHR> tlasInstances;
+  VkBuildAccelerationStructureFlagsKHR tlasFlags = 0;
+  Buffer instanceBuffer{};
+  Buffer tlasScratchBuffer{};
+
+  // Returns a scratch address for a build needing size bytes
+  VkDeviceAddress reserveTlasScratch(VkDeviceSize size);
+  void recordTlasBuild(bool update);
+  // Builds every BLAS with vkBuildAccelerationStructuresKHR, one deferred
+  // operation per BLAS joined by a pool of worker threads
+  void buildBlasOnHost(
+      std::vector<tools::AccelerationStructureBuildData>& buildData);
 
  public:
   struct BlasInput {
@@ -428,20 +432,54 @@ class RayTraceBuilder {
     VkBuildAccelerationStructureFlagsKHR asFlags{0};
   };
 
-  explicit RayTraceBuilder(core_internal::rendering::VulkanDevice*);
+  // hostBuild selects host builds of the BLAS, which need the
+  // accelerationStructureHostCommands feature and BlasInput geometry given
+  // by host addresses. Without the feature the device builds them.
+  explicit RayTraceBuilder(core_internal::rendering::VulkanDevice*,
+                           bool hostBuild = false);
   ~RayTraceBuilder();
 
+  bool usesHostBuilds() const { return hostBuild; }
+
   void buildBlas(const std::vector<BlasInput>& input,
                  VkBuildAccelerationStructureFlagsKHR flags =
                      VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR);
+
+  // Replaces the BLAS with the blasCount structures cached for sourcePath
+  // (see AccelCache.hpp). Returns false, leaving the BLAS untouched, if there
+  // is no cache for contentHash and flags or this driver can't read it.
+  bool loadBlas(const std::string& sourcePath, uint64_t contentHash,
+                VkBuildAccelerationStructureFlagsKHR flags,
+                uint32_t blasCount);
+  // Serializes the BLAS built with flags into the cache of sourcePath
+  bool saveBlas(const std::string& sourcePath, uint64_t contentHash,
+                VkBuildAccelerationStructureFlagsKHR flags);
+
+  // Builds the TLAS over the instances, always allowing later updates. With
+  // update set and the same instance count and flags as the last build, the
+  // existing TLAS is refit instead, which is much cheaper but only keeps
+  // traversal fast while the instances move moderately.
   void buildTlas(
       const std::vector<VkAccelerationStructureInstanceKHR>& instances,
       VkBuildAccelerationStructureFlagsKHR flags =
           VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR,
       bool update = false);
+  // Refits the TLAS after changing only the instance transforms, one per
+  // instance of the last build
+  void updateTlasTransforms(
+      const std::vector<VkTransformMatrixKHR>& transforms);
 
   uint64_t getBlasDeviceAddress(uint32_t blasId);
 
+  struct BlasMemoryStats {
+    // Sizes of the BLAS as built and as kept after compaction
+    VkDeviceSize originalBytes = 0;
+    VkDeviceSize compactBytes = 0;
+    // Device memory the BLAS pool holds for them
+    VkDeviceSize reservedBytes = 0;
+  };
+  BlasMemoryStats getBlasMemoryStats() const;
+
   VkAccelerationStructureKHR getAccelerationStructure();
 };
 }  // namespace core_internal::rendering::raytracing
\ No newline at end of file
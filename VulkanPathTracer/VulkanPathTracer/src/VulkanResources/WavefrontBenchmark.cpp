@@ -0,0 +1,100 @@
+#include "WavefrontBenchmark.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+namespace core_internal::rendering::raytracing {
+namespace {
+struct ModeTiming {
+  double milliseconds = -1.0;
+  uint32_t samples = 0;
+  double averagePathLength = 0.0;
+  double shadowRaysPerPath = 0.0;
+};
+
+// Best time of settings.repetitions renders, leaving the last image in image
+ModeTiming timeMode(PathTraceRenderer& renderer, const RenderJob& job,
+                    const WavefrontBenchmarkSettings& settings,
+                    std::vector<float>& image) {
+  ModeTiming timing;
+  if (renderer.render(job, image) == 0) {
+    return timing;
+  }
+  for (uint32_t i = 0; i < std::max(1u, settings.repetitions); i++) {
+    auto renderStart = std::chrono::steady_clock::now();
+    timing.samples = renderer.render(job, image);
+    timing.averagePathLength =
+        renderer.getLastStatistics().getAverageLength();
+    timing.shadowRaysPerPath =
+        renderer.getLastStatistics().getShadowRaysPerPath();
+    double milliseconds = std::chrono::duration<double, std::milli>(
+                              std::chrono::steady_clock::now() - renderStart)
+                              .count();
+    if (timing.milliseconds < 0.0 || milliseconds < timing.milliseconds) {
+      timing.milliseconds = milliseconds;
+    }
+  }
+  return timing;
+}
+}  // namespace
+
+std::string runWavefrontBenchmark(
+    PathTraceRenderer& renderer, const RenderJob& job,
+    const WavefrontBenchmarkSettings& settings) {
+  RenderJob benchmarkJob = job;
+  benchmarkJob.timeBudgetSeconds = 0.0;
+  const double pixelCount =
+      double(job.params.resolution[0]) * job.params.resolution[1];
+
+  std::stringstream report;
+  report << "Wavefront benchmark: \"" << job.scenePath << "\", "
+         << job.params.resolution[0] << "x" << job.params.resolution[1]
+         << ", " << job.params.maxSegments - 1 << " bounces, "
+         << job.targetSamples << " samples per pixel, kernel shape "
+         << renderer.getKernelShape().toString() << "\n";
+
+  std::vector<float> images[2];
+  double milliseconds[2];
+  for (int wavefront = 0; wavefront < 2; wavefront++) {
+    benchmarkJob.wavefront = wavefront != 0;
+    const ModeTiming timing =
+        timeMode(renderer, benchmarkJob, settings, images[wavefront]);
+    milliseconds[wavefront] = timing.milliseconds;
+
+    report << "  " << std::left << std::setw(12)
+           << (wavefront ? "wavefront" : "megakernel") << std::right;
+    if (timing.milliseconds < 0.0) {
+      report << "    failed\n";
+      continue;
+    }
+    report << std::fixed << std::setprecision(3) << std::setw(12)
+           << timing.milliseconds << " ms" << std::setw(10)
+           << pixelCount * timing.samples / (timing.milliseconds * 1e3)
+           << " Msamples/s" << std::setw(8) << timing.averagePathLength
+           << " segments and" << std::setw(8) << timing.shadowRaysPerPath
+           << " shadow rays per path\n";
+    report.unsetf(std::ios::fixed);
+  }
+  if (milliseconds[0] < 0.0 || milliseconds[1] < 0.0) {
+    return report.str();
+  }
+
+  // Relative to the mean of the megakernel image, so it reads the same for
+  // bright and dark scenes
+  double difference = 0.0;
+  double sum = 0.0;
+  for (size_t i = 0; i < images[0].size(); i++) {
+    difference += std::abs(double(images[1][i]) - images[0][i]);
+    sum += std::abs(double(images[0][i]));
+  }
+  report << std::fixed << std::setprecision(3)
+         << "  Speedup: " << milliseconds[0] / milliseconds[1]
+         << "x, mean image difference: "
+         << (sum > 0.0 ? 100.0 * difference / sum : 0.0) << "%\n";
+  return report.str();
+}
+}  // namespace core_internal::rendering::raytracing
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "../Core/Rendering/RenderJob.hpp"
+#include "PathTraceRenderer.hpp"
+
+namespace core_internal::rendering::raytracing {
+struct WavefrontBenchmarkSettings {
+  // Best of this many renders is reported for every mode, after one untimed
+  // render that loads the scene and compiles the pipelines
+  uint32_t repetitions = 3;
+};
+
+// Renders the job with the megakernel and with the wavefront kernels, at its
+// sample target and without a time budget, and compares their times. Both
+// modes draw the same random numbers, so the report also gives the mean
+// difference of the images as a check. Returns a printable report.
+std::string runWavefrontBenchmark(
+    PathTraceRenderer& renderer, const RenderJob& job,
+    const WavefrontBenchmarkSettings& settings = {});
+}  // namespace core_internal::rendering::raytracing
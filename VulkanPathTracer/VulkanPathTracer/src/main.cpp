@@ -1,4 +1,8 @@
-#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb_image_write.h>
@@ -6,20 +10,177 @@
 #include <tiny_obj_loader.h>
 
 #define VULKAN_DEBUG_EXT
-#define VULKAN_RAYTRACE
 
+#include "Core/Rendering/Mesh.hpp"
+#include "Core/Rendering/ObjBenchmark.hpp"
+#include "Core/Rendering/PartialAccumulation.hpp"
+#include "Core/Rendering/RenderJob.hpp"
 #include "Core/Tools/HelperMacros.hpp"
-#include "Core/Vulkan/VulkanDescriptorSet.hpp"
 #include "Core/Vulkan/VulkanDevice.h"
-#include "VulkanResources/RayTraceHelper.hpp"
+#include "CpuResources/BvhBenchmark.hpp"
+#include "CpuResources/CpuPathTracer.hpp"
+#include "VulkanResources/KernelAutotuner.hpp"
+#include "VulkanResources/PathTraceRenderer.hpp"
+#include "VulkanResources/WavefrontBenchmark.hpp"
 
 // TODO: USE IMGUI TO SHOW/GENERATE MORE IMAGES
-static const uint32_t RenderWidth = 800;
-static const uint32_t RenderHeight = 600;
-static const uint32_t WorkgroupWidth = 16;
-static const uint32_t WorkgroupHeight = 8;
 
 int main(int argc, const char** argv) {
+  bool useCpuBackend = false;
+  bool runBvhBenchmark = false;
+  bool runObjBenchmark = false;
+  // Triangles of a generated grid to benchmark the OBJ loaders on instead of
+  // the scene, 0 benchmarks the scene
+  uint64_t objBenchmarkGridTriangles = 0;
+  // Build acceleration structures on host threads when the device supports
+  // it, e.g. on CPU implementations
+  bool hostAccelBuilds = false;
+  // Compiled pipelines are kept here between runs
+  std::string pipelineCachePath = "pipeline_cache.bin";
+  // Sweep kernel shapes on the scene instead of rendering, and store the
+  // fastest for this device in the tuning file that later runs read
+  bool runKernelAutotune = false;
+  std::string kernelTuningPath = "kernel_tuning.txt";
+  // Time the scene with the megakernel and the wavefront kernels instead of
+  // rendering the jobs
+  bool runWavefrontBenchmark = false;
+  // Partial accumulations of one image's sample shards, merged into --out
+  // instead of rendering
+  std::vector<std::string> mergePaths;
+  // Job list for headless batch rendering, see loadRenderJobs
+  const char* batchPath = nullptr;
+  // Options given on the command line, and the defaults of every batch job
+  core_internal::rendering::RenderJob commandLineJob;
+
+  std::vector<std::string> args(argv, argv + argc);
+  for (size_t i = 1; i < args.size(); i++) {
+    if (args[i] == "--cpu") {
+      useCpuBackend = true;
+    } else if (args[i] == "--bench-bvh") {
+      runBvhBenchmark = true;
+    } else if (args[i] == "--bench-obj") {
+      runObjBenchmark = true;
+    } else if (args[i] == "--bench-obj-grid" && i + 1 < args.size()) {
+      runObjBenchmark = true;
+      objBenchmarkGridTriangles = std::strtoull(argv[++i], nullptr, 10);
+    } else if (args[i] == "--host-as-build") {
+      hostAccelBuilds = true;
+    } else if (args[i] == "--pipeline-cache" && i + 1 < args.size()) {
+      pipelineCachePath = args[++i];
+    } else if (args[i] == "--autotune") {
+      runKernelAutotune = true;
+    } else if (args[i] == "--kernel-tuning" && i + 1 < args.size()) {
+      kernelTuningPath = args[++i];
+    } else if (args[i] == "--bench-wavefront") {
+      runWavefrontBenchmark = true;
+    } else if (args[i] == "--merge" && i + 1 < args.size()) {
+      mergePaths.push_back(args[++i]);
+    } else if (args[i] == "--batch" && i + 1 < args.size()) {
+      batchPath = argv[++i];
+    } else if (!core_internal::rendering::parseRenderJobOption(
+                   args, i, commandLineJob)) {
+      DEBUG_WARNING("Ignoring unknown option \"" + args[i] + "\"");
+    }
+  }
+
+  std::vector<core_internal::rendering::RenderJob> jobs;
+  if (batchPath) {
+    jobs = core_internal::rendering::loadRenderJobs(batchPath, commandLineJob);
+  } else {
+    jobs.push_back(commandLineJob);
+  }
+
+  if (!mergePaths.empty()) {
+    core_internal::rendering::PartialAccumulation merged;
+    for (const std::string& path : mergePaths) {
+      core_internal::rendering::PartialAccumulation shard;
+      if (!core_internal::rendering::loadPartialAccumulation(path, shard)) {
+        DEBUG_ERROR("Could not read partial accumulation \"" + path + "\"");
+      }
+      if (!core_internal::rendering::mergePartialAccumulation(merged,
+                                                              shard)) {
+        DEBUG_ERROR("Could not merge \"" + path + "\"");
+      }
+    }
+    std::vector<float> rgb;
+    core_internal::rendering::resolvePartialAccumulation(merged, rgb);
+    stbi_write_hdr(commandLineJob.outputPath.c_str(), merged.width,
+                   merged.height, 3, rgb.data());
+    return 0;
+  }
+
+  if (runObjBenchmark) {
+    std::string objPath = commandLineJob.scenePath;
+    if (objBenchmarkGridTriangles > 0) {
+      objPath = "bench_grid_" + std::to_string(objBenchmarkGridTriangles) +
+                ".obj";
+      if (!core_internal::rendering::writeGridObj(
+              objPath, objBenchmarkGridTriangles)) {
+        DEBUG_ERROR("Could not write \"" + objPath + "\"");
+      }
+    }
+    DEBUG_LOG(core_internal::rendering::runObjBenchmark(objPath));
+    return 0;
+  }
+
+  if (runBvhBenchmark) {
+    core_internal::rendering::Mesh mesh;
+    if (!core_internal::rendering::loadMesh(commandLineJob.scenePath, mesh)) {
+      return 1;
+    }
+    core_internal::rendering::cpu::BvhBenchmarkSettings settings{
+        .view = commandLineJob.params,
+    };
+    DEBUG_LOG(core_internal::rendering::cpu::runBvhBenchmark(
+        mesh.vertices, mesh.indices, settings));
+    return 0;
+  }
+
+  if (useCpuBackend) {
+    // Tiles shaped like the GPU's default workgroups
+    using core_internal::rendering::raytracing::KernelShape;
+    core_internal::rendering::cpu::CpuRenderSettings settings{
+        .tileWidth = KernelShape::DefaultWorkgroupWidth,
+        .tileHeight = KernelShape::DefaultWorkgroupHeight,
+    };
+    for (const core_internal::rendering::RenderJob& job : jobs) {
+      core_internal::rendering::Mesh mesh;
+      if (!core_internal::rendering::loadMesh(job.scenePath, mesh)) {
+        continue;
+      }
+      const uint32_t renderWidth = job.params.resolution[0];
+      const uint32_t renderHeight = job.params.resolution[1];
+      std::vector<float> imageData(size_t(renderWidth) * renderHeight * 3);
+      std::vector<float> accumulation(size_t(renderWidth) * renderHeight * 4);
+
+      core_internal::rendering::cpu::CpuPathTracer cpuPathTracer(mesh);
+      DEBUG_LOG(cpuPathTracer.getBvh().getStatistics());
+      DEBUG_LOG(cpuPathTracer.getBvh8().getStatistics());
+      // The job's share of the samples, which is all of them by default
+      core_internal::rendering::RenderParameters params = job.params;
+      params.log2SamplesPerPixel =
+          core_internal::rendering::getLog2SampleCount(job.targetSamples);
+      cpuPathTracer.renderSampleRange(params, job.firstSample,
+                                      job.getLastSample(), settings,
+                                      accumulation.data(), imageData.data());
+
+      if (!job.partialPath.empty()) {
+        // Merges with shards rendered on the GPU, which trace the same paths
+        core_internal::rendering::PartialAccumulation partial;
+        partial.assign(renderWidth, renderHeight, job.firstSample,
+                       job.getLastSample(), accumulation.data());
+        if (!core_internal::rendering::savePartialAccumulation(
+                job.partialPath, partial)) {
+          DEBUG_WARNING("Could not write \"" + job.partialPath + "\"");
+        }
+        continue;
+      }
+      stbi_write_hdr(job.outputPath.c_str(), renderWidth, renderHeight, 3,
+                     imageData.data());
+    }
+    return 0;
+  }
+
   std::vector<const char*> deviceExtensions;
   std::vector<const char*> instanceExtensions;
 
@@ -32,252 +193,92 @@ int main(int argc, const char** argv) {
           "PathTracer", false, deviceExtensions, instanceExtensions, nullptr,
           VK_API_VERSION_1_3);
 
-  VkBufferCreateInfo bufferInfo{
-      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-      .size = RenderWidth * RenderHeight * 3 * sizeof(float),
-      .usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-               VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-  };
-
-  core_internal::rendering::Buffer* buf =
-      new core_internal::rendering::Buffer();
-  device->createBuffer(buf, bufferInfo,
-                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                           VK_MEMORY_PROPERTY_HOST_CACHED_BIT |
-                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                       VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
-
-  std::vector<core_internal::rendering::raytracing::RayTraceBuilder::BlasInput>
-      blases;
-
-  core_internal::rendering::Buffer* vertexBuffer;
-  core_internal::rendering::Buffer* indexBuffer;
-
-  // For Each static model
-  // Load model
-  tinyobj::ObjReader reader;  // Used to read an OBJ file
-  reader.ParseFromFile("assets/CornellBox-Original-Merged.obj");
-
-  const std::vector<tinyobj::real_t> objVertices =
-      reader.GetAttrib().GetVertices();
-  const std::vector<tinyobj::shape_t>& objShapes =
-      reader.GetShapes();         // All shapes in the file
-  assert(objShapes.size() == 1);  // Check that this file has only one shape
-  const tinyobj::shape_t& objShape = objShapes[0];  // Get the first shape
-  // Get the indices of the vertices of the first mesh of `objShape` in
-  // `attrib.vertices`:
-  std::vector<uint32_t> objIndices;
-  objIndices.reserve(objShape.mesh.indices.size());
-  for (const tinyobj::index_t& index : objShape.mesh.indices) {
-    objIndices.push_back(index.vertex_index);
+  device->initPipelineCache(pipelineCachePath);
+
+  // The device, scene resources and pipeline stay alive across every job
+  auto renderer = new core_internal::rendering::raytracing::PathTraceRenderer(
+      device, hostAccelBuilds);
+
+  core_internal::rendering::raytracing::KernelShape kernelShape;
+  if (runKernelAutotune) {
+    auto result = core_internal::rendering::raytracing::runKernelAutotune(
+        *renderer, commandLineJob);
+    DEBUG_LOG(result.report);
+    if (result.bestMilliseconds >= 0.0 &&
+        !core_internal::rendering::raytracing::saveKernelShape(
+            kernelTuningPath, *device, result.best)) {
+      DEBUG_WARNING("Could not write kernel tuning \"" + kernelTuningPath +
+                    "\"");
+    }
+    // Only tune, the jobs render with the shape on the next run
+    jobs.clear();
+  } else if (core_internal::rendering::raytracing::loadKernelShape(
+                 kernelTuningPath, *device, kernelShape) &&
+             !renderer->setKernelShape(kernelShape)) {
+    DEBUG_WARNING("Ignoring unsupported tuned kernel shape " +
+                  kernelShape.toString());
   }
 
-  VkBufferCreateInfo vertBufCI{
-      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-      .size = objVertices.size() * sizeof(tinyobj::real_t),
-      .usage =
-          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-          VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
-  };
-
-  VkBufferCreateInfo indBufCI{
-      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-      .size = objIndices.size() * sizeof(uint32_t),
-      .usage =
-          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-          VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
-  };
-
-  device->createBuffer(vertexBuffer, vertBufCI,
-                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-  device->createBuffer(indexBuffer, indBufCI,
-                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-  device->copyMemoryToAlloc(vertexBuffer, (void*)objVertices.data(),
-                            vertBufCI.size);
-  device->copyMemoryToAlloc(indexBuffer, (void*)objIndices.data(),
-                            indBufCI.size);
-
-  core_internal::rendering::raytracing::RayTraceBuilder::BlasInput blas;
-  VkAccelerationStructureGeometryTrianglesDataKHR triangles{
-      .sType =
-          VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR,
-      .vertexFormat = VK_FORMAT_R32G32B32_SFLOAT,
-      .vertexData{.deviceAddress = vertexBuffer->deviceAddress},
-      .vertexStride = 3 * sizeof(float),
-      .maxVertex = static_cast<uint32_t>(objVertices.size() / 3 - 1),
-      .indexType = VK_INDEX_TYPE_UINT32,
-      .indexData{.deviceAddress = indexBuffer->deviceAddress},
-      .transformData{.deviceAddress = 0},  // No transform
-  };
-
-  VkAccelerationStructureGeometryKHR geometry{
-      .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR,
-      .geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR,
-      .geometry{
-          .triangles = triangles,
-      },
-      .flags = VK_GEOMETRY_OPAQUE_BIT_KHR,
-  };
-
-  blas.asGeometry.push_back(geometry);
-
-  VkAccelerationStructureBuildRangeInfoKHR offsetInfo{
-      .primitiveCount =
-          static_cast<uint32_t>(objIndices.size() / 3),  // Number of triangles
-      .primitiveOffset = 0,
-      .firstVertex = 0,
-      .transformOffset = 0,
-  };
-
-  blas.asBuildRangeInfo.push_back(offsetInfo);
-  blases.push_back(blas);
-
-  auto rtBuilder =
-      new core_internal::rendering::raytracing::RayTraceBuilder(device);
-
-  // Builds Static BLAS
-  rtBuilder->buildBlas(
-      blases, VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR);
-
-  std::vector<VkAccelerationStructureInstanceKHR> instances;
-  {
-    VkAccelerationStructureInstanceKHR instance{};
-    instance.accelerationStructureReference =
-        rtBuilder->getBlasDeviceAddress(0);
-    // The address of the BLAS in `blases` that this instance
-    // points to
-    // Set the instance transform to the identity matrix:
-    instance.transform.matrix[0][0] = instance.transform.matrix[1][1] =
-        instance.transform.matrix[2][2] = 1.0f;
-    instance.instanceCustomIndex =
-        0;  // 24 bits accessible to ray shaders via
-            // rayQueryGetIntersectionInstanceCustomIndexEXT
-    // Used for a shader offset index, accessible via
-    // rayQueryGetIntersectionInstanceShaderBindingTableRecordOffsetEXT
-    instance.instanceShaderBindingTableRecordOffset = 0;
-    instance.flags =
-        VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;  // How to
-                                                                    // trace
-                                                                    // this
-                                                                    // instance
-    instance.mask = 0xFF;
-    instances.push_back(instance);
+  if (runWavefrontBenchmark && !runKernelAutotune) {
+    // With the tuned shape, which both modes use
+    DEBUG_LOG(core_internal::rendering::raytracing::runWavefrontBenchmark(
+        *renderer, commandLineJob));
+    jobs.clear();
   }
 
-  rtBuilder->buildTlas(
-      instances, VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR,
-      false);
-
-  core_internal::rendering::VulkanDescriptorSet* descriptorSet =
-      new core_internal::rendering::VulkanDescriptorSet(device);
-
-  descriptorSet->addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
-                            VK_SHADER_STAGE_COMPUTE_BIT);
-  descriptorSet->addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
-                            VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR);
-  descriptorSet->addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
-                            VK_SHADER_STAGE_COMPUTE_BIT);
-  descriptorSet->addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
-                            VK_SHADER_STAGE_COMPUTE_BIT);
-  descriptorSet->initLayout();
-  descriptorSet->initPool(1);
-  descriptorSet->initPipelineLayout();
-
-  std::array<VkWriteDescriptorSet, 4> writeDescriptorSets;
-
-  VkDescriptorBufferInfo descriptorBufferInfo{
-      .buffer = buf->buffer,
-      .range = buf->size,
-  };
-  writeDescriptorSets[0] =
-      descriptorSet->makeWrite(0, 0, &descriptorBufferInfo);
-
-  VkAccelerationStructureKHR tlasCopy = rtBuilder->getAccelerationStructure();
-  VkWriteDescriptorSetAccelerationStructureKHR descriptorAS{
-      .sType =
-          VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR,
-      .accelerationStructureCount = 1,
-      .pAccelerationStructures = &tlasCopy,
-  };
-  writeDescriptorSets[1] = descriptorSet->makeWrite(0, 1, &descriptorAS);
-
-  VkDescriptorBufferInfo vertexDescriptorBufferInfo{
-      .buffer = vertexBuffer->buffer,
-      .range = vertexBuffer->size,
-  };
-  writeDescriptorSets[2] =
-      descriptorSet->makeWrite(0, 2, &vertexDescriptorBufferInfo);
-
-  VkDescriptorBufferInfo indexDescriptorBufferInfo{
-      .buffer = indexBuffer->buffer,
-      .range = indexBuffer->size,
-  };
-  writeDescriptorSets[3] =
-      descriptorSet->makeWrite(0, 3, &indexDescriptorBufferInfo);
-
-  vkUpdateDescriptorSets(device->operator VkDevice(),
-                         static_cast<uint32_t>(writeDescriptorSets.size()),
-                         writeDescriptorSets.data(), 0, nullptr);
-
-  VkPipelineShaderStageCreateInfo rayTraceStage =
-      device->loadShader("shaders/pt.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
-
-  VkComputePipelineCreateInfo pipelineCI{
-      .stage = rayTraceStage,
-      .layout = descriptorSet->operator VkPipelineLayout(),
-  };
-
-  VkPipeline computePipeline;
-  VK_CHECK_RESULT(vkCreateComputePipelines(device->operator VkDevice(),
-                                           VK_NULL_HANDLE, 1, &pipelineCI,
-                                           nullptr, &computePipeline));
-
-  VkCommandBuffer cmdBuffer = device->createCommandBuffer();
-
-  vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
-
-  auto ds = descriptorSet->getSet(0);
-  vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
-                          descriptorSet->operator VkPipelineLayout(), 0, 1, &ds,
-                          0, nullptr);
-
-  vkCmdDispatch(
-      cmdBuffer, (uint32_t(RenderWidth) + WorkgroupWidth - 1) / WorkgroupWidth,
-      (uint32_t(RenderHeight) + WorkgroupHeight - 1) / WorkgroupHeight, 1);
-
-  VkMemoryBarrier memoryBarrier{
-      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
-      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
-      .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
-  };
-
-  vkCmdPipelineBarrier(
-      cmdBuffer,                             // The command buffer
-      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,  // From the compute shader
-      VK_PIPELINE_STAGE_HOST_BIT,            // To the CPU
-      0,                                     // No special flags
-      1, &memoryBarrier,                     // An array of memory barriers
-      0, nullptr, 0, nullptr);               // No other barriers
-
-  vkEndCommandBuffer(cmdBuffer);
-  device->submitCommandBuffer(cmdBuffer);
-  device->waitIdle();
-
-  char* data = new char[buf->size];
-  device->copyAllocToMemory(buf, data);
-
-  stbi_write_hdr("out.hdr", RenderWidth, RenderHeight, 3,
-                 reinterpret_cast<float*>(data));
+  // Each image is written on the renderer's readback thread while the next
+  // job traces
+  for (const core_internal::rendering::RenderJob& job : jobs) {
+    auto jobStart = std::chrono::steady_clock::now();
+
+    if (!job.partialPath.empty()) {
+      core_internal::rendering::PartialAccumulation partial;
+      const uint32_t samples = renderer->renderSampleRange(job, partial);
+      if (samples == 0) {
+        DEBUG_WARNING("Skipping \"" + job.partialPath + "\", nothing rendered");
+      } else if (!core_internal::rendering::savePartialAccumulation(
+                     job.partialPath, partial)) {
+        DEBUG_WARNING("Could not write \"" + job.partialPath + "\"");
+      } else {
+        DEBUG_LOG(job.partialPath + ": accumulated samples [" +
+                  std::to_string(job.firstSample) + ", " +
+                  std::to_string(job.firstSample + samples) + ")\n");
+      }
+      continue;
+    }
+
+    uint32_t accumulatedSamples = renderer->renderAsync(
+        job, [jobStart](const core_internal::rendering::RenderJob& finished,
+                        const float* rgb, uint32_t samples) {
+          stbi_write_hdr(finished.outputPath.c_str(),
+                         finished.params.resolution[0],
+                         finished.params.resolution[1], 3, rgb);
+
+          double jobSeconds = std::chrono::duration<double>(
+                                  std::chrono::steady_clock::now() - jobStart)
+                                  .count();
+          DEBUG_LOG(finished.outputPath + ": accumulated " +
+                    std::to_string(samples) + " samples per pixel in " +
+                    std::to_string(jobSeconds) + " s\n");
+        });
+    if (accumulatedSamples == 0) {
+      DEBUG_WARNING("Skipping \"" + job.outputPath + "\", nothing rendered");
+      continue;
+    }
+    DEBUG_LOG(job.outputPath + ": average path length " +
+              std::to_string(
+                  renderer->getLastStatistics().getAverageLength()) +
+              " segments and " +
+              std::to_string(
+                  renderer->getLastStatistics().getShadowRaysPerPath()) +
+              " shadow rays\n");
+  }
+  renderer->waitForReadbacks();
 
-  vkDestroyPipeline(device->operator VkDevice(), computePipeline, nullptr);
-  delete descriptorSet;
-  delete rtBuilder;
-  device->destroy(vertexBuffer);
-  device->destroy(indexBuffer);
-  device->destroy(buf);
+  if (!device->savePipelineCache(pipelineCachePath)) {
+    DEBUG_WARNING("Could not write pipeline cache \"" + pipelineCachePath +
+                  "\"");
+  }
+  delete renderer;
   delete device;
-}
\ No newline at end of file
+}
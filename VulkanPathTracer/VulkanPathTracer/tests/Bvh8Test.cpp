@@ -0,0 +1,155 @@
+// Checks that the 8-wide BVH finds the same closest hits as the binary BVH
+// it is collapsed from, for random rays and for axis-aligned ones whose zero
+// direction components make the slab test divide by zero.
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../src/CpuResources/Bvh.hpp"
+#include "../src/CpuResources/Bvh8.hpp"
+
+using namespace core_internal::rendering::cpu;
+
+namespace {
+struct Ray {
+  Vec3 origin;
+  Vec3 direction;
+};
+
+constexpr float TMax = 1000.0f;
+
+// Small triangles scattered through the unit cube, so rays miss and hit
+// often and the tree has a few levels
+void makeScene(std::mt19937& rng, uint32_t triangleCount,
+               std::vector<float>& vertices, std::vector<uint32_t>& indices) {
+  std::uniform_real_distribution<float> position(0.0f, 1.0f);
+  std::uniform_real_distribution<float> offset(-0.05f, 0.05f);
+  for (uint32_t i = 0; i < triangleCount; i++) {
+    const float cx = position(rng), cy = position(rng), cz = position(rng);
+    for (int v = 0; v < 3; v++) {
+      indices.push_back(static_cast<uint32_t>(vertices.size() / 3));
+      vertices.push_back(cx + offset(rng));
+      vertices.push_back(cy + offset(rng));
+      vertices.push_back(cz + offset(rng));
+    }
+  }
+}
+
+std::vector<Ray> makeRays(std::mt19937& rng, uint32_t count) {
+  std::uniform_real_distribution<float> position(-0.5f, 1.5f);
+  std::uniform_real_distribution<float> component(-1.0f, 1.0f);
+  std::uniform_int_distribution<int> axis(0, 2);
+  std::vector<Ray> rays;
+  for (uint32_t i = 0; i < count; i++) {
+    Ray ray;
+    ray.origin = Vec3(position(rng), position(rng), position(rng));
+    float d[3] = {0.0f, 0.0f, 0.0f};
+    switch (i % 3) {
+      case 0:  // Along one axis
+        d[axis(rng)] = (i & 8) ? 1.0f : -1.0f;
+        break;
+      case 1: {  // In an axis plane
+        const int zero = axis(rng);
+        for (int a = 0; a < 3; a++) {
+          d[a] = a == zero ? ((i & 8) ? 0.0f : -0.0f) : component(rng);
+        }
+        break;
+      }
+      default:
+        for (int a = 0; a < 3; a++) {
+          d[a] = component(rng);
+        }
+        break;
+    }
+    const float length = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    if (length == 0.0f) {
+      d[0] = 1.0f;
+    }
+    ray.direction = Vec3(d[0], d[1], d[2]) *
+                    (length > 0.0f ? 1.0f / length : 1.0f);
+    rays.push_back(ray);
+  }
+  return rays;
+}
+
+bool sameHit(bool expectedHit, const BvhHit& expected, bool hit, float t,
+             uint32_t primitiveID) {
+  if (expectedHit != hit) {
+    return false;
+  }
+  // Ties between overlapping triangles may resolve either way, the
+  // distance has to agree
+  return !hit || primitiveID == expected.primitiveID ||
+         std::abs(t - expected.t) <= 1e-5f * std::max(1.0f, expected.t);
+}
+}  // namespace
+
+int main() {
+  std::mt19937 rng(1234);
+  std::vector<float> vertices;
+  std::vector<uint32_t> indices;
+  makeScene(rng, 2000, vertices, indices);
+
+  Bvh bvh;
+  BvhBuildSettings settings;
+  settings.threadCount = 1;
+  bvh.build(vertices, indices, settings);
+  Bvh8 bvh8;
+  bvh8.build(bvh);
+
+  const std::vector<Ray> rays = makeRays(rng, 30000);
+  uint32_t singleErrors = 0;
+  uint32_t packetErrors = 0;
+  uint32_t hits = 0;
+  for (size_t first = 0; first < rays.size(); first += 8) {
+    RayPacket8 packet;
+    for (int lane = 0; lane < 8; lane++) {
+      const Ray& ray = rays[std::min(first + lane, rays.size() - 1)];
+      packet.originX[lane] = ray.origin.x;
+      packet.originY[lane] = ray.origin.y;
+      packet.originZ[lane] = ray.origin.z;
+      packet.directionX[lane] = ray.direction.x;
+      packet.directionY[lane] = ray.direction.y;
+      packet.directionZ[lane] = ray.direction.z;
+      packet.tMin[lane] = 0.0f;
+      packet.tMax[lane] = TMax;
+    }
+    PacketHit8 packetHit;
+    bvh8.intersect(packet, packetHit);
+
+    for (size_t i = first; i < std::min(first + 8, rays.size()); i++) {
+      const Ray& ray = rays[i];
+      BvhHit expected;
+      const bool expectedHit =
+          bvh.intersect(ray.origin, ray.direction, 0.0f, TMax, expected);
+      hits += expectedHit;
+
+      BvhHit hit;
+      const bool wideHit =
+          bvh8.intersect(ray.origin, ray.direction, 0.0f, TMax, hit);
+      if (!sameHit(expectedHit, expected, wideHit, hit.t, hit.primitiveID)) {
+        if (singleErrors++ < 5) {
+          std::printf("single ray %zu: expected %u at %g, got %u at %g\n", i,
+                      expectedHit ? expected.primitiveID : UINT32_MAX,
+                      expected.t, hit.primitiveID, hit.t);
+        }
+      }
+
+      const int lane = static_cast<int>(i - first);
+      if (!sameHit(expectedHit, expected, packetHit.isValid(lane),
+                   packetHit.t[lane], packetHit.primitiveID[lane])) {
+        if (packetErrors++ < 5) {
+          std::printf("packet ray %zu: expected %u at %g, got %u at %g\n", i,
+                      expectedHit ? expected.primitiveID : UINT32_MAX,
+                      expected.t, packetHit.primitiveID[lane],
+                      packetHit.t[lane]);
+        }
+      }
+    }
+  }
+
+  std::printf("%zu rays, %u hits, %u single ray and %u packet mismatches\n",
+              rays.size(), hits, singleErrors, packetErrors);
+  return singleErrors == 0 && packetErrors == 0 ? 0 : 1;
+}